@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+# Computes the FIRST sets of the parser rules of Python3.g4 and writes them out as constexpr
+# TokenSet tables for the hand-written parser (prss/first_sets.hpp).
+#
+# usage: python3 first_sets.py Python3.g4 gen/Python3.tokens ../prss/first_sets.hpp
+
+import re
+import sys
+
+# the rules the parser dispatches on, in the order they're written out
+RULES = [
+    'stmt',
+    'simple_stmt',
+    'compound_stmt',
+    'testlist_star_expr',
+    'test',
+    'or_test',
+    'comparison',
+    'testlist_comp',
+    'dictorsetmaker',
+    'arglist',
+    'augassign',
+]
+
+
+def read_token_names(tokens_path):
+    names = {}
+    literals = {}
+    with open(tokens_path) as tokens_file:
+        for line in tokens_file:
+            key, _, value = line.rstrip('\n').rpartition('=')
+            if key.startswith("'"):
+                literals[value] = key[1:-1].replace("\\'", "'")
+            else:
+                names[value] = key
+    return {literal: names[value] for value, literal in literals.items()}
+
+
+def read_parser_rules(grammar_path):
+    with open(grammar_path) as grammar_file:
+        text = grammar_file.read()
+    # the parser rules sit between these two comments
+    text = text[text.index(' * parser rules'):text.index(' * lexer rules')]
+    # comments are dropped, unless they're inside literals ('//=')
+    text = re.sub(r"('(?:\\.|[^'\\])*')|/\*.*?\*/|//[^\n]*", lambda match: match.group(1) or '', text,
+                  flags=re.S)
+
+    rules = {}
+    for match in re.finditer(r'^([a-z_][a-z_0-9]*)\s*:(.*?);\s*$', text, flags=re.S | re.M):
+        rules[match.group(1)] = tokenize(match.group(2))
+    return rules
+
+
+def tokenize(body):
+    return re.findall(r"'(?:\\.|[^'\\])*'|[A-Za-z_][A-Za-z_0-9]*|[()|?*+]", body)
+
+
+class FirstSets:
+    def __init__(self, rules, literal_names):
+        self.rules = rules
+        self.literal_names = literal_names
+        self.first = {name: set() for name in rules}
+        self.nullable = {name: False for name in rules}
+
+    def compute(self):
+        changed = True
+        while changed:
+            changed = False
+            for name, body in self.rules.items():
+                first, nullable, _ = self.alternatives(body, 0)
+                if first != self.first[name] or nullable != self.nullable[name]:
+                    self.first[name] = first
+                    self.nullable[name] = nullable
+                    changed = True
+
+    # alternatives: sequence ('|' sequence)*, returns (first, nullable, next position)
+    def alternatives(self, body, pos):
+        first, nullable, pos = self.sequence(body, pos)
+        while pos < len(body) and body[pos] == '|':
+            alt_first, alt_nullable, pos = self.sequence(body, pos + 1)
+            first |= alt_first
+            nullable = nullable or alt_nullable
+        return first, nullable, pos
+
+    def sequence(self, body, pos):
+        first = set()
+        nullable = True
+        while pos < len(body) and body[pos] not in ('|', ')'):
+            elem_first, elem_nullable, pos = self.element(body, pos)
+            if nullable:
+                first |= elem_first
+            nullable = nullable and elem_nullable
+        return first, nullable, pos
+
+    def element(self, body, pos):
+        token = body[pos]
+        if token == '(':
+            first, nullable, pos = self.alternatives(body, pos + 1)
+            pos += 1
+        elif token.startswith("'"):
+            first, nullable, pos = {self.literal_names[token[1:-1]]}, False, pos + 1
+        elif token[0].isupper():
+            first, nullable, pos = {token}, False, pos + 1
+        else:
+            first, nullable, pos = set(self.first[token]), self.nullable[token], pos + 1
+
+        if pos < len(body) and body[pos] in ('?', '*', '+'):
+            nullable = nullable or body[pos] != '+'
+            pos += 1
+        return first, nullable, pos
+
+
+def main():
+    grammar_path, tokens_path, header_path = sys.argv[1:4]
+    first_sets = FirstSets(read_parser_rules(grammar_path), read_token_names(tokens_path))
+    first_sets.compute()
+
+    lines = [
+        '#pragma once',
+        '',
+        '// Generated by grammar/first_sets.py from grammar/Python3.g4, do not edit.',
+        '',
+        '#include "token_set.hpp"',
+        '',
+    ]
+    for rule in RULES:
+        tokens = sorted(first_sets.first[rule])
+        lines.append('// FIRST(%s)' % rule)
+        lines.append('constexpr TokenSet FIRST_%s = TokenSet::of({' % rule.upper())
+        for i, token in enumerate(tokens):
+            lines.append('        Python3Parser::%s%s' % (token, ',' if i + 1 < len(tokens) else ''))
+        lines.append('});')
+        lines.append('')
+
+    with open(header_path, 'w') as header_file:
+        header_file.write('\n'.join(lines))
+
+
+if __name__ == '__main__':
+    main()
@@ -40,29 +40,34 @@ public:
 
 
     private:
-    // A queue where extra tokens are pushed on (see the NEWLINE lexer rule).
-    std::vector<std::unique_ptr<antlr4::Token>> m_tokens;
+    // A queue of the tokens to be handed out by nextToken(). Every token ends up here,
+    // including the extra ones pushed on by the NEWLINE lexer rule.
+    std::deque<std::unique_ptr<antlr4::Token>> m_tokens;
     // The stack that keeps track of the indentation level.
     std::stack<int> m_indents;
     // The amount of opened braces, brackets and parenthesis.
     int m_opened = 0;
-    // The most recently produced token.
-    std::unique_ptr<antlr4::Token> m_pLastToken = nullptr;
+    // The position of the most recently produced token on the default channel.
+    size_t m_lastLine = 0;
+    size_t m_lastCharPositionInLine = 0;
 
     public:
+    // Queues the token rather than handing it over to Lexer::nextToken(), so no copy of it is needed.
+    // Lexer::nextToken() emits its own token if none was set, hence the NEWLINE rule always ends with skip().
     virtual void emit(std::unique_ptr<antlr4::Token> newToken) override {
-      m_tokens.push_back(cloneToken(newToken));
-      setToken(std::move(newToken));
+      if (newToken->getChannel() == antlr4::Token::DEFAULT_CHANNEL) {
+        m_lastLine = newToken->getLine();
+        m_lastCharPositionInLine = newToken->getCharPositionInLine();
+      }
+      m_tokens.push_back(std::move(newToken));
     }
 
     std::unique_ptr<antlr4::Token> nextToken() override {
       // Check if the end-of-file is ahead and there are still some DEDENTS expected.
       if (_input->LA(1) == EOF && !m_indents.empty()) {
         // Remove any trailing EOF tokens from our buffer.
-        for (int i = m_tokens.size() - 1; i >= 0; i--) {
-          if (m_tokens[i]->getType() == EOF) {
-            m_tokens.erase(m_tokens.begin() + i);
-          }
+        while (!m_tokens.empty() && m_tokens.back()->getType() == EOF) {
+          m_tokens.pop_back();
         }
 
         // First emit an extra line break that serves as the end of the statement.
@@ -78,18 +83,13 @@ public:
         emit(commonToken(EOF, "<EOF>"));
       }
 
-      std::unique_ptr<antlr4::Token> next = Lexer::nextToken();
-
-      if (next->getChannel() == antlr4::Token::DEFAULT_CHANNEL) {
-        // Keep track of the last token on the default channel.
-        m_pLastToken = cloneToken(next);
+      if (m_tokens.empty()) {
+        // Every token matched gets queued by emit(), the returned one is always null.
+        Lexer::nextToken();
       }
 
-      if (!m_tokens.empty())
-      {
-        next = std::move(*m_tokens.begin());
-        m_tokens.erase(m_tokens.begin());
-      }
+      std::unique_ptr<antlr4::Token> next = std::move(m_tokens.front());
+      m_tokens.pop_front();
 
       return next;
     }
@@ -103,11 +103,7 @@ public:
     std::unique_ptr<antlr4::CommonToken> commonToken(size_t type, const std::string& text) {
       int stop = getCharIndex() - 1;
       int start = text.empty() ? stop : stop - text.size() + 1;
-      return _factory->create({ this, _input }, type, text, DEFAULT_TOKEN_CHANNEL, start, stop, m_pLastToken ? m_pLastToken->getLine() : 0, m_pLastToken ? m_pLastToken->getCharPositionInLine() : 0);
-    }
-
-    std::unique_ptr<antlr4::CommonToken> cloneToken(const std::unique_ptr<antlr4::Token>& source) {
-        return _factory->create({ this, _input }, source->getType(), source->getText(), source->getChannel(), source->getStartIndex(), source->getStopIndex(), source->getLine(), source->getCharPositionInLine());
+      return _factory->create({ this, _input }, type, text, DEFAULT_TOKEN_CHANNEL, start, stop, m_lastLine, m_lastCharPositionInLine);
     }
 
 
@@ -105,21 +105,19 @@ void Python3Lexer::NEWLINEAction(antlr4::RuleContext *context, size_t actionInde
            emit(commonToken(NEWLINE, newLine));
            int indent = getIndentationCount(spaces);
            int previous = m_indents.empty() ? 0 : m_indents.top();
-           if (indent == previous) {
-             // skip indents of the same size as the present indent-size
-             skip();
-           }
-           else if (indent > previous) {
+           if (indent > previous) {
              m_indents.push(indent);
              emit(commonToken(Python3Parser::INDENT, spaces));
            }
            else {
-             // Possibly emit more than 1 DEDENT token.
+             // Possibly emit more than 1 DEDENT token, none for indents of the same size.
              while(!m_indents.empty() && m_indents.top() > indent) {
                emit(createDedent());
                m_indents.pop();
              }
            }
+           // The tokens have been queued by emit(), the matched text itself doesn't make one.
+           skip();
          }
          }
         break;
@@ -0,0 +1,513 @@
+#!/usr/bin/env python3
+# Generates synthetic Python corpora for prss_bench, from 1 KB to 1 GB per file, to plot the parser's time and
+# memory against the input size and catch superlinear behavior. Every shape is written at every size, as
+# <output dir>/<shape>/<size>.py, so that a shape's directory is a corpus (prss_bench --per-file <dir>/<shape>).
+#
+# The shapes:
+#   grammar         random derivations of the parser rules of Python3.g4, starting at stmt
+#   nesting         compound statements and brackets nested --depth deep
+#   long_lines      statements --line-length bytes long, on a single line each
+#   literal_tables  dict and list literals --table-entries long (0: a single table for the whole file)
+#   tiny_functions  many small functions and methods
+#   decorators      functions and classes under chains of --chain-length decorators
+#
+# usage: python3 gen_corpus.py Python3.g4 <output dir> [--sizes=1K,1M,1G] [--shapes=grammar,nesting,...]
+#                              [--seed=N] [--max-depth=N] [--optional=P] [--repeat=P] [--weight=NAME=W]...
+#                              [--unique=SIZE] [--depth=N] [--line-length=N] [--table-entries=N] [--chain-length=N]
+
+import argparse
+import os
+import random
+import sys
+
+from first_sets import read_parser_rules
+
+# a few names show up all over the place, most of them only once in a while
+COMMON_NAMES = ['self', 'x', 'y', 'i', 'n', 'data', 'value', 'result', 'key', 'items', 'os', 'path', 'args']
+
+# the weight of the rule, token or literal an alternative, an optional or a repetition starts with scales its
+# likelihood, 1 by default. Compound statements, brackets, unary operators and the like are rarer than in the
+# grammar, where every alternative is as likely, so that a derivation looks a bit more like code.
+DEFAULT_WEIGHTS = {
+    'AWAIT': 0.05,
+    'ASYNC': 0.2,
+    'annassign': 0.2,
+    'augassign': 0.3,
+    'comp_for': 0.3,
+    "'+'": 0.15,
+    "'-'": 0.15,
+    "'~'": 0.1,
+    "'**'": 0.3,
+    "'*'": 0.3,
+    "'not'": 0.2,
+    "'('": 0.3,
+    "'['": 0.2,
+    "'{'": 0.15,
+    "'...'": 0.2,
+    "';'": 0.2,
+    "'None'": 0.3,
+    "'True'": 0.3,
+    "'False'": 0.3,
+    'NAME': 2,
+    'compound_stmt': 0.15,
+    'lambdef': 0.05,
+    'lambdef_nocond': 0.05,
+    'yield_expr': 0.2,
+    'star_expr': 0.2,
+    'decorated': 0.3,
+    'async_stmt': 0.2,
+    'async_funcdef': 0.2,
+}
+
+# the literals of the grammar prss rejects, an alternative that is only one of them is left out of the derivations:
+# '<>' (NOT_EQ_1) is the Python 2 spelling of '!=', which Python 3 rejects too
+UNSUPPORTED_LITERALS = {'<>'}
+
+SHAPES = ['grammar', 'nesting', 'long_lines', 'literal_tables', 'tiny_functions', 'decorators']
+
+SIZE_SUFFIXES = {'K': 1 << 10, 'M': 1 << 20, 'G': 1 << 30}
+
+
+def parse_size(text):
+    text = text.strip().upper().rstrip('B')
+    if text and text[-1] in SIZE_SUFFIXES:
+        return int(float(text[:-1]) * SIZE_SUFFIXES[text[-1]])
+    return int(text)
+
+
+def size_name(size):
+    for suffix in ('G', 'M', 'K'):
+        if size >= SIZE_SUFFIXES[suffix] and size % SIZE_SUFFIXES[suffix] == 0:
+            return '%d%s' % (size // SIZE_SUFFIXES[suffix], suffix)
+    return str(size)
+
+
+# Buffers the text of a file and writes it out in large pieces, counting its bytes (it's all ASCII)
+class Output:
+    def __init__(self, path):
+        self.file = open(path, 'w', newline='\n')
+        self.pieces = []
+        self.buffered = 0
+        self.size = 0
+
+    def write(self, text):
+        self.pieces.append(text)
+        self.buffered += len(text)
+        self.size += len(text)
+        if self.buffered >= 1 << 20:
+            self.flush()
+
+    def flush(self):
+        self.file.write(''.join(self.pieces))
+        self.pieces = []
+        self.buffered = 0
+
+    def close(self):
+        self.flush()
+        self.file.close()
+
+
+class Lexemes:
+    def __init__(self, rng):
+        self.rng = rng
+        self.names = COMMON_NAMES + ['name_%d' % i for i in range(1000)]
+
+    def name(self):
+        # mostly the common names, then the first few hundred, then any
+        roll = self.rng.random()
+        if roll < 0.5:
+            return self.rng.choice(COMMON_NAMES)
+        return self.names[int(len(self.names) * roll ** 4)]
+
+    def number(self):
+        kind = self.rng.randrange(8)
+        if kind < 4:
+            return str(self.rng.randrange(10 ** self.rng.randrange(1, 10)))
+        elif kind == 4:
+            return '%.*f' % (self.rng.randrange(1, 6), self.rng.random() * 1000)
+        elif kind == 5:
+            return hex(self.rng.randrange(1 << 32))
+        elif kind == 6:
+            return '%de%d' % (self.rng.randrange(1, 10), self.rng.randrange(-30, 30))
+        return '%dj' % self.rng.randrange(100)
+
+    def string(self):
+        text = ''.join(self.rng.choice('abcdefghijklmnopqrstuvwxyz _-') for _ in range(self.rng.randrange(24)))
+        kind = self.rng.randrange(10)
+        if kind < 5:
+            return "'%s'" % text
+        elif kind < 8:
+            return '"%s"' % text
+        elif kind == 8:
+            return self.rng.choice(('b', 'r', 'rb')) + "'%s'" % text
+        return '"""%s"""' % text
+
+
+# Random derivations of the parser rules of the grammar.
+#
+# A rule body becomes a tree of ('alt', [sequences]), ('seq', [elements]), ('opt' | 'star' | 'plus', element),
+# ('rule', name), ('token', NAME) and ('literal', text). Past --max-depth rules every choice is the one that ends the
+# derivation the soonest (the height of every rule is computed upfront), before that optionals and repetitions are
+# taken with a likelihood that decreases with the depth.
+class Derivations:
+    def __init__(self, grammar_path, rng, options):
+        self.rng = rng
+        self.lexemes = Lexemes(rng)
+        self.max_depth = options.max_depth
+        self.optional = options.optional
+        self.repeat = options.repeat
+        self.weights = dict(DEFAULT_WEIGHTS)
+        self.weights.update(options.weights)
+
+        self.rules = {}
+        for name, body in read_parser_rules(grammar_path).items():
+            tree, _ = self.parse_alternatives(body, 0)
+            self.rules[name] = tree
+        self.heights = self.compute_heights()
+
+    def parse_alternatives(self, body, pos):
+        sequences = []
+        seq, pos = self.parse_sequence(body, pos)
+        sequences.append(seq)
+        while pos < len(body) and body[pos] == '|':
+            seq, pos = self.parse_sequence(body, pos + 1)
+            sequences.append(seq)
+        sequences = [seq for seq in sequences
+                     if all(seq[1] != [('literal', text)] for text in UNSUPPORTED_LITERALS)]
+        return ('alt', sequences), pos
+
+    def parse_sequence(self, body, pos):
+        elements = []
+        while pos < len(body) and body[pos] not in ('|', ')'):
+            token = body[pos]
+            if token == '(':
+                element, pos = self.parse_alternatives(body, pos + 1)
+                pos += 1
+            elif token.startswith("'"):
+                element, pos = ('literal', token[1:-1].replace("\\'", "'")), pos + 1
+            elif token[0].isupper():
+                element, pos = ('token', token), pos + 1
+            else:
+                element, pos = ('rule', token), pos + 1
+
+            if pos < len(body) and body[pos] in ('?', '*', '+'):
+                element = ({'?': 'opt', '*': 'star', '+': 'plus'}[body[pos]], element)
+                pos += 1
+            elements.append(element)
+        return ('seq', elements), pos
+
+    def compute_heights(self):
+        heights = {name: float('inf') for name in self.rules}
+        changed = True
+        while changed:
+            changed = False
+            for name, tree in self.rules.items():
+                height = 1 + self.height(tree, heights)
+                if height < heights[name]:
+                    heights[name] = height
+                    changed = True
+        return heights
+
+    def height(self, element, heights):
+        kind = element[0]
+        if kind == 'alt':
+            return min(self.height(seq, heights) for seq in element[1])
+        elif kind == 'seq':
+            return max([self.height(e, heights) for e in element[1]] or [0])
+        elif kind in ('opt', 'star'):
+            return 0
+        elif kind == 'plus':
+            return self.height(element[1], heights)
+        elif kind == 'rule':
+            return heights[element[1]]
+        return 0
+
+    # the weight of what an element starts with, the largest one for a choice
+    def weight(self, element):
+        kind = element[0]
+        if kind == 'alt':
+            return max(self.weight(seq) for seq in element[1])
+        elif kind == 'seq':
+            return self.weight(element[1][0]) if element[1] else 1
+        elif kind in ('opt', 'star', 'plus'):
+            return self.weight(element[1])
+        elif kind == 'literal':
+            return self.weights.get("'%s'" % element[1], 1)
+        return self.weights.get(element[1], 1)
+
+    # the text of a derivation of the rule, at the given indentation
+    def derive(self, rule, indent=0):
+        self.lines = []
+        self.line = []
+        self.indent = indent
+        self.line_indent = indent
+        self.expand(('rule', rule), 0)
+        if self.line:
+            self.end_line()
+        return ''.join(self.lines)
+
+    def end_line(self):
+        self.lines.append('    ' * self.line_indent + ' '.join(self.line) + '\n' if self.line else '\n')
+        self.line = []
+
+    def emit(self, text):
+        if not self.line:
+            self.line_indent = self.indent
+        self.line.append(text)
+
+    def expand(self, element, depth):
+        kind = element[0]
+        ending = depth >= self.max_depth
+        if kind == 'rule':
+            self.expand(self.rules[element[1]], depth + 1)
+        elif kind == 'alt':
+            sequences = element[1]
+            if len(sequences) == 1:
+                seq = sequences[0]
+            elif ending:
+                seq = min(sequences, key=lambda s: self.height(s, self.heights))
+            else:
+                seq = self.rng.choices(sequences, [self.weight(s) for s in sequences])[0]
+            self.expand(seq, depth)
+        elif kind == 'seq':
+            for e in element[1]:
+                self.expand(e, depth)
+        elif kind == 'opt':
+            if not ending and self.rng.random() < self.likelihood(self.optional, element, depth):
+                self.expand(element[1], depth)
+        elif kind in ('star', 'plus'):
+            if kind == 'plus':
+                self.expand(element[1], depth)
+            while not ending and self.rng.random() < self.likelihood(self.repeat, element, depth):
+                self.expand(element[1], depth)
+        elif kind == 'literal':
+            self.emit(element[1])
+        else:
+            self.token(element[1])
+
+    def likelihood(self, p, element, depth):
+        return p * self.weight(element) * (1 - depth / self.max_depth)
+
+    def token(self, name):
+        if name == 'NEWLINE':
+            self.end_line()
+        elif name == 'INDENT':
+            self.indent += 1
+        elif name == 'DEDENT':
+            self.indent -= 1
+        elif name == 'NAME':
+            self.emit(self.lexemes.name())
+        elif name == 'NUMBER':
+            self.emit(self.lexemes.number())
+        elif name == 'STRING':
+            self.emit(self.lexemes.string())
+        elif name == 'ASYNC':
+            self.emit('async')
+        elif name == 'AWAIT':
+            self.emit('await')
+        elif name != 'EOF':
+            sys.exit('no text for the token %s' % name)
+
+
+def write_grammar(out, size, rng, options):
+    derivations = Derivations(options.grammar, rng, options)
+    # fresh statements up to --unique bytes, then the same ones again in a random order, derivations are slow
+    statements = []
+    unique = 0
+    while out.size < size:
+        if unique < options.unique:
+            statement = derivations.derive('stmt')
+            statements.append(statement)
+            unique += len(statement)
+        else:
+            statement = rng.choice(statements)
+        out.write(statement)
+
+
+def write_nesting(out, size, rng, options):
+    headers = ['if {0}:', 'for {0} in {0}_items:', 'while {0}:', 'with {0} as f:', 'try:', 'def {0}(a, b):',
+               'class {0}:']
+    opens = ['(', '[', '{', 'f(', 'x[']
+    lexemes = Lexemes(rng)
+    while out.size < size:
+        closings = []
+        for level in range(options.depth):
+            header = rng.choice(headers)
+            out.write('    ' * level + header.format(lexemes.name()) + '\n')
+            # what comes after the body of the statement, at its own level
+            if header == 'try:':
+                closings.append((level, 'except Exception:\n' + '    ' * (level + 1) + 'pass\n'))
+            elif header.startswith(('if', 'for', 'while')) and rng.random() < 0.3:
+                closings.append((level, 'else:\n' + '    ' * (level + 1) + 'pass\n'))
+            else:
+                closings.append((level, ''))
+
+        brackets = [rng.choice(opens) for _ in range(options.depth)]
+        ends = ''.join({'(': ')', '[': ']', '{': '}'}[b[-1]] for b in reversed(brackets))
+        out.write('    ' * options.depth + 'value = ' + ''.join(brackets) + lexemes.name() + ' + 1' + ends + '\n')
+        for level, closing in reversed(closings):
+            if closing:
+                out.write('    ' * level + closing)
+
+
+def write_long_lines(out, size, rng, options):
+    lexemes = Lexemes(rng)
+    operators = [' + ', ' - ', ' * ', ' / ', ' % ', ' | ', ' & ', ' and ', ' or ', ' == ', ' < ']
+    # a file smaller than a line is a single shorter one
+    line_length = min(options.line_length, size)
+    while out.size < size:
+        kind = rng.randrange(3)
+        pieces = []
+        length = 0
+        if kind == 0:
+            # a long arithmetic expression
+            pieces.append(lexemes.name() + ' = ' + lexemes.name())
+            while length < line_length:
+                piece = rng.choice(operators) + rng.choice((lexemes.name(), lexemes.number(), lexemes.string()))
+                pieces.append(piece)
+                length += len(piece)
+        elif kind == 1:
+            # a call with many arguments
+            pieces.append(lexemes.name() + '(' + lexemes.name())
+            while length < line_length:
+                piece = ', %s=%s' % (lexemes.name(), lexemes.number()) if rng.random() < 0.3 else \
+                    ', ' + lexemes.name()
+                pieces.append(piece)
+                length += len(piece)
+            pieces.append(')')
+        else:
+            # a long list of strings
+            pieces.append(lexemes.name() + ' = [' + lexemes.string())
+            while length < line_length:
+                piece = ', ' + lexemes.string()
+                pieces.append(piece)
+                length += len(piece)
+            pieces.append(']')
+        pieces.append('\n')
+        out.write(''.join(pieces))
+
+
+def write_literal_tables(out, size, rng, options):
+    lexemes = Lexemes(rng)
+    table = 0
+    while out.size < size:
+        is_dict = table % 2 == 0
+        out.write('TABLE_%d = %s\n' % (table, '{' if is_dict else '['))
+        entries = 0
+        while out.size < size and (options.table_entries == 0 or entries < options.table_entries):
+            row = '(%d, %s, %s, %s, %s)' % (entries, lexemes.number(), lexemes.string(),
+                                            rng.choice(('None', 'True', 'False')), lexemes.number())
+            if is_dict:
+                out.write("    'key_%d': %s,\n" % (entries, row))
+            else:
+                out.write('    [%s, %s, {%s: %s}],\n' % (lexemes.number(), lexemes.string(), lexemes.string(),
+                                                       row))
+            entries += 1
+        out.write('%s\n' % ('}' if is_dict else ']'))
+        table += 1
+
+
+def write_tiny_functions(out, size, rng, options):
+    lexemes = Lexemes(rng)
+    function = 0
+    while out.size < size:
+        if function % 100 == 0:
+            out.write('\n\nclass Class_%d:\n' % function)
+        indent = '    ' if function % 100 < 50 else ''
+        kind = rng.randrange(4)
+        if kind == 0:
+            out.write('%sdef f_%d(a, b=%d):\n%s    return a * b + %d\n\n' % (indent, function, function, indent,
+                                                                          function))
+        elif kind == 1:
+            out.write('%sdef f_%d(): return %s\n\n' % (indent, function, lexemes.name()))
+        elif kind == 2:
+            out.write('%sdef f_%d(self, *args, **kwargs):\n%s    pass\n\n' % (indent, function, indent))
+        else:
+            out.write('%sf_%d = lambda %s: %s + %s\n' % (indent, function, lexemes.name(), lexemes.name(),
+                                                         lexemes.number()))
+        function += 1
+        if function % 100 == 50:
+            out.write('\n\n')
+
+
+def write_decorators(out, size, rng, options):
+    lexemes = Lexemes(rng)
+    definition = 0
+    while out.size < size:
+        for _ in range(options.chain_length):
+            kind = rng.randrange(4)
+            if kind == 0:
+                out.write('@%s\n' % lexemes.name())
+            elif kind == 1:
+                out.write('@%s.%s.%s\n' % (lexemes.name(), lexemes.name(), lexemes.name()))
+            elif kind == 2:
+                out.write('@%s()\n' % lexemes.name())
+            else:
+                out.write('@%s(%s, key=%s)\n' % (lexemes.name(), lexemes.number(), lexemes.string()))
+        if definition % 2 == 0:
+            out.write('def f_%d(%s):\n    return %s\n\n' % (definition, lexemes.name(), lexemes.name()))
+        else:
+            out.write('class C_%d(%s):\n    pass\n\n' % (definition, lexemes.name()))
+        definition += 1
+
+
+WRITERS = {
+    'grammar': write_grammar,
+    'nesting': write_nesting,
+    'long_lines': write_long_lines,
+    'literal_tables': write_literal_tables,
+    'tiny_functions': write_tiny_functions,
+    'decorators': write_decorators,
+}
+
+
+def parse_weight(text):
+    name, _, weight = text.rpartition('=')
+    if not name:
+        raise argparse.ArgumentTypeError('expected NAME=WEIGHT, not %s' % text)
+    return name, float(weight)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generates synthetic Python corpora for prss_bench.')
+    parser.add_argument('grammar', help='Python3.g4')
+    parser.add_argument('output', help='the directory the corpora are written into')
+    parser.add_argument('--sizes', default='1K,4K,16K,64K,256K,1M,4M,16M',
+                        help='the sizes of the files of every shape, up to 1G')
+    parser.add_argument('--shapes', default=','.join(SHAPES))
+    parser.add_argument('--seed', type=int, default=1)
+    # grammar
+    parser.add_argument('--max-depth', type=int, default=60,
+                        help='the rules a derivation goes through before it ends every rule the soonest')
+    parser.add_argument('--optional', type=float, default=0.3, help='the likelihood of an optional')
+    parser.add_argument('--repeat', type=float, default=0.2, help='the likelihood of another repetition')
+    parser.add_argument('--weight', dest='weights', type=parse_weight, action='append', default=[],
+                        help="the weight of the alternatives, optionals and repetitions starting with a rule, "
+                             "token or literal ('('), e.g. compound_stmt=0.5")
+    parser.add_argument('--unique', type=parse_size, default=parse_size('4M'),
+                        help='the bytes of fresh derivations, the rest of a file repeats them')
+    # the other shapes
+    parser.add_argument('--depth', type=int, default=50, help='the nesting depth of statements and brackets')
+    parser.add_argument('--line-length', type=int, default=64 * 1024)
+    parser.add_argument('--table-entries', type=int, default=0)
+    parser.add_argument('--chain-length', type=int, default=32)
+    options = parser.parse_args()
+    options.weights = dict(options.weights)
+
+    sizes = [parse_size(size) for size in options.sizes.split(',')]
+    for shape in options.shapes.split(','):
+        if shape not in WRITERS:
+            sys.exit('unknown shape %s, expected one of %s' % (shape, ', '.join(SHAPES)))
+        os.makedirs(os.path.join(options.output, shape), exist_ok=True)
+        for size in sizes:
+            path = os.path.join(options.output, shape, size_name(size) + '.py')
+            # the same seed for every size, a smaller file starts the way a larger one does
+            out = Output(path)
+            WRITERS[shape](out, size, random.Random(options.seed), options)
+            out.close()
+            print('%s: %d bytes' % (path, out.size))
+
+
+if __name__ == '__main__':
+    sys.setrecursionlimit(20000)
+    main()
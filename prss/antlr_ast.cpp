@@ -0,0 +1,757 @@
+#include "antlr_ast.hpp"
+
+using antlr4::tree::ParseTree;
+using antlr4::tree::TerminalNode;
+
+namespace {
+    // every visit hands out a Node *, whatever the type of the node, so that as<Node *>() finds it
+    inline antlrcpp::Any result(Node *node) {
+        return node;
+    }
+
+    // the type of the token of a terminal, 0 (Token::INVALID_TYPE) for a rule
+    inline size_t tokenType(ParseTree *tree) {
+        const auto terminal = dynamic_cast<TerminalNode *>(tree);
+        return terminal ? terminal->getSymbol()->getType() : 0;
+    }
+
+    inline bool hasToken(antlr4::ParserRuleContext *ctx, size_t type) {
+        for (const auto child : ctx->children) {
+            if (tokenType(child) == type) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the code isCompOp gives the comparison operator
+    int32_t compOp(Python3Parser::Comp_opContext *ctx) {
+        if (ctx->children.size() == 2) {
+            return tokenType(ctx->children[0]) == Python3Parser::NOT ? NOT_IN : IS_NOT;
+        }
+
+        switch (tokenType(ctx->children[0])) {
+            case Python3Parser::LESS_THAN:
+                return LESS_THAN;
+            case Python3Parser::GREATER_THAN:
+                return GREATER_THAN;
+            case Python3Parser::EQUALS:
+                return EQUALS;
+            case Python3Parser::GT_EQ:
+                return GT_EQ;
+            case Python3Parser::LT_EQ:
+                return LT_EQ;
+            case Python3Parser::IN:
+                return IN;
+            case Python3Parser::IS:
+                return IS;
+            default:
+                // '<>' is the same as '!='
+                return NOT_EQ_2;
+        }
+    }
+}
+
+Node *AntlrAstBuilder::build(Python3Parser::File_inputContext *file_input) {
+    ArenaScope scope(arena_);
+    return node(file_input);
+}
+
+Node *AntlrAstBuilder::node(ParseTree *tree) {
+    if (!tree) {
+        return nullptr;
+    }
+
+    const auto any = tree->accept(this);
+    return any.isNull() ? nullptr : any.as<Node *>();
+}
+
+std::string_view AntlrAstBuilder::keep(std::string &&text) {
+    return texts_.emplace_back(std::move(text));
+}
+
+Name *AntlrAstBuilder::name(TerminalNode *terminal) {
+    const auto text = keep(terminal->getText());
+    return new Name(text, symbols_.intern(text));
+}
+
+Name *AntlrAstBuilder::dottedName(Python3Parser::Dotted_nameContext *ctx) {
+    const auto text = keep(ctx->getText());
+    return new Name(text, symbols_.intern(text));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitFile_input(Python3Parser::File_inputContext *ctx) {
+    auto file_input = new FileInput({});
+    for (const auto stmt : ctx->stmt()) {
+        file_input->statements.push_back(node(stmt));
+    }
+    return result(file_input);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitDecorated(Python3Parser::DecoratedContext *ctx) {
+    NodeList decorator_list;
+    for (const auto decorator : ctx->decorators()->decorator()) {
+        decorator_list.push_back(new Call(dottedName(decorator->dotted_name()), arguments(decorator->arglist())));
+    }
+
+    if (ctx->classdef()) {
+        const auto class_def = dynamic_cast<ClassDef *>(node(ctx->classdef()));
+        class_def->decorator_list = std::move(decorator_list);
+        return result(class_def);
+    }
+
+    const auto func_def = ctx->funcdef() ? ctx->funcdef() : ctx->async_funcdef()->funcdef();
+    const auto def = dynamic_cast<FuncDef *>(node(func_def));
+    def->decorator_list = std::move(decorator_list);
+    if (ctx->async_funcdef()) {
+        return result(new AsyncFuncDef(def, true));
+    }
+    return result(def);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitAsync_funcdef(Python3Parser::Async_funcdefContext *ctx) {
+    return result(new AsyncFuncDef(dynamic_cast<FuncDef *>(node(ctx->funcdef())), true));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitFuncdef(Python3Parser::FuncdefContext *ctx) {
+    const auto def_name = keep(ctx->NAME()->getText());
+    const auto typed_args = ctx->parameters()->typedargslist();
+    auto func_def = new FuncDef(def_name, typed_args ? parameters(typed_args) : nullptr, nullptr,
+                                node(ctx->test()), {});
+    func_def->name_symbol = symbols_.intern(def_name);
+    func_def->body = node(ctx->suite());
+    return result(func_def);
+}
+
+// (tfpdef ('=' test)? (',' tfpdef ('=' test)?)* (',' ('*' (tfpdef)? (',' tfpdef ('=' test)?)*
+//  (',' ('**' tfpdef (',')?)?)? | '**' tfpdef (',')?)?)? | ...
+// the same goes for varargslist, with vfpdef in place of tfpdef
+Parameters *AntlrAstBuilder::parameters(antlr4::ParserRuleContext *ctx) {
+    auto parameters = new Parameters({}, {});
+    // whether the parameters are keyword-only ones, i.e. follow a '*', and what the next fpdef is
+    bool is_kw_only = false;
+    bool is_vararg = false;
+    bool is_kwarg = false;
+    Parameter *last = nullptr;
+    for (size_t i = 0; i < ctx->children.size(); ++i) {
+        const auto child = ctx->children[i];
+        switch (tokenType(child)) {
+            case Python3Parser::STAR:
+                is_kw_only = true;
+                is_vararg = true;
+                continue;
+            case Python3Parser::POWER:
+                is_kwarg = true;
+                continue;
+            case Python3Parser::COMMA:
+                // a bare '*'
+                is_vararg = false;
+                continue;
+            case Python3Parser::ASSIGN: {
+                const auto default_val = node(ctx->children[++i]);
+                if (is_kw_only) {
+                    parameters->extra.kw_defaults.back() = default_val;
+                } else {
+                    last->default_val = default_val;
+                }
+                continue;
+            }
+            default:
+                break;
+        }
+
+        const auto fpdef = dynamic_cast<antlr4::ParserRuleContext *>(child);
+        const auto tfpdef = dynamic_cast<Python3Parser::TfpdefContext *>(child);
+        const auto parameter = new Parameter(name(fpdef->getToken(Python3Parser::NAME, 0)),
+                                             tfpdef ? node(tfpdef->test()) : nullptr, nullptr);
+        if (is_kwarg) {
+            parameters->extra.kwarg = parameter;
+            is_kwarg = false;
+        } else if (is_vararg) {
+            parameters->extra.vararg = parameter;
+            is_vararg = false;
+        } else if (is_kw_only) {
+            parameters->extra.kw_only_args.push_back(parameter);
+            parameters->extra.kw_defaults.push_back(nullptr);
+        } else {
+            parameters->params.push_back(parameter);
+        }
+        last = parameter;
+    }
+
+    return parameters;
+}
+
+antlrcpp::Any AntlrAstBuilder::visitSimple_stmt(Python3Parser::Simple_stmtContext *ctx) {
+    auto simple_stmt = new SimpleStmt({});
+    for (const auto small_stmt : ctx->small_stmt()) {
+        simple_stmt->small_stmts.push_back(node(small_stmt));
+    }
+    return result(simple_stmt);
+}
+
+// expr_stmt: testlist_star_expr (annassign | augassign (yield_expr|testlist) |
+//                     ('=' (yield_expr|testlist_star_expr))*);
+antlrcpp::Any AntlrAstBuilder::visitExpr_stmt(Python3Parser::Expr_stmtContext *ctx) {
+    const auto target = node(ctx->children[0]);
+    if (const auto ann_assign = ctx->annassign()) {
+        const auto value = ann_assign->test().size() > 1 ? node(ann_assign->test(1)) : nullptr;
+        return result(new AnnAssign(target, node(ann_assign->test(0)), value));
+    }
+
+    if (const auto aug_assign = ctx->augassign()) {
+        return result(new AugAssign(target, aug_assign->getStart()->getType(), node(ctx->children[2])));
+    }
+
+    if (ctx->children.size() > 1) {
+        // the targets in between have no place in Assign, parseExprStmt() keeps the first and the value only
+        return result(new Assign(dynamic_cast<TestList *>(target), node(ctx->children.back())));
+    }
+
+    return result(target);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitTestlist_star_expr(Python3Parser::Testlist_star_exprContext *ctx) {
+    auto test_list = new TestList({});
+    for (const auto child : ctx->children) {
+        if (!tokenType(child)) {
+            test_list->nodes.push_back(node(child));
+        }
+    }
+    return result(test_list);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitDel_stmt(Python3Parser::Del_stmtContext *ctx) {
+    return result(new Delete(dynamic_cast<ExprList *>(node(ctx->exprlist()))));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitPass_stmt(Python3Parser::Pass_stmtContext *) {
+    return result(new Pass());
+}
+
+antlrcpp::Any AntlrAstBuilder::visitBreak_stmt(Python3Parser::Break_stmtContext *) {
+    return result(new Break());
+}
+
+antlrcpp::Any AntlrAstBuilder::visitContinue_stmt(Python3Parser::Continue_stmtContext *) {
+    return result(new Continue());
+}
+
+antlrcpp::Any AntlrAstBuilder::visitReturn_stmt(Python3Parser::Return_stmtContext *ctx) {
+    return result(new Return(dynamic_cast<TestList *>(node(ctx->testlist()))));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitRaise_stmt(Python3Parser::Raise_stmtContext *ctx) {
+    const auto tests = ctx->test();
+    return result(new Raise(tests.empty() ? nullptr : node(tests[0]), tests.size() > 1 ? node(tests[1]) : nullptr));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitImport_name(Python3Parser::Import_nameContext *ctx) {
+    auto aliases = new Aliases({});
+    for (const auto dotted_as_name : ctx->dotted_as_names()->dotted_as_name()) {
+        const auto as = dotted_as_name->NAME();
+        aliases->aliases.push_back(new Alias(dottedName(dotted_as_name->dotted_name()), as ? name(as) : nullptr));
+    }
+    return result(new Import(aliases));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitImport_from(Python3Parser::Import_fromContext *ctx) {
+    // an ELLIPSIS is three dots
+    const auto level = static_cast<int32_t>(ctx->DOT().size() + 3 * ctx->ELLIPSIS().size());
+    auto aliases = new Aliases({});
+    if (ctx->STAR()) {
+        aliases->aliases.push_back(new Alias(new Name("*", symbols_.intern("*")), nullptr));
+    } else {
+        for (const auto import_as_name : ctx->import_as_names()->import_as_name()) {
+            const auto names = import_as_name->NAME();
+            aliases->aliases.push_back(new Alias(name(names[0]), names.size() > 1 ? name(names[1]) : nullptr));
+        }
+    }
+
+    const auto dotted_name = ctx->dotted_name();
+    return result(new ImportFrom(dotted_name ? dottedName(dotted_name) : nullptr, aliases, level));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitGlobal_stmt(Python3Parser::Global_stmtContext *ctx) {
+    auto global = new Global({});
+    for (const auto terminal : ctx->NAME()) {
+        global->names.push_back(name(terminal));
+    }
+    return result(global);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitNonlocal_stmt(Python3Parser::Nonlocal_stmtContext *ctx) {
+    auto nonlocal = new Nonlocal({});
+    for (const auto terminal : ctx->NAME()) {
+        nonlocal->names.push_back(name(terminal));
+    }
+    return result(nonlocal);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitAssert_stmt(Python3Parser::Assert_stmtContext *ctx) {
+    const auto tests = ctx->test();
+    return result(new Assert(node(tests[0]), tests.size() > 1 ? node(tests[1]) : nullptr));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitAsync_stmt(Python3Parser::Async_stmtContext *ctx) {
+    if (ctx->funcdef()) {
+        return result(new AsyncFuncDef(dynamic_cast<FuncDef *>(node(ctx->funcdef())), true));
+    } else if (ctx->with_stmt()) {
+        return result(new AsyncWithStmt(dynamic_cast<WithStmt *>(node(ctx->with_stmt())), true));
+    }
+    return result(new AsyncForStmt(dynamic_cast<ForStmt *>(node(ctx->for_stmt())), true));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitIf_stmt(Python3Parser::If_stmtContext *ctx) {
+    const auto tests = ctx->test();
+    const auto suites = ctx->suite();
+    // every elif nests in the or_else of the one before, the way parseIfStmt() builds them
+    IfStmt *if_stmt = nullptr;
+    IfStmt *last = nullptr;
+    for (size_t i = 0; i < tests.size(); ++i) {
+        const auto elif = new IfStmt(node(tests[i]), node(suites[i]), nullptr);
+        if (last) {
+            last->or_else = elif;
+        } else {
+            if_stmt = elif;
+        }
+        last = elif;
+    }
+    if (suites.size() > tests.size()) {
+        last->or_else = node(suites.back());
+    }
+    return result(if_stmt);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitWhile_stmt(Python3Parser::While_stmtContext *ctx) {
+    const auto suites = ctx->suite();
+    return result(new WhileStmt(node(ctx->test()), node(suites[0]), suites.size() > 1 ? node(suites[1]) : nullptr));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitFor_stmt(Python3Parser::For_stmtContext *ctx) {
+    const auto suites = ctx->suite();
+    return result(new ForStmt(node(ctx->exprlist()), node(ctx->testlist()), node(suites[0]),
+                              suites.size() > 1 ? node(suites[1]) : nullptr));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitTry_stmt(Python3Parser::Try_stmtContext *ctx) {
+    auto try_stmt = new TryStmt(nullptr, {}, nullptr, nullptr);
+    // the token in front of the ':' of the suite, which tells what the suite is for
+    size_t keyword = Python3Parser::TRY;
+    ExceptHandler *handler = nullptr;
+    for (const auto child : ctx->children) {
+        if (const auto except_clause = dynamic_cast<Python3Parser::Except_clauseContext *>(child)) {
+            const auto as = except_clause->NAME();
+            handler = new ExceptHandler(node(except_clause->test()), as ? keep(as->getText()) : "", nullptr);
+            if (as) {
+                handler->name_symbol = symbols_.intern(handler->name);
+            }
+            try_stmt->handlers.push_back(handler);
+            keyword = Python3Parser::EXCEPT;
+        } else if (const auto suite = dynamic_cast<Python3Parser::SuiteContext *>(child)) {
+            switch (keyword) {
+                case Python3Parser::TRY:
+                    try_stmt->body = node(suite);
+                    break;
+                case Python3Parser::EXCEPT:
+                    handler->body = node(suite);
+                    break;
+                case Python3Parser::ELSE:
+                    try_stmt->or_else = node(suite);
+                    break;
+                default:
+                    try_stmt->final_body = node(suite);
+                    break;
+            }
+        } else if (tokenType(child) == Python3Parser::ELSE || tokenType(child) == Python3Parser::FINALLY) {
+            keyword = tokenType(child);
+        }
+    }
+    return result(try_stmt);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitWith_stmt(Python3Parser::With_stmtContext *ctx) {
+    auto with_stmt = new WithStmt({}, nullptr, nullptr);
+    for (const auto with_item : ctx->with_item()) {
+        with_stmt->items.push_back(node(with_item));
+    }
+    with_stmt->body = node(ctx->suite());
+    return result(with_stmt);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitWith_item(Python3Parser::With_itemContext *ctx) {
+    return result(new WithItem(node(ctx->test()), node(ctx->expr())));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitSuite(Python3Parser::SuiteContext *ctx) {
+    if (ctx->simple_stmt()) {
+        return result(node(ctx->simple_stmt()));
+    }
+
+    auto stmt = new Stmt({});
+    for (const auto child : ctx->stmt()) {
+        stmt->nodes.push_back(node(child));
+    }
+    return result(stmt);
+}
+
+// test: or_test ('if' or_test 'else' test)? | lambdef;
+antlrcpp::Any AntlrAstBuilder::visitTest(Python3Parser::TestContext *ctx) {
+    if (ctx->lambdef()) {
+        return result(node(ctx->lambdef()));
+    }
+
+    const auto or_tests = ctx->or_test();
+    if (or_tests.size() > 1) {
+        const auto body = node(or_tests[0]);
+        return result(new IfStmt(node(or_tests[1]), body, node(ctx->test())));
+    }
+    return result(node(or_tests[0]));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitLambdef(Python3Parser::LambdefContext *ctx) {
+    const auto args = ctx->varargslist() ? parameters(ctx->varargslist()) : nullptr;
+    return result(new Lambda(args, node(ctx->test())));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitLambdef_nocond(Python3Parser::Lambdef_nocondContext *ctx) {
+    const auto args = ctx->varargslist() ? parameters(ctx->varargslist()) : nullptr;
+    return result(new Lambda(args, node(ctx->test_nocond())));
+}
+
+Node *AntlrAstBuilder::binary(antlr4::ParserRuleContext *ctx) {
+    auto left = node(ctx->children[0]);
+    for (size_t i = 1; i + 1 < ctx->children.size(); i += 2) {
+        const auto op = static_cast<int32_t>(tokenType(ctx->children[i]));
+        const auto right = node(ctx->children[i + 1]);
+        if (op == Python3Parser::OR || op == Python3Parser::AND) {
+            left = new BoolOp(left, right, op);
+        } else {
+            left = new BinOp(left, right, op);
+        }
+    }
+    return left;
+}
+
+antlrcpp::Any AntlrAstBuilder::visitOr_test(Python3Parser::Or_testContext *ctx) {
+    return result(binary(ctx));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitAnd_test(Python3Parser::And_testContext *ctx) {
+    return result(binary(ctx));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitNot_test(Python3Parser::Not_testContext *ctx) {
+    if (ctx->not_test()) {
+        return result(new UnaryOp(Python3Parser::NOT, node(ctx->not_test())));
+    }
+    return result(node(ctx->comparison()));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitComparison(Python3Parser::ComparisonContext *ctx) {
+    const auto exprs = ctx->expr();
+    const auto comp_ops = ctx->comp_op();
+    auto left = node(exprs[0]);
+    for (size_t i = 0; i < comp_ops.size(); ++i) {
+        left = new Comparison(left, node(exprs[i + 1]), compOp(comp_ops[i]));
+    }
+    return result(left);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitStar_expr(Python3Parser::Star_exprContext *ctx) {
+    return result(new StarredExpr(node(ctx->expr())));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitExpr(Python3Parser::ExprContext *ctx) {
+    return result(binary(ctx));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitXor_expr(Python3Parser::Xor_exprContext *ctx) {
+    return result(binary(ctx));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitAnd_expr(Python3Parser::And_exprContext *ctx) {
+    return result(binary(ctx));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitShift_expr(Python3Parser::Shift_exprContext *ctx) {
+    return result(binary(ctx));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitArith_expr(Python3Parser::Arith_exprContext *ctx) {
+    return result(binary(ctx));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitTerm(Python3Parser::TermContext *ctx) {
+    return result(binary(ctx));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitFactor(Python3Parser::FactorContext *ctx) {
+    if (ctx->factor()) {
+        return result(new UnaryOp(static_cast<int32_t>(tokenType(ctx->children[0])), node(ctx->factor())));
+    }
+    return result(node(ctx->power()));
+}
+
+antlrcpp::Any AntlrAstBuilder::visitPower(Python3Parser::PowerContext *ctx) {
+    const auto atom_expr = node(ctx->atom_expr());
+    if (ctx->factor()) {
+        return result(new BinOp(atom_expr, node(ctx->factor()), Python3Parser::POWER));
+    }
+    return result(atom_expr);
+}
+
+// atom_expr: (AWAIT)? atom trailer*; there's no node for await, parseAtomExpr() drops it
+antlrcpp::Any AntlrAstBuilder::visitAtom_expr(Python3Parser::Atom_exprContext *ctx) {
+    auto atom = node(ctx->atom());
+    for (const auto trailer : ctx->trailer()) {
+        switch (tokenType(trailer->children[0])) {
+            case Python3Parser::OPEN_PAREN:
+                atom = new Call(atom, arguments(trailer->arglist()));
+                break;
+            case Python3Parser::OPEN_BRACK: {
+                const auto subscripts = trailer->subscriptlist()->subscript();
+                if (subscripts.size() == 1 && !hasToken(trailer->subscriptlist(), Python3Parser::COMMA)) {
+                    atom = new Subscript(atom, slice(subscripts[0]));
+                } else {
+                    auto ext_slice = new ExtSlice({});
+                    for (const auto subscript : subscripts) {
+                        ext_slice->dims.push_back(slice(subscript));
+                    }
+                    atom = new Subscript(atom, ext_slice);
+                }
+                break;
+            }
+            default:
+                atom = new Attribute(atom, name(trailer->NAME()));
+                break;
+        }
+    }
+    return result(atom);
+}
+
+// subscript: test | (test)? ':' (test)? (sliceop)?;
+Node *AntlrAstBuilder::slice(Python3Parser::SubscriptContext *ctx) {
+    if (!hasToken(ctx, Python3Parser::COLON)) {
+        return new Index(node(ctx->test(0)));
+    }
+
+    auto slice = new Slice(nullptr, nullptr, nullptr);
+    bool is_upper = false;
+    for (const auto child : ctx->children) {
+        if (tokenType(child) == Python3Parser::COLON) {
+            is_upper = true;
+        } else if (const auto sliceop = dynamic_cast<Python3Parser::SliceopContext *>(child)) {
+            slice->step = node(sliceop->test());
+        } else if (is_upper) {
+            slice->upper = node(child);
+        } else {
+            slice->lower = node(child);
+        }
+    }
+    return slice;
+}
+
+antlrcpp::Any AntlrAstBuilder::visitAtom(Python3Parser::AtomContext *ctx) {
+    switch (tokenType(ctx->children[0])) {
+        case Python3Parser::OPEN_PAREN: {
+            if (ctx->yield_expr()) {
+                return result(node(ctx->yield_expr()));
+            }
+            const auto testlist_comp = ctx->testlist_comp();
+            if (!testlist_comp) {
+                // empty tuple
+                return result(new TestList({}));
+            }
+            if (testlist_comp->comp_for()) {
+                return result(new GeneratorExp(node(testlist_comp->children[0]),
+                                               comprehensions(testlist_comp->comp_for())));
+            }
+            if (!hasToken(testlist_comp, Python3Parser::COMMA)) {
+                return result(node(testlist_comp->children[0]));
+            }
+            auto tuple = new TestList({});
+            for (const auto child : testlist_comp->children) {
+                if (!tokenType(child)) {
+                    tuple->nodes.push_back(node(child));
+                }
+            }
+            return result(tuple);
+        }
+        case Python3Parser::OPEN_BRACK: {
+            const auto testlist_comp = ctx->testlist_comp();
+            if (!testlist_comp) {
+                return result(new List({}));
+            }
+            if (testlist_comp->comp_for()) {
+                return result(new ListComp(node(testlist_comp->children[0]),
+                                           comprehensions(testlist_comp->comp_for())));
+            }
+            auto list = new List({});
+            for (const auto child : testlist_comp->children) {
+                if (!tokenType(child)) {
+                    list->elements.push_back(node(child));
+                }
+            }
+            return result(list);
+        }
+        case Python3Parser::OPEN_BRACE:
+            if (!ctx->dictorsetmaker()) {
+                return result(new Dict({}, {}));
+            }
+            return result(node(ctx->dictorsetmaker()));
+        case Python3Parser::NAME:
+            return result(name(ctx->NAME()));
+        case Python3Parser::NUMBER: {
+            const auto text = keep(ctx->NUMBER()->getText());
+            return result(new Const(text, decodeNumber(text)));
+        }
+        case Python3Parser::STRING: {
+            // adjacent literals are concatenated
+            for (const auto string : ctx->STRING()) {
+                literals_.append(keep(string->getText()));
+            }
+            const auto literal = literals_.finish();
+            auto str_const = new Const(literals_.value(literal), Python3Parser::STRING);
+            str_const->literal = literal;
+            return result(str_const);
+        }
+        default:
+            // '...', None, True and False
+            return result(new Const(keep(ctx->getText()), Python3Parser::NONE));
+    }
+}
+
+NodeList AntlrAstBuilder::comprehensions(Python3Parser::Comp_forContext *ctx) {
+    NodeList generators;
+    auto comp_for = ctx;
+    while (comp_for) {
+        auto comprehension = new Comprehension(node(comp_for->exprlist()), node(comp_for->or_test()), {},
+                                               comp_for->ASYNC() != nullptr);
+        generators.push_back(comprehension);
+
+        auto comp_iter = comp_for->comp_iter();
+        comp_for = nullptr;
+        while (comp_iter) {
+            if (comp_iter->comp_for()) {
+                comp_for = comp_iter->comp_for();
+                break;
+            }
+            comprehension->ifs.push_back(node(comp_iter->comp_if()->test_nocond()));
+            comp_iter = comp_iter->comp_if()->comp_iter();
+        }
+    }
+    return generators;
+}
+
+antlrcpp::Any AntlrAstBuilder::visitExprlist(Python3Parser::ExprlistContext *ctx) {
+    auto expr_list = new ExprList({});
+    for (const auto child : ctx->children) {
+        if (!tokenType(child)) {
+            expr_list->expr_list.push_back(node(child));
+        }
+    }
+    return result(expr_list);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitTestlist(Python3Parser::TestlistContext *ctx) {
+    auto test_list = new TestList({});
+    for (const auto test : ctx->test()) {
+        test_list->nodes.push_back(node(test));
+    }
+    return result(test_list);
+}
+
+// dictorsetmaker: ( ((test ':' test | '**' expr) (comp_for | (',' (test ':' test | '**' expr))* (',')?)) |
+//                   ((test | star_expr) (comp_for | (',' (test | star_expr))* (',')?)) );
+antlrcpp::Any AntlrAstBuilder::visitDictorsetmaker(Python3Parser::DictorsetmakerContext *ctx) {
+    const auto is_dict = hasToken(ctx, Python3Parser::COLON) || hasToken(ctx, Python3Parser::POWER);
+    if (ctx->comp_for()) {
+        if (is_dict) {
+            const auto key = node(ctx->children[0]);
+            return result(new DictComp(key, node(ctx->children[2]), comprehensions(ctx->comp_for())));
+        }
+        return result(new SetComp(node(ctx->children[0]), comprehensions(ctx->comp_for())));
+    }
+
+    if (!is_dict) {
+        auto set = new Set({});
+        for (const auto child : ctx->children) {
+            if (!tokenType(child)) {
+                set->elements.push_back(node(child));
+            }
+        }
+        return result(set);
+    }
+
+    // a '**' mapping has a value but no key, the way parseDictorsetmaker() has it
+    auto dict = new Dict({}, {});
+    for (size_t i = 0; i < ctx->children.size(); ++i) {
+        const auto child = ctx->children[i];
+        if (tokenType(child) == Python3Parser::POWER) {
+            dict->values.push_back(node(ctx->children[++i]));
+        } else if (!tokenType(child)) {
+            dict->keys.push_back(node(child));
+            i += 2;
+            dict->values.push_back(node(ctx->children[i]));
+        }
+    }
+    return result(dict);
+}
+
+antlrcpp::Any AntlrAstBuilder::visitClassdef(Python3Parser::ClassdefContext *ctx) {
+    const auto class_name = keep(ctx->NAME()->getText());
+    auto class_def = new ClassDef(class_name, arguments(ctx->arglist()), nullptr, {});
+    class_def->name_symbol = symbols_.intern(class_name);
+    class_def->body = node(ctx->suite());
+    return result(class_def);
+}
+
+Arguments *AntlrAstBuilder::arguments(Python3Parser::ArglistContext *ctx) {
+    if (!ctx) {
+        return nullptr;
+    }
+
+    auto arguments = new Arguments({}, {});
+    for (const auto argument : ctx->argument()) {
+        const auto arg = node(argument);
+        if (dynamic_cast<Keyword *>(arg)) {
+            arguments->keywords.push_back(arg);
+        } else {
+            arguments->args.push_back(arg);
+        }
+    }
+    return arguments;
+}
+
+// argument: ( test (comp_for)? | test '=' test | '**' test | '*' test );
+antlrcpp::Any AntlrAstBuilder::visitArgument(Python3Parser::ArgumentContext *ctx) {
+    const auto tests = ctx->test();
+    switch (tokenType(ctx->children[0])) {
+        case Python3Parser::POWER:
+            return result(new Keyword("", NO_SYMBOL, node(tests[0])));
+        case Python3Parser::STAR:
+            return result(new StarredExpr(node(tests[0])));
+        default:
+            break;
+    }
+
+    if (ctx->comp_for()) {
+        return result(new GeneratorExp(node(tests[0]), comprehensions(ctx->comp_for())));
+    }
+    if (tests.size() > 1) {
+        // the name is kept as the text and the symbol of the keyword
+        const auto arg = keep(tests[0]->getText());
+        return result(new Keyword(arg, symbols_.intern(arg), node(tests[1])));
+    }
+    return result(node(tests[0]));
+}
+
+// yield_expr: 'yield' (yield_arg)?; yield_arg: 'from' test | testlist;
+antlrcpp::Any AntlrAstBuilder::visitYield_expr(Python3Parser::Yield_exprContext *ctx) {
+    const auto yield_arg = ctx->yield_arg();
+    if (yield_arg && yield_arg->test()) {
+        return result(new YieldFrom(node(yield_arg->test())));
+    }
+    return result(new Yield(yield_arg ? node(yield_arg->testlist()) : nullptr));
+}
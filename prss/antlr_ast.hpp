@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Python3BaseVisitor.h"
+#include "literals.hpp"
+#include "parser.hpp"
+#include "symbols.hpp"
+
+// Converts the parse tree ANTLR builds with Python3Parser::file_input() into the AST parse() builds, so that
+// the two front ends can be checked against each other with astEqual().
+//
+// The tree is the one the grammar means, in the nodes prss has for it: a parenthesized expression is the expression
+// itself, a parenthesized one with a comma is a TestList, and a generator in parentheses is a GeneratorExp. Where
+// prss has no node for something (await, the middle targets of a chained assignment) it's dropped the way parse()
+// drops it.
+//
+// Names, numbers and strings refer to the text the builder keeps, and the nodes live in its arena, hence the
+// builder has to outlive the trees it builds. Every visit returns an antlrcpp::Any holding a Node *.
+class AntlrAstBuilder : public Python3BaseVisitor {
+public:
+    // Builds the tree of a whole file, it goes away with the builder
+    Node *build(Python3Parser::File_inputContext *file_input);
+
+    antlrcpp::Any visitFile_input(Python3Parser::File_inputContext *ctx) override;
+
+    antlrcpp::Any visitDecorated(Python3Parser::DecoratedContext *ctx) override;
+
+    antlrcpp::Any visitAsync_funcdef(Python3Parser::Async_funcdefContext *ctx) override;
+
+    antlrcpp::Any visitFuncdef(Python3Parser::FuncdefContext *ctx) override;
+
+    antlrcpp::Any visitSimple_stmt(Python3Parser::Simple_stmtContext *ctx) override;
+
+    antlrcpp::Any visitExpr_stmt(Python3Parser::Expr_stmtContext *ctx) override;
+
+    antlrcpp::Any visitTestlist_star_expr(Python3Parser::Testlist_star_exprContext *ctx) override;
+
+    antlrcpp::Any visitDel_stmt(Python3Parser::Del_stmtContext *ctx) override;
+
+    antlrcpp::Any visitPass_stmt(Python3Parser::Pass_stmtContext *ctx) override;
+
+    antlrcpp::Any visitBreak_stmt(Python3Parser::Break_stmtContext *ctx) override;
+
+    antlrcpp::Any visitContinue_stmt(Python3Parser::Continue_stmtContext *ctx) override;
+
+    antlrcpp::Any visitReturn_stmt(Python3Parser::Return_stmtContext *ctx) override;
+
+    antlrcpp::Any visitRaise_stmt(Python3Parser::Raise_stmtContext *ctx) override;
+
+    antlrcpp::Any visitImport_name(Python3Parser::Import_nameContext *ctx) override;
+
+    antlrcpp::Any visitImport_from(Python3Parser::Import_fromContext *ctx) override;
+
+    antlrcpp::Any visitGlobal_stmt(Python3Parser::Global_stmtContext *ctx) override;
+
+    antlrcpp::Any visitNonlocal_stmt(Python3Parser::Nonlocal_stmtContext *ctx) override;
+
+    antlrcpp::Any visitAssert_stmt(Python3Parser::Assert_stmtContext *ctx) override;
+
+    antlrcpp::Any visitAsync_stmt(Python3Parser::Async_stmtContext *ctx) override;
+
+    antlrcpp::Any visitIf_stmt(Python3Parser::If_stmtContext *ctx) override;
+
+    antlrcpp::Any visitWhile_stmt(Python3Parser::While_stmtContext *ctx) override;
+
+    antlrcpp::Any visitFor_stmt(Python3Parser::For_stmtContext *ctx) override;
+
+    antlrcpp::Any visitTry_stmt(Python3Parser::Try_stmtContext *ctx) override;
+
+    antlrcpp::Any visitWith_stmt(Python3Parser::With_stmtContext *ctx) override;
+
+    antlrcpp::Any visitWith_item(Python3Parser::With_itemContext *ctx) override;
+
+    antlrcpp::Any visitSuite(Python3Parser::SuiteContext *ctx) override;
+
+    antlrcpp::Any visitTest(Python3Parser::TestContext *ctx) override;
+
+    antlrcpp::Any visitLambdef(Python3Parser::LambdefContext *ctx) override;
+
+    antlrcpp::Any visitLambdef_nocond(Python3Parser::Lambdef_nocondContext *ctx) override;
+
+    antlrcpp::Any visitOr_test(Python3Parser::Or_testContext *ctx) override;
+
+    antlrcpp::Any visitAnd_test(Python3Parser::And_testContext *ctx) override;
+
+    antlrcpp::Any visitNot_test(Python3Parser::Not_testContext *ctx) override;
+
+    antlrcpp::Any visitComparison(Python3Parser::ComparisonContext *ctx) override;
+
+    antlrcpp::Any visitStar_expr(Python3Parser::Star_exprContext *ctx) override;
+
+    antlrcpp::Any visitExpr(Python3Parser::ExprContext *ctx) override;
+
+    antlrcpp::Any visitXor_expr(Python3Parser::Xor_exprContext *ctx) override;
+
+    antlrcpp::Any visitAnd_expr(Python3Parser::And_exprContext *ctx) override;
+
+    antlrcpp::Any visitShift_expr(Python3Parser::Shift_exprContext *ctx) override;
+
+    antlrcpp::Any visitArith_expr(Python3Parser::Arith_exprContext *ctx) override;
+
+    antlrcpp::Any visitTerm(Python3Parser::TermContext *ctx) override;
+
+    antlrcpp::Any visitFactor(Python3Parser::FactorContext *ctx) override;
+
+    antlrcpp::Any visitPower(Python3Parser::PowerContext *ctx) override;
+
+    antlrcpp::Any visitAtom_expr(Python3Parser::Atom_exprContext *ctx) override;
+
+    antlrcpp::Any visitAtom(Python3Parser::AtomContext *ctx) override;
+
+    antlrcpp::Any visitExprlist(Python3Parser::ExprlistContext *ctx) override;
+
+    antlrcpp::Any visitTestlist(Python3Parser::TestlistContext *ctx) override;
+
+    antlrcpp::Any visitDictorsetmaker(Python3Parser::DictorsetmakerContext *ctx) override;
+
+    antlrcpp::Any visitClassdef(Python3Parser::ClassdefContext *ctx) override;
+
+    antlrcpp::Any visitArgument(Python3Parser::ArgumentContext *ctx) override;
+
+    antlrcpp::Any visitYield_expr(Python3Parser::Yield_exprContext *ctx) override;
+
+private:
+    // the node of a subtree, null for a missing one
+    Node *node(antlr4::tree::ParseTree *tree);
+
+    std::string_view keep(std::string &&text);
+
+    Name *name(antlr4::tree::TerminalNode *terminal);
+
+    // a dotted name is a single Name, the way parseDottedName() makes it
+    Name *dottedName(Python3Parser::Dotted_nameContext *ctx);
+
+    // typedargslist and varargslist, which only differ in the annotations
+    Parameters *parameters(antlr4::ParserRuleContext *ctx);
+
+    Arguments *arguments(Python3Parser::ArglistContext *ctx);
+
+    // the comp_for and the comp_iters following it, a Comprehension per 'for' with the 'if's folded into it
+    NodeList comprehensions(Python3Parser::Comp_forContext *ctx);
+
+    Node *slice(Python3Parser::SubscriptContext *ctx);
+
+    // a left fold of the operands of a rule of the form operand (op operand)*, into BinOps
+    Node *binary(antlr4::ParserRuleContext *ctx);
+
+    Arena arena_;
+    std::deque<std::string> texts_;
+    SymbolTable symbols_;
+    LiteralPool literals_;
+};
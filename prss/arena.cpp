@@ -0,0 +1,44 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <new>
+
+void Arena::release() noexcept {
+    while (chunks_) {
+        const auto prev = chunks_->prev;
+        ::operator delete(chunks_, chunks_->size);
+        chunks_ = prev;
+    }
+    cursor_ = 0;
+    limit_ = 0;
+    num_of_reserved_bytes_ = 0;
+    next_chunk_size_ = MIN_CHUNK_SIZE;
+}
+
+void *Arena::allocateChunk(size_t size, size_t alignment) {
+    const auto needed = sizeof(Chunk) + size + alignment;
+    const auto is_big = needed > next_chunk_size_ / 4;
+    const auto chunk_size = is_big ? needed : next_chunk_size_;
+
+    const auto chunk = static_cast<Chunk *>(::operator new(chunk_size));
+    chunk->size = chunk_size;
+    num_of_reserved_bytes_ += chunk_size;
+
+    const auto begin = reinterpret_cast<uintptr_t>(chunk + 1);
+    const auto start = (begin + alignment - 1) & ~(alignment - 1);
+    if (is_big && chunks_) {
+        // the rest of the current chunk is still good for the small allocations, the big one goes behind it
+        chunk->prev = chunks_->prev;
+        chunks_->prev = chunk;
+        return reinterpret_cast<void *>(start);
+    }
+
+    chunk->prev = chunks_;
+    chunks_ = chunk;
+    if (!is_big) {
+        next_chunk_size_ = std::min(next_chunk_size_ * 2, MAX_CHUNK_SIZE);
+    }
+    cursor_ = start + size;
+    limit_ = reinterpret_cast<uintptr_t>(chunk) + chunk_size;
+    return reinterpret_cast<void *>(start);
+}
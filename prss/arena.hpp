@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// A bump allocator, the nodes of a tree (along with the arrays of their children) are allocated out of one and go
+// away all at once with it. Memory comes in chunks growing from MIN_CHUNK_SIZE up to MAX_CHUNK_SIZE, whatever
+// doesn't fit into the rest of a chunk starts a new one (and a big allocation gets a chunk of its own). Nothing is
+// freed on its own, except for the last allocation, which gives its memory back if it's deallocated right away.
+//
+// An arena is used by one thread at a time, the nodes made on a thread go to the arena of its ArenaScope.
+class Arena {
+public:
+    static constexpr size_t MIN_CHUNK_SIZE = 64 << 10;
+    static constexpr size_t MAX_CHUNK_SIZE = 4 << 20;
+
+    Arena() = default;
+
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena() { release(); }
+
+    inline void *allocate(size_t size, size_t alignment) {
+        const auto start = (cursor_ + alignment - 1) & ~(alignment - 1);
+        if (start + size > limit_ || start < cursor_) {
+            return allocateChunk(size, alignment);
+        }
+        cursor_ = start + size;
+        return reinterpret_cast<void *>(start);
+    }
+
+    inline void deallocate(void *ptr, size_t size) noexcept {
+        if (reinterpret_cast<uintptr_t>(ptr) + size == cursor_) {
+            cursor_ = reinterpret_cast<uintptr_t>(ptr);
+        }
+    }
+
+    // Frees every chunk, whatever was allocated out of the arena is gone. The arena may be used again.
+    void release() noexcept;
+
+    // the memory taken from the heap, and the part of it handed out so far (along with the ends of the chunks
+    // nothing fit into)
+    inline size_t reservedBytes() const noexcept { return num_of_reserved_bytes_; }
+
+    inline size_t usedBytes() const noexcept { return num_of_reserved_bytes_ - (limit_ - cursor_); }
+
+    // the arena of the innermost ArenaScope of the thread, null if there's none
+    static inline Arena *current() noexcept { return current_; }
+
+private:
+    friend class ArenaScope;
+
+    struct Chunk {
+        Chunk *prev;
+        size_t size;
+    };
+
+    void *allocateChunk(size_t size, size_t alignment);
+
+    Chunk *chunks_ = nullptr;
+    uintptr_t cursor_ = 0;
+    uintptr_t limit_ = 0;
+    size_t num_of_reserved_bytes_ = 0;
+    size_t next_chunk_size_ = MIN_CHUNK_SIZE;
+
+    static inline thread_local Arena *current_ = nullptr;
+};
+
+// Makes the arena the one the nodes (and the ArenaAllocators) made on the thread go to, for as long as it lives
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena &arena) : prev_(Arena::current_) {
+        Arena::current_ = &arena;
+    }
+
+    ArenaScope(const ArenaScope &) = delete;
+
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+    ~ArenaScope() {
+        Arena::current_ = prev_;
+    }
+
+private:
+    Arena *prev_;
+};
+
+// Allocates out of the arena current when it was made, or off the heap if there was none. The copies of an
+// allocator share its arena, so a container keeps allocating out of the arena it was made in wherever it's used.
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() noexcept : arena_(Arena::current()) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena_(other.arena()) {}
+
+    inline T *allocate(size_t n) {
+        if (arena_) {
+            return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    inline void deallocate(T *ptr, size_t n) noexcept {
+        if (arena_) {
+            arena_->deallocate(ptr, n * sizeof(T));
+        } else {
+            std::allocator<T>().deallocate(ptr, n);
+        }
+    }
+
+    inline Arena *arena() const noexcept { return arena_; }
+
+    template<typename U>
+    inline bool operator==(const ArenaAllocator<U> &other) const noexcept { return arena_ == other.arena(); }
+
+    template<typename U>
+    inline bool operator!=(const ArenaAllocator<U> &other) const noexcept { return arena_ != other.arena(); }
+
+private:
+    Arena *arena_;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,753 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <cmath>
+#include <malloc.h>
+#include <map>
+#include <new>
+#include <sstream>
+
+#include "parser.hpp"
+#include "visitor.hpp"
+
+// Runs the phases of the front end (lexing, parsing, dumping the tree, walking it and destroying it) over corpora of Python
+// files, reports the throughput and the allocations of each phase as JSON, and compares it to a saved baseline.
+// With --per-file every file is a corpus of its own, and how each phase grows with the size of the files of a
+// directory (like the ones grammar/gen_corpus.py writes) is reported too.
+
+namespace {
+    // every allocation of the process, the phases count their own as the difference
+    std::atomic<size_t> num_of_allocs{0};
+    std::atomic<size_t> num_of_alloc_bytes{0};
+    // the heap in use, as malloc counts it, and the most of it in use since the last reset
+    std::atomic<size_t> num_of_live_bytes{0};
+    std::atomic<size_t> peak_live_bytes{0};
+}
+
+// gcc takes the pointers freed here for the ones of its own operator new
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void *operator new(size_t size) {
+    num_of_allocs.fetch_add(1, std::memory_order_relaxed);
+    num_of_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (auto ptr = malloc(size ? size : 1)) {
+        const auto live = num_of_live_bytes.fetch_add(malloc_usable_size(ptr), std::memory_order_relaxed) +
+                          malloc_usable_size(ptr);
+        auto peak = peak_live_bytes.load(std::memory_order_relaxed);
+        while (live > peak && !peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    num_of_live_bytes.fetch_sub(malloc_usable_size(ptr), std::memory_order_relaxed);
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+#pragma GCC diagnostic pop
+
+namespace {
+    enum class Phase : uint8_t {
+        LEX,
+        PARSE,
+        DUMP,
+        WALK,
+        VISIT,
+        VISIT_VIRTUAL,
+        DESTROY,
+        NUM_OF_PHASES,
+    };
+
+    constexpr size_t NUM_OF_PHASES = static_cast<size_t>(Phase::NUM_OF_PHASES);
+
+    constexpr const char *PHASE_NAMES[NUM_OF_PHASES] = {"lex", "parse", "dump", "walk", "visit", "visit_virtual",
+                                                                "destroy"};
+
+    struct PhaseStats {
+        // the best run
+        double ms = 0;
+        // the allocations of a run, the same for every one of them
+        size_t allocs = 0;
+        size_t alloc_bytes = 0;
+    };
+
+    struct Corpus {
+        std::string name;
+        std::vector<std::string> paths;
+        // the directory the file of a --per-file corpus came from
+        std::string group;
+        size_t num_of_bytes = 0;
+        size_t num_of_tokens = 0;
+        size_t num_of_nodes = 0;
+        size_t num_of_errors = 0;
+        // the most heap a file of the corpus took, from lexing it to destroying its tree
+        size_t peak_heap_bytes = 0;
+        PhaseStats phases[NUM_OF_PHASES];
+    };
+
+    // What the visit phases count, the nodes along with a couple of kinds of them
+    struct NodeCounts {
+        size_t num_of_nodes = 0;
+        size_t num_of_names = 0;
+        size_t num_of_calls = 0;
+
+        inline bool operator==(const NodeCounts &other) const noexcept {
+            return num_of_nodes == other.num_of_nodes && num_of_names == other.num_of_names &&
+                   num_of_calls == other.num_of_calls;
+        }
+    };
+
+    // The visit phase, an AstVisitor, its methods are inlined into the switch on the kind
+    class CountingVisitor : public AstVisitor<CountingVisitor> {
+    public:
+        inline bool visitNode(Node *) {
+            counts.num_of_nodes++;
+            return true;
+        }
+
+        inline bool visitName(Name *) {
+            counts.num_of_nodes++;
+            counts.num_of_names++;
+            return true;
+        }
+
+        inline bool visitCall(Call *) {
+            counts.num_of_nodes++;
+            counts.num_of_calls++;
+            return true;
+        }
+
+        NodeCounts counts;
+    };
+
+    // The same traversal dispatched the classic way, for the visit_virtual phase: a visitor with a virtual method
+    // per kind, one call through the vtable per node
+    class VirtualVisitor {
+    public:
+        virtual ~VirtualVisitor() = default;
+
+        void walk(Node *root) {
+            stack_.clear();
+            if (root) {
+                stack_.push_back(root);
+            }
+            while (!stack_.empty()) {
+                const auto node = stack_.back();
+                stack_.pop_back();
+                if (!dispatch(node)) {
+                    continue;
+                }
+
+                const auto num_of_nodes = stack_.size();
+                node->forEachChild([&](Node *child) {
+                    if (child) {
+                        stack_.push_back(child);
+                    }
+                });
+                std::reverse(stack_.begin() + num_of_nodes, stack_.end());
+            }
+        }
+
+        virtual bool visitNode(Node *) { return true; }
+
+#define PRSS_NODE_KIND(name) \
+        virtual bool visit##name(name *node) { return visitNode(node); }
+        PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+
+    private:
+        bool dispatch(Node *node) {
+            switch (node->kind) {
+#define PRSS_NODE_KIND(name) \
+                case NodeKind::name: \
+                    return visit##name(static_cast<name *>(node));
+                PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+            }
+            return true;
+        }
+
+        std::vector<Node *> stack_;
+    };
+
+    class VirtualCountingVisitor : public VirtualVisitor {
+    public:
+        bool visitNode(Node *) override {
+            counts.num_of_nodes++;
+            return true;
+        }
+
+        bool visitName(Name *) override {
+            counts.num_of_nodes++;
+            counts.num_of_names++;
+            return true;
+        }
+
+        bool visitCall(Call *) override {
+            counts.num_of_nodes++;
+            counts.num_of_calls++;
+            return true;
+        }
+
+        NodeCounts counts;
+    };
+
+    // the growth of a phase (as time against size) past which a group of corpora is reported as superlinear
+    constexpr double SUPERLINEAR_EXPONENT = 1.2;
+    // the files fitted, the smaller ones are all overhead
+    constexpr size_t MIN_SCALING_BYTES = 64 << 10;
+
+    // Times a phase of a run, adding its time and allocations to the totals of the run
+    template<typename Fn>
+    void timePhase(PhaseStats &totals, Fn &&fn) {
+        using clock = std::chrono::steady_clock;
+
+        const auto allocs = num_of_allocs.load(std::memory_order_relaxed);
+        const auto alloc_bytes = num_of_alloc_bytes.load(std::memory_order_relaxed);
+        const auto start = clock::now();
+        fn();
+        const auto end = clock::now();
+        totals.ms += std::chrono::duration<double, std::milli>(end - start).count();
+        totals.allocs += num_of_allocs.load(std::memory_order_relaxed) - allocs;
+        totals.alloc_bytes += num_of_alloc_bytes.load(std::memory_order_relaxed) - alloc_bytes;
+    }
+
+    // Runs every phase over every file of the corpus num_of_runs times, keeping the best time of each phase
+    void benchCorpus(Corpus &corpus, const LexerOptions &options, int32_t num_of_runs) {
+        for (int32_t run = 0; run < num_of_runs; ++run) {
+            PhaseStats totals[NUM_OF_PHASES];
+            size_t num_of_bytes = 0;
+            size_t num_of_tokens = 0;
+            size_t num_of_nodes = 0;
+            size_t num_of_errors = 0;
+            size_t peak_heap_bytes = 0;
+
+            for (const auto &path: corpus.paths) {
+                PyLexer *lexer = nullptr;
+                ParseResult result;
+                std::string dump;
+
+                const auto live_bytes = num_of_live_bytes.load(std::memory_order_relaxed);
+                peak_live_bytes.store(live_bytes, std::memory_order_relaxed);
+
+                timePhase(totals[static_cast<size_t>(Phase::LEX)], [&]() {
+                    lexer = new PyLexer(path.c_str(), options);
+                });
+                timePhase(totals[static_cast<size_t>(Phase::PARSE)], [&]() {
+                    result = parse(*lexer);
+                });
+                timePhase(totals[static_cast<size_t>(Phase::DUMP)], [&]() {
+                    dump = result.root ? result.root->str() : "";
+                });
+                timePhase(totals[static_cast<size_t>(Phase::WALK)], [&]() {
+                    num_of_nodes += astNumNodes(result.root);
+                });
+                CountingVisitor visitor;
+                timePhase(totals[static_cast<size_t>(Phase::VISIT)], [&]() {
+                    visitor.walk(result.root);
+                });
+                VirtualCountingVisitor virtual_visitor;
+                timePhase(totals[static_cast<size_t>(Phase::VISIT_VIRTUAL)], [&]() {
+                    virtual_visitor.walk(result.root);
+                });
+                if (!(visitor.counts == virtual_visitor.counts)) {
+                    fprintf(stderr, "%s: the visitors counted different nodes\n", path.c_str());
+                }
+
+                num_of_bytes += lexer->source().size();
+                num_of_tokens += lexer->tokens().size();
+                num_of_errors += result.errors.size();
+
+                timePhase(totals[static_cast<size_t>(Phase::DESTROY)], [&]() {
+                    lexer->arena().release();
+                });
+                delete lexer;
+                peak_heap_bytes = std::max(peak_heap_bytes,
+                                           peak_live_bytes.load(std::memory_order_relaxed) - live_bytes);
+            }
+
+            corpus.num_of_bytes = num_of_bytes;
+            corpus.num_of_tokens = num_of_tokens;
+            corpus.num_of_nodes = num_of_nodes;
+            corpus.num_of_errors = num_of_errors;
+            corpus.peak_heap_bytes = peak_heap_bytes;
+            for (size_t i = 0; i < NUM_OF_PHASES; ++i) {
+                if (run == 0 || totals[i].ms < corpus.phases[i].ms) {
+                    corpus.phases[i].ms = totals[i].ms;
+                }
+                corpus.phases[i].allocs = totals[i].allocs;
+                corpus.phases[i].alloc_bytes = totals[i].alloc_bytes;
+            }
+        }
+    }
+
+    // A corpus out of a file, or out of the *.py files in a directory (and the ones under it)
+    bool collectCorpus(const std::string &path, Corpus &corpus) {
+        namespace fs = std::filesystem;
+
+        std::error_code error;
+        corpus.name = path;
+        if (fs::is_directory(path, error)) {
+            for (const auto &entry: fs::recursive_directory_iterator(path, error)) {
+                if (entry.is_regular_file() && entry.path().extension() == ".py") {
+                    corpus.paths.push_back(entry.path().string());
+                }
+            }
+            // the order of a directory listing isn't stable
+            std::sort(corpus.paths.begin(), corpus.paths.end());
+        } else if (fs::is_regular_file(path, error)) {
+            corpus.paths.push_back(path);
+        }
+
+        return !corpus.paths.empty();
+    }
+
+    // Writes the synthetic corpora into dir: the sources concatenated up to scale_mb MB, and the chains
+    // nested deeper than any real code, which only get as deep on the AST (the parser loops over them)
+    std::vector<Corpus> writeSyntheticCorpora(const std::string &dir, const std::vector<std::string> &sources,
+                                              size_t scale_mb) {
+        std::vector<Corpus> corpora;
+
+        std::string text;
+        for (const auto &path: sources) {
+            const SourceBuffer source(path.c_str());
+            text.append(source.data(), source.size());
+            if (!text.empty() && text.back() != '\n') {
+                text.push_back('\n');
+            }
+        }
+        if (!text.empty() && scale_mb > 0) {
+            const auto path = dir + "/scaled.py";
+            std::ofstream scaled(path, std::ios::binary);
+            for (size_t size = 0; size < scale_mb << 20; size += text.size()) {
+                scaled << text;
+            }
+            Corpus corpus;
+            corpus.name = "synthetic/scaled";
+            corpus.paths = {path};
+            corpora.push_back(std::move(corpus));
+        }
+
+        constexpr size_t depth = 100000;
+        const auto chain_path = dir + "/chain.py";
+        std::ofstream chain(chain_path, std::ios::binary);
+        chain << "x = a";
+        for (size_t i = 0; i < depth; ++i) {
+            chain << " + a";
+        }
+        chain << "\nif a:\n    pass\n";
+        for (size_t i = 0; i < depth; ++i) {
+            chain << "elif b" << i << ":\n    pass\n";
+        }
+        chain << "else:\n    pass\n";
+        Corpus corpus;
+        corpus.name = "synthetic/chain";
+        corpus.paths = {chain_path};
+        corpora.push_back(std::move(corpus));
+
+        return corpora;
+    }
+
+    // How the phases of the corpora of a group grow with their size, the exponent of a power law fitted to them
+    struct Scaling {
+        std::string group;
+        double phases[NUM_OF_PHASES] = {};
+        double peak_heap = 0;
+    };
+
+    // the slope of the least squares line through the points (log x, log y)
+    double fitExponent(const std::vector<double> &xs, const std::vector<double> &ys) {
+        double mean_x = 0;
+        double mean_y = 0;
+        for (size_t i = 0; i < xs.size(); ++i) {
+            mean_x += std::log(xs[i]) / xs.size();
+            mean_y += std::log(std::max(ys[i], 1e-9)) / xs.size();
+        }
+        double covariance = 0;
+        double variance = 0;
+        for (size_t i = 0; i < xs.size(); ++i) {
+            const auto dx = std::log(xs[i]) - mean_x;
+            covariance += dx * (std::log(std::max(ys[i], 1e-9)) - mean_y);
+            variance += dx * dx;
+        }
+        return variance > 0 ? covariance / variance : 0;
+    }
+
+    // Fits the --per-file corpora of every group, on the files of at least MIN_SCALING_BYTES if there are two
+    // of those, on all of them otherwise
+    std::vector<Scaling> fitScalings(const std::vector<Corpus> &corpora) {
+        std::vector<Scaling> scalings;
+        std::map<std::string, std::vector<const Corpus *>> groups;
+        for (const auto &corpus: corpora) {
+            if (!corpus.group.empty()) {
+                groups[corpus.group].push_back(&corpus);
+            }
+        }
+
+        for (auto &[group, members]: groups) {
+            const auto num_of_large = std::count_if(members.begin(), members.end(), [](const Corpus *corpus) {
+                return corpus->num_of_bytes >= MIN_SCALING_BYTES;
+            });
+            if (num_of_large >= 2) {
+                members.erase(std::remove_if(members.begin(), members.end(), [](const Corpus *corpus) {
+                    return corpus->num_of_bytes < MIN_SCALING_BYTES;
+                }), members.end());
+            }
+            if (members.size() < 2) {
+                continue;
+            }
+
+            Scaling scaling;
+            scaling.group = group;
+            std::vector<double> sizes;
+            std::vector<double> values;
+            for (const auto corpus: members) {
+                sizes.push_back(static_cast<double>(std::max<size_t>(corpus->num_of_bytes, 1)));
+            }
+            for (size_t i = 0; i < NUM_OF_PHASES; ++i) {
+                values.clear();
+                for (const auto corpus: members) {
+                    values.push_back(corpus->phases[i].ms);
+                }
+                scaling.phases[i] = fitExponent(sizes, values);
+            }
+            values.clear();
+            for (const auto corpus: members) {
+                values.push_back(static_cast<double>(corpus->peak_heap_bytes));
+            }
+            scaling.peak_heap = fitExponent(sizes, values);
+            scalings.push_back(std::move(scaling));
+        }
+        return scalings;
+    }
+
+    std::string escapeJson(std::string_view text) {
+        std::string escaped;
+        for (const auto c: text) {
+            if (c == '"' || c == '\\') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(c);
+        }
+        return escaped;
+    }
+
+    void writeJson(FILE *out, const std::vector<Corpus> &corpora, const std::vector<Scaling> &scalings,
+                   int32_t num_of_runs) {
+        fprintf(out, "{\n  \"runs\": %d,\n  \"corpora\": [", num_of_runs);
+        for (size_t i = 0; i < corpora.size(); ++i) {
+            const auto &corpus = corpora[i];
+            fprintf(out, "%s\n    {\"name\": \"%s\", \"files\": %zu, \"bytes\": %zu, \"tokens\": %zu, \"nodes\": %zu, "
+                         "\"errors\": %zu, \"peak_heap_bytes\": %zu, \"phases\": {",
+                    i ? "," : "", escapeJson(corpus.name).c_str(), corpus.paths.size(), corpus.num_of_bytes,
+                    corpus.num_of_tokens, corpus.num_of_nodes, corpus.num_of_errors, corpus.peak_heap_bytes);
+            for (size_t j = 0; j < NUM_OF_PHASES; ++j) {
+                const auto &phase = corpus.phases[j];
+                const auto seconds = std::max(phase.ms, 1e-6) / 1000;
+                fprintf(out, "%s\n      \"%s\": {\"ms\": %.3f, \"mb_per_s\": %.2f, \"tokens_per_s\": %.0f, "
+                             "\"nodes_per_s\": %.0f, \"allocs\": %zu, \"alloc_bytes\": %zu}",
+                        j ? "," : "", PHASE_NAMES[j], phase.ms, corpus.num_of_bytes / seconds / 1e6,
+                        corpus.num_of_tokens / seconds, corpus.num_of_nodes / seconds, phase.allocs,
+                        phase.alloc_bytes);
+            }
+            fprintf(out, "}}");
+        }
+        fprintf(out, "\n  ]");
+
+        if (!scalings.empty()) {
+            fprintf(out, ",\n  \"scaling\": [");
+            for (size_t i = 0; i < scalings.size(); ++i) {
+                const auto &scaling = scalings[i];
+                fprintf(out, "%s\n    {\"group\": \"%s\", \"exponents\": {", i ? "," : "",
+                        escapeJson(scaling.group).c_str());
+                for (size_t j = 0; j < NUM_OF_PHASES; ++j) {
+                    fprintf(out, "\"%s\": %.3f, ", PHASE_NAMES[j], scaling.phases[j]);
+                }
+                fprintf(out, "\"peak_heap\": %.3f}}", scaling.peak_heap);
+            }
+            fprintf(out, "\n  ]");
+        }
+        fprintf(out, "\n}\n");
+    }
+
+    // Just enough of JSON to read back what writeJson() writes: objects, arrays, strings and numbers
+    class JsonReader {
+    public:
+        struct Value {
+            std::string text;
+            double number = 0;
+            std::map<std::string, Value> members;
+            std::vector<Value> items;
+        };
+
+        explicit JsonReader(std::string text) : text_(std::move(text)) {}
+
+        bool read(Value &value) {
+            return readValue(value) && (skipSpaces(), pos_ == text_.size());
+        }
+
+    private:
+        void skipSpaces() {
+            while (pos_ < text_.size() && isspace(static_cast<unsigned char>(text_[pos_]))) {
+                pos_++;
+            }
+        }
+
+        bool readString(std::string &str) {
+            if (text_[pos_] != '"') {
+                return false;
+            }
+            for (pos_++; pos_ < text_.size() && text_[pos_] != '"'; ++pos_) {
+                if (text_[pos_] == '\\') {
+                    pos_++;
+                }
+                str.push_back(text_[pos_]);
+            }
+            return pos_++ < text_.size();
+        }
+
+        bool readValue(Value &value) {
+            skipSpaces();
+            if (pos_ == text_.size()) {
+                return false;
+            }
+
+            const auto c = text_[pos_];
+            if (c == '"') {
+                return readString(value.text);
+            } else if (c == '{' || c == '[') {
+                const auto close = c == '{' ? '}' : ']';
+                pos_++;
+                skipSpaces();
+                if (pos_ < text_.size() && text_[pos_] == close) {
+                    pos_++;
+                    return true;
+                }
+                while (true) {
+                    if (c == '{') {
+                        std::string key;
+                        skipSpaces();
+                        if (!readString(key) || (skipSpaces(), pos_ == text_.size() || text_[pos_++] != ':') ||
+                            !readValue(value.members[key])) {
+                            return false;
+                        }
+                    } else if (!readValue(value.items.emplace_back())) {
+                        return false;
+                    }
+
+                    skipSpaces();
+                    if (pos_ == text_.size()) {
+                        return false;
+                    } else if (text_[pos_] == close) {
+                        pos_++;
+                        return true;
+                    } else if (text_[pos_++] != ',') {
+                        return false;
+                    }
+                }
+            }
+
+            char *end;
+            value.number = strtod(text_.c_str() + pos_, &end);
+            if (end == text_.c_str() + pos_) {
+                return false;
+            }
+            pos_ = end - text_.c_str();
+            return true;
+        }
+
+        std::string text_;
+        size_t pos_ = 0;
+    };
+
+    // Compares the phases of the corpora to the ones of the baseline with the same name. A phase that got slower
+    // by more than tolerance (a fraction), or allocates more than it did, is a regression.
+    int compareToBaseline(const char *baseline_path, const std::vector<Corpus> &corpora, double tolerance) {
+        std::ifstream file(baseline_path);
+        std::stringstream text;
+        text << file.rdbuf();
+
+        JsonReader::Value baseline;
+        if (!file || !JsonReader(text.str()).read(baseline)) {
+            fprintf(stderr, "%s: can't read the baseline\n", baseline_path);
+            return 2;
+        }
+
+        size_t num_of_regressions = 0;
+        for (const auto &old_corpus: baseline.members["corpora"].items) {
+            const auto name = old_corpus.members.count("name") ? old_corpus.members.at("name").text : "";
+            const auto it = std::find_if(corpora.begin(), corpora.end(), [&](const Corpus &corpus) {
+                return corpus.name == name;
+            });
+            if (it == corpora.end() || !old_corpus.members.count("phases")) {
+                continue;
+            }
+
+            const auto &old_phases = old_corpus.members.at("phases").members;
+            for (size_t i = 0; i < NUM_OF_PHASES; ++i) {
+                const auto phase = old_phases.find(PHASE_NAMES[i]);
+                if (phase == old_phases.end() || !phase->second.members.count("ms") ||
+                    !phase->second.members.count("allocs")) {
+                    continue;
+                }
+
+                const auto old_ms = phase->second.members.at("ms").number;
+                const auto old_allocs = static_cast<size_t>(phase->second.members.at("allocs").number);
+                const auto &stats = it->phases[i];
+                const auto slower = stats.ms > old_ms * (1 + tolerance);
+                const auto more_allocs = stats.allocs > old_allocs;
+                fprintf(stderr, "%s/%s: %.3f -> %.3f ms (%+.1f%%), %zu -> %zu allocs%s\n", name.c_str(),
+                        PHASE_NAMES[i], old_ms, stats.ms, old_ms > 0 ? (stats.ms / old_ms - 1) * 100 : 0.0,
+                        old_allocs, stats.allocs, slower || more_allocs ? "  REGRESSION" : "");
+                num_of_regressions += slower || more_allocs;
+            }
+        }
+
+        fprintf(stderr, "%zu regression(s) against %s\n", num_of_regressions, baseline_path);
+        return num_of_regressions == 0 ? 0 : 1;
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    LexerOptions options;
+    int32_t num_of_runs = 5;
+    size_t scale_mb = 8;
+    bool synthetic = true;
+    bool per_file = false;
+    double tolerance = 0.1;
+    const char *json_path = nullptr;
+    const char *baseline_path = nullptr;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--runs=", 7) == 0) {
+            num_of_runs = std::max(1, atoi(argv[i] + 7));
+        } else if (strncmp(argv[i], "--scale=", 8) == 0) {
+            scale_mb = std::max(0, atoi(argv[i] + 8));
+        } else if (strcmp(argv[i], "--no-synthetic") == 0) {
+            synthetic = false;
+        } else if (strcmp(argv[i], "--per-file") == 0) {
+            per_file = true;
+        } else if (strcmp(argv[i], "--lazy-bodies") == 0) {
+            options.lazy_bodies = true;
+        } else if (strncmp(argv[i], "--json=", 7) == 0) {
+            json_path = argv[i] + 7;
+        } else if (strncmp(argv[i], "--baseline=", 11) == 0) {
+            baseline_path = argv[i] + 11;
+        } else if (strncmp(argv[i], "--tolerance=", 12) == 0) {
+            tolerance = atof(argv[i] + 12) / 100;
+        } else if (argv[i][0] == '-') {
+            puts("usage: ./prss_bench [--runs=N] [--scale=MB] [--no-synthetic] [--per-file] [--lazy-bodies] "
+                 "[--json=<output>] [--baseline=<json> [--tolerance=PERCENT]] [<file or directory of a corpus>...]");
+            return 2;
+        } else {
+            paths.emplace_back(argv[i]);
+        }
+    }
+    const auto default_corpus = paths.empty();
+    if (default_corpus) {
+        paths.emplace_back(PRSS_SOURCES_DIR);
+    }
+
+    std::vector<Corpus> corpora;
+    for (const auto &path: paths) {
+        Corpus corpus;
+        if (!collectCorpus(path, corpus)) {
+            fprintf(stderr, "%s: no Python files there\n", path.c_str());
+            return 2;
+        }
+        corpora.push_back(std::move(corpus));
+    }
+    if (default_corpus) {
+        // the same name wherever the repository is checked out, for the sake of the baselines
+        corpora.front().name = "sources";
+    }
+
+    std::string synthetic_dir;
+    if (synthetic) {
+        char dir_template[] = "/tmp/prss_bench.XXXXXX";
+        if (!mkdtemp(dir_template)) {
+            perror("mkdtemp");
+            return 2;
+        }
+        synthetic_dir = dir_template;
+        for (auto &corpus: writeSyntheticCorpora(synthetic_dir, corpora.front().paths, scale_mb)) {
+            corpora.push_back(std::move(corpus));
+        }
+    }
+
+    if (per_file) {
+        // the synthetic corpora are a file each already
+        std::vector<Corpus> files;
+        for (size_t i = 0; i < corpora.size(); ++i) {
+            if (i >= paths.size()) {
+                files.push_back(std::move(corpora[i]));
+                continue;
+            }
+            for (const auto &path: corpora[i].paths) {
+                Corpus file;
+                file.name = path;
+                file.paths = {path};
+                file.group = corpora[i].name;
+                files.push_back(std::move(file));
+            }
+        }
+        corpora = std::move(files);
+    }
+
+    for (auto &corpus: corpora) {
+        benchCorpus(corpus, options, num_of_runs);
+    }
+
+    const auto scalings = fitScalings(corpora);
+    for (const auto &scaling: scalings) {
+        for (size_t i = 0; i < NUM_OF_PHASES; ++i) {
+            if (scaling.phases[i] > SUPERLINEAR_EXPONENT) {
+                fprintf(stderr, "%s/%s: grows as size^%.2f, superlinear\n", scaling.group.c_str(), PHASE_NAMES[i],
+                        scaling.phases[i]);
+            }
+        }
+        if (scaling.peak_heap > SUPERLINEAR_EXPONENT) {
+            fprintf(stderr, "%s/peak_heap: grows as size^%.2f, superlinear\n", scaling.group.c_str(),
+                    scaling.peak_heap);
+        }
+    }
+
+    if (!synthetic_dir.empty()) {
+        std::filesystem::remove_all(synthetic_dir);
+    }
+
+    auto out = json_path ? fopen(json_path, "w") : stdout;
+    if (!out) {
+        perror(json_path);
+        return 2;
+    }
+    writeJson(out, corpora, scalings, num_of_runs);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    return baseline_path ? compareToBaseline(baseline_path, corpora, tolerance) : 0;
+}
@@ -0,0 +1,259 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the SHA-1 of grammar/Python3.g4, passed by CMake
+#ifndef GRAMMAR_VERSION
+#define GRAMMAR_VERSION "unknown"
+#endif
+
+// the SHA-1 of lexer.hpp, lexer.cpp and the sources of the lexer ANTLR generated, passed by CMake
+#ifndef LEXER_VERSION
+#define LEXER_VERSION "unknown"
+#endif
+
+namespace {
+    constexpr char MAGIC[8] = {'P', 'R', 'S', 'S', 'T', 'O', 'K', '\0'};
+
+    // The file starts with the header, followed by the columns: types (padded to a multiple of 4 bytes),
+    // starts, lengths, lines and symbols of the tokens, then the starts and the lengths of the names of
+    // symbols 1 and on in the source. The symbols are the ones of the source alone, numbered in the order they
+    // first appear in.
+    struct CacheHeader {
+        char magic[8];
+        uint32_t format;
+        uint32_t num_of_tokens;
+        uint64_t source_hash;
+        uint64_t source_size;
+        char grammar[40];
+        char lexer[40];
+        uint32_t num_of_symbols;
+        uint32_t lexer_kind;
+    };
+
+    inline size_t typesSize(size_t num_of_tokens) {
+        return (num_of_tokens * sizeof(int16_t) + 3) & ~static_cast<size_t>(3);
+    }
+
+    inline size_t fileSize(size_t num_of_tokens, size_t num_of_symbols) {
+        return sizeof(CacheHeader) + typesSize(num_of_tokens) + 4 * num_of_tokens * sizeof(uint32_t) +
+               2 * num_of_symbols * sizeof(uint32_t);
+    }
+
+    inline uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    // Whether the columns of a file fit the source: the tokens and the names lie within it, the types are the ones
+    // of the grammar and the symbols are the ones of the file, so that nothing read through the table goes astray
+    bool isValid(const int16_t *types, const uint32_t *starts, const uint32_t *lengths, const Symbol *symbols,
+                 size_t num_of_tokens, const uint32_t *symbol_starts, const uint32_t *symbol_lengths,
+                 size_t num_of_symbols, size_t size) {
+        for (size_t i = 0; i < num_of_tokens; ++i) {
+            const auto type = static_cast<size_t>(static_cast<ptrdiff_t>(types[i]));
+            if (static_cast<uint64_t>(starts[i]) + lengths[i] > size || symbols[i] > num_of_symbols ||
+                (type != Python3Parser::EOF && (type < 1 || type > Python3Parser::DEDENT))) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < num_of_symbols; ++i) {
+            if (static_cast<uint64_t>(symbol_starts[i]) + symbol_lengths[i] > size) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::string cachePath(const std::string &dir, uint64_t hash) {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.tok", static_cast<unsigned long long>(hash));
+        return dir + name;
+    }
+
+    void fillHeader(CacheHeader &header, LexerKind kind, uint64_t hash, size_t size, size_t num_of_tokens,
+                    size_t num_of_symbols) {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.format = TOKEN_CACHE_FORMAT;
+        header.num_of_tokens = num_of_tokens;
+        header.source_hash = hash;
+        header.source_size = size;
+        memcpy(header.grammar, GRAMMAR_VERSION, std::min(sizeof(header.grammar), strlen(GRAMMAR_VERSION)));
+        memcpy(header.lexer, LEXER_VERSION, std::min(sizeof(header.lexer), strlen(LEXER_VERSION)));
+        header.num_of_symbols = num_of_symbols;
+        header.lexer_kind = static_cast<uint32_t>(kind);
+    }
+}
+
+uint64_t hashBytes(const char *data, size_t size) {
+    constexpr uint64_t k1 = 0x9e3779b97f4a7c15ULL;
+    constexpr uint64_t k2 = 0xc2b2ae3d27d4eb4fULL;
+
+    uint64_t hash = size * k1;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash ^= word * k1;
+        hash = ((hash << 27) | (hash >> 37)) * k2;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    hash ^= tail * k1;
+
+    return mix(hash);
+}
+
+TokenCache::~TokenCache() {
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+    }
+}
+
+bool TokenCache::load(const char *data, size_t size, TokenTable &table, SymbolTable &symbols) {
+    hash_ = hashBytes(data, size);
+
+    const auto fd = open(cachePath(dir_, hash_).c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    const auto addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    CacheHeader expected;
+    const auto header = static_cast<const CacheHeader *>(addr);
+    fillHeader(expected, kind_, hash_, size, header->num_of_tokens, header->num_of_symbols);
+    if (memcmp(header, &expected, sizeof(CacheHeader)) != 0 ||
+        static_cast<size_t>(st.st_size) != fileSize(header->num_of_tokens, header->num_of_symbols)) {
+        munmap(addr, st.st_size);
+        return false;
+    }
+
+    const auto num_of_tokens = header->num_of_tokens;
+    const auto num_of_symbols = header->num_of_symbols;
+    const auto types = reinterpret_cast<const int16_t *>(header + 1);
+    const auto starts = reinterpret_cast<const uint32_t *>(reinterpret_cast<const char *>(types) +
+                                                           typesSize(num_of_tokens));
+    const auto lengths = starts + num_of_tokens;
+    const auto lines = lengths + num_of_tokens;
+    const auto token_symbols = lines + num_of_tokens;
+    const auto symbol_starts = token_symbols + num_of_tokens;
+    const auto symbol_lengths = symbol_starts + num_of_symbols;
+
+    if (!isValid(types, starts, lengths, token_symbols, num_of_tokens, symbol_starts, symbol_lengths,
+                 num_of_symbols, size)) {
+        munmap(addr, st.st_size);
+        return false;
+    }
+
+    // a table of the source alone interns the names into the very same symbols, a shared one that already has
+    // some of them doesn't, and the symbols of the tokens are translated then
+    std::vector<Symbol> translated(num_of_symbols + 1, NO_SYMBOL);
+    bool is_translated = false;
+    for (uint32_t i = 0; i < num_of_symbols; ++i) {
+        translated[i + 1] = symbols.intern({data + symbol_starts[i], symbol_lengths[i]});
+        is_translated |= translated[i + 1] != i + 1;
+    }
+    if (is_translated) {
+        table.symbols.resize(num_of_tokens);
+        for (uint32_t i = 0; i < num_of_tokens; ++i) {
+            table.symbols[i] = translated[token_symbols[i]];
+        }
+    }
+    table.map(types, starts, lengths, lines, is_translated ? table.symbols.data() : token_symbols, num_of_tokens);
+
+    mapping_ = addr;
+    mapping_size_ = st.st_size;
+    return true;
+}
+
+void TokenCache::store(size_t size, const TokenTable &table) {
+    const auto num_of_tokens = table.size();
+    if (num_of_tokens > UINT32_MAX) {
+        return;
+    }
+
+    // the symbols of the source alone, the name of each one is the text of the token it first appears at
+    std::unordered_map<Symbol, Symbol> local_of;
+    std::vector<Symbol> local_symbols(num_of_tokens, NO_SYMBOL);
+    std::vector<uint32_t> symbol_starts;
+    std::vector<uint32_t> symbol_lengths;
+    for (size_t i = 0; i < num_of_tokens; ++i) {
+        const auto symbol = table.symbol_column[i];
+        if (symbol == NO_SYMBOL) {
+            continue;
+        }
+        const auto [it, inserted] = local_of.try_emplace(symbol, static_cast<Symbol>(local_of.size() + 1));
+        if (inserted) {
+            symbol_starts.push_back(table.start_column[i]);
+            symbol_lengths.push_back(table.length_column[i]);
+        }
+        local_symbols[i] = it->second;
+    }
+    const auto num_of_symbols = symbol_starts.size();
+
+    CacheHeader header;
+    fillHeader(header, kind_, hash_, size, num_of_tokens, num_of_symbols);
+
+    mkdir(dir_.c_str(), 0755);
+    // written aside and renamed, so that a concurrent load never sees a half-written file. The name of the temporary
+    // one is unique per thread, two threads of a single process may happen to store the same source.
+    const auto path = cachePath(dir_, hash_);
+    const auto tmp_path = path + "." + std::to_string(getpid()) + "." +
+                          std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream stream(tmp_path, std::ios::binary);
+        if (!stream) {
+            return;
+        }
+
+        constexpr char padding[4] = {};
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char *>(table.type_column), num_of_tokens * sizeof(int16_t));
+        stream.write(padding, typesSize(num_of_tokens) - num_of_tokens * sizeof(int16_t));
+        stream.write(reinterpret_cast<const char *>(table.start_column), num_of_tokens * sizeof(uint32_t));
+        stream.write(reinterpret_cast<const char *>(table.length_column), num_of_tokens * sizeof(uint32_t));
+        stream.write(reinterpret_cast<const char *>(table.line_column), num_of_tokens * sizeof(uint32_t));
+        stream.write(reinterpret_cast<const char *>(local_symbols.data()), num_of_tokens * sizeof(Symbol));
+        stream.write(reinterpret_cast<const char *>(symbol_starts.data()), num_of_symbols * sizeof(uint32_t));
+        stream.write(reinterpret_cast<const char *>(symbol_lengths.data()), num_of_symbols * sizeof(uint32_t));
+        if (!stream) {
+            stream.close();
+            unlink(tmp_path.c_str());
+            return;
+        }
+    }
+
+    if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "lexer.hpp"
+#include "symbols.hpp"
+
+// Bump whenever the layout of the files changes (a change of the lexer is caught by the version CMake bakes in)
+constexpr uint32_t TOKEN_CACHE_FORMAT = 3;
+
+// A fast non-cryptographic 64-bit hash of the bytes, reading them 8 at a time
+uint64_t hashBytes(const char *data, size_t size);
+
+// Token tables of sources kept in a directory, one file per distinct source named after the hash of its
+// contents. A file holds the columns of the table as they are in memory, so a hit maps it and points the
+// table right at them, with no lexing and no copying. The symbols of NAME tokens stay valid as well, since
+// the names are interned into the fresh SymbolTable of the lexer in the order the lexer interned them (a shared
+// table gives them other symbols, the column of the symbols is copied and translated then).
+// A file made by another TOKEN_CACHE_FORMAT, for another grammar/Python3.g4, by another kind of lexer or by another
+// version of its sources (lexer.hpp/lexer.cpp, or the lexer ANTLR generated) is a miss, and so is one whose tokens
+// don't fit the source (a corrupt one, its header notwithstanding). The lexers don't agree on every source (a
+// non-ASCII character that isn't a letter, for one), hence the one a file was made by is a part of the key.
+class TokenCache {
+public:
+    // the tokens are the ones the lexer of the kind makes
+    TokenCache(const char *dir, LexerKind kind) : dir_(dir), kind_(kind) {}
+
+    TokenCache(const TokenCache &) = delete;
+
+    TokenCache &operator=(const TokenCache &) = delete;
+
+    ~TokenCache();
+
+    // Maps the cached tokens of the source into the table, returns false if there are none
+    bool load(const char *data, size_t size, TokenTable &table, SymbolTable &symbols);
+
+    // Writes the tokens of the source passed to the last load(), size being the size of the source
+    void store(size_t size, const TokenTable &table);
+
+private:
+    std::string dir_;
+    LexerKind kind_;
+    uint64_t hash_ = 0;
+    void *mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+};
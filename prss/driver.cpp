@@ -0,0 +1,97 @@
+#include "driver.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace {
+    // The indices of the files a worker has yet to parse
+    class WorkQueue {
+    public:
+        inline void push(size_t idx) { files_.push_back(idx); }
+
+        // taken by the owner
+        opt<size_t> pop() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (files_.empty()) {
+                return std::nullopt;
+            }
+
+            const auto idx = files_.front();
+            files_.pop_front();
+            return idx;
+        }
+
+        // taken by the other workers, from the opposite end than the owner to keep out of its way
+        opt<size_t> steal() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (files_.empty()) {
+                return std::nullopt;
+            }
+
+            const auto idx = files_.back();
+            files_.pop_back();
+            return idx;
+        }
+
+    private:
+        std::mutex mutex_;
+        std::deque<size_t> files_;
+    };
+
+    std::vector<ParseError> parseFile(const std::string &path, const LexerOptions &options, size_t idx,
+                                      const ParsedCallback &on_parsed) {
+        opt<PyLexer> lexer;
+        try {
+            lexer.emplace(path.c_str(), options);
+        } catch (const std::exception &e) {
+            // the source couldn't be loaded
+            return {ParseError{e.what(), 0}};
+        }
+
+        auto result = parse(*lexer);
+        if (on_parsed) {
+            on_parsed(idx, *lexer, result);
+        }
+        return std::move(result.errors);
+    }
+}
+
+std::vector<std::vector<ParseError>> parseFiles(const std::vector<std::string> &paths, const LexerOptions &options,
+                                                uint32_t num_of_threads, const ParsedCallback &on_parsed) {
+    std::vector<std::vector<ParseError>> errors(paths.size());
+    const auto num_of_workers = std::max<size_t>(1, std::min<size_t>(num_of_threads, paths.size()));
+
+    std::vector<WorkQueue> queues(num_of_workers);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        queues[i * num_of_workers / paths.size()].push(i);
+    }
+
+    // every file is in exactly one queue and no more work ever shows up, so once the own queue and all
+    // of the others are empty, there's nothing left to do
+    const auto work = [&](size_t worker) {
+        while (true) {
+            auto idx = queues[worker].pop();
+            for (size_t i = 1; !idx && i < num_of_workers; ++i) {
+                idx = queues[(worker + i) % num_of_workers].steal();
+            }
+            if (!idx) {
+                return;
+            }
+
+            errors[*idx] = parseFile(paths[*idx], options, *idx, on_parsed);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_of_workers; ++i) {
+        threads.emplace_back(work, i);
+    }
+    work(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    return errors;
+}
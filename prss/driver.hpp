@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "parser.hpp"
+
+// Called by the worker that parsed the idx-th file, while the lexer the tree points into is still alive.
+// The tree is destroyed as soon as it returns. It must not throw, nothing catches it on the worker.
+using ParsedCallback = std::function<void(size_t idx, PyLexer &lexer, const ParseResult &result)>;
+
+// Parses the files on up to num_of_threads workers and returns the errors of each of them (a file
+// that can't be read has a single error at line 0). Every worker starts off with a contiguous share of the files,
+// taking them from the front, and once it's done with those, steals from the back of the shares of the others,
+// so that a few big files don't keep a single worker busy while the rest of them sit idle.
+std::vector<std::vector<ParseError>> parseFiles(const std::vector<std::string> &paths, const LexerOptions &options,
+                                                uint32_t num_of_threads, const ParsedCallback &on_parsed = {});
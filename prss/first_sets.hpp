@@ -0,0 +1,253 @@
+#pragma once
+
+// Generated by grammar/first_sets.py from grammar/Python3.g4, do not edit.
+
+#include "token_set.hpp"
+
+// FIRST(stmt)
+constexpr TokenSet FIRST_STMT = TokenSet::of({
+        Python3Parser::ADD,
+        Python3Parser::ASSERT,
+        Python3Parser::ASYNC,
+        Python3Parser::AT,
+        Python3Parser::AWAIT,
+        Python3Parser::BREAK,
+        Python3Parser::CLASS,
+        Python3Parser::CONTINUE,
+        Python3Parser::DEF,
+        Python3Parser::DEL,
+        Python3Parser::ELLIPSIS,
+        Python3Parser::FALSE,
+        Python3Parser::FOR,
+        Python3Parser::FROM,
+        Python3Parser::GLOBAL,
+        Python3Parser::IF,
+        Python3Parser::IMPORT,
+        Python3Parser::LAMBDA,
+        Python3Parser::MINUS,
+        Python3Parser::NAME,
+        Python3Parser::NONE,
+        Python3Parser::NONLOCAL,
+        Python3Parser::NOT,
+        Python3Parser::NOT_OP,
+        Python3Parser::NUMBER,
+        Python3Parser::OPEN_BRACE,
+        Python3Parser::OPEN_BRACK,
+        Python3Parser::OPEN_PAREN,
+        Python3Parser::PASS,
+        Python3Parser::RAISE,
+        Python3Parser::RETURN,
+        Python3Parser::STAR,
+        Python3Parser::STRING,
+        Python3Parser::TRUE,
+        Python3Parser::TRY,
+        Python3Parser::WHILE,
+        Python3Parser::WITH,
+        Python3Parser::YIELD
+});
+
+// FIRST(simple_stmt)
+constexpr TokenSet FIRST_SIMPLE_STMT = TokenSet::of({
+        Python3Parser::ADD,
+        Python3Parser::ASSERT,
+        Python3Parser::AWAIT,
+        Python3Parser::BREAK,
+        Python3Parser::CONTINUE,
+        Python3Parser::DEL,
+        Python3Parser::ELLIPSIS,
+        Python3Parser::FALSE,
+        Python3Parser::FROM,
+        Python3Parser::GLOBAL,
+        Python3Parser::IMPORT,
+        Python3Parser::LAMBDA,
+        Python3Parser::MINUS,
+        Python3Parser::NAME,
+        Python3Parser::NONE,
+        Python3Parser::NONLOCAL,
+        Python3Parser::NOT,
+        Python3Parser::NOT_OP,
+        Python3Parser::NUMBER,
+        Python3Parser::OPEN_BRACE,
+        Python3Parser::OPEN_BRACK,
+        Python3Parser::OPEN_PAREN,
+        Python3Parser::PASS,
+        Python3Parser::RAISE,
+        Python3Parser::RETURN,
+        Python3Parser::STAR,
+        Python3Parser::STRING,
+        Python3Parser::TRUE,
+        Python3Parser::YIELD
+});
+
+// FIRST(compound_stmt)
+constexpr TokenSet FIRST_COMPOUND_STMT = TokenSet::of({
+        Python3Parser::ASYNC,
+        Python3Parser::AT,
+        Python3Parser::CLASS,
+        Python3Parser::DEF,
+        Python3Parser::FOR,
+        Python3Parser::IF,
+        Python3Parser::TRY,
+        Python3Parser::WHILE,
+        Python3Parser::WITH
+});
+
+// FIRST(testlist_star_expr)
+constexpr TokenSet FIRST_TESTLIST_STAR_EXPR = TokenSet::of({
+        Python3Parser::ADD,
+        Python3Parser::AWAIT,
+        Python3Parser::ELLIPSIS,
+        Python3Parser::FALSE,
+        Python3Parser::LAMBDA,
+        Python3Parser::MINUS,
+        Python3Parser::NAME,
+        Python3Parser::NONE,
+        Python3Parser::NOT,
+        Python3Parser::NOT_OP,
+        Python3Parser::NUMBER,
+        Python3Parser::OPEN_BRACE,
+        Python3Parser::OPEN_BRACK,
+        Python3Parser::OPEN_PAREN,
+        Python3Parser::STAR,
+        Python3Parser::STRING,
+        Python3Parser::TRUE
+});
+
+// FIRST(test)
+constexpr TokenSet FIRST_TEST = TokenSet::of({
+        Python3Parser::ADD,
+        Python3Parser::AWAIT,
+        Python3Parser::ELLIPSIS,
+        Python3Parser::FALSE,
+        Python3Parser::LAMBDA,
+        Python3Parser::MINUS,
+        Python3Parser::NAME,
+        Python3Parser::NONE,
+        Python3Parser::NOT,
+        Python3Parser::NOT_OP,
+        Python3Parser::NUMBER,
+        Python3Parser::OPEN_BRACE,
+        Python3Parser::OPEN_BRACK,
+        Python3Parser::OPEN_PAREN,
+        Python3Parser::STRING,
+        Python3Parser::TRUE
+});
+
+// FIRST(or_test)
+constexpr TokenSet FIRST_OR_TEST = TokenSet::of({
+        Python3Parser::ADD,
+        Python3Parser::AWAIT,
+        Python3Parser::ELLIPSIS,
+        Python3Parser::FALSE,
+        Python3Parser::MINUS,
+        Python3Parser::NAME,
+        Python3Parser::NONE,
+        Python3Parser::NOT,
+        Python3Parser::NOT_OP,
+        Python3Parser::NUMBER,
+        Python3Parser::OPEN_BRACE,
+        Python3Parser::OPEN_BRACK,
+        Python3Parser::OPEN_PAREN,
+        Python3Parser::STRING,
+        Python3Parser::TRUE
+});
+
+// FIRST(comparison)
+constexpr TokenSet FIRST_COMPARISON = TokenSet::of({
+        Python3Parser::ADD,
+        Python3Parser::AWAIT,
+        Python3Parser::ELLIPSIS,
+        Python3Parser::FALSE,
+        Python3Parser::MINUS,
+        Python3Parser::NAME,
+        Python3Parser::NONE,
+        Python3Parser::NOT_OP,
+        Python3Parser::NUMBER,
+        Python3Parser::OPEN_BRACE,
+        Python3Parser::OPEN_BRACK,
+        Python3Parser::OPEN_PAREN,
+        Python3Parser::STRING,
+        Python3Parser::TRUE
+});
+
+// FIRST(testlist_comp)
+constexpr TokenSet FIRST_TESTLIST_COMP = TokenSet::of({
+        Python3Parser::ADD,
+        Python3Parser::AWAIT,
+        Python3Parser::ELLIPSIS,
+        Python3Parser::FALSE,
+        Python3Parser::LAMBDA,
+        Python3Parser::MINUS,
+        Python3Parser::NAME,
+        Python3Parser::NONE,
+        Python3Parser::NOT,
+        Python3Parser::NOT_OP,
+        Python3Parser::NUMBER,
+        Python3Parser::OPEN_BRACE,
+        Python3Parser::OPEN_BRACK,
+        Python3Parser::OPEN_PAREN,
+        Python3Parser::STAR,
+        Python3Parser::STRING,
+        Python3Parser::TRUE
+});
+
+// FIRST(dictorsetmaker)
+constexpr TokenSet FIRST_DICTORSETMAKER = TokenSet::of({
+        Python3Parser::ADD,
+        Python3Parser::AWAIT,
+        Python3Parser::ELLIPSIS,
+        Python3Parser::FALSE,
+        Python3Parser::LAMBDA,
+        Python3Parser::MINUS,
+        Python3Parser::NAME,
+        Python3Parser::NONE,
+        Python3Parser::NOT,
+        Python3Parser::NOT_OP,
+        Python3Parser::NUMBER,
+        Python3Parser::OPEN_BRACE,
+        Python3Parser::OPEN_BRACK,
+        Python3Parser::OPEN_PAREN,
+        Python3Parser::POWER,
+        Python3Parser::STAR,
+        Python3Parser::STRING,
+        Python3Parser::TRUE
+});
+
+// FIRST(arglist)
+constexpr TokenSet FIRST_ARGLIST = TokenSet::of({
+        Python3Parser::ADD,
+        Python3Parser::AWAIT,
+        Python3Parser::ELLIPSIS,
+        Python3Parser::FALSE,
+        Python3Parser::LAMBDA,
+        Python3Parser::MINUS,
+        Python3Parser::NAME,
+        Python3Parser::NONE,
+        Python3Parser::NOT,
+        Python3Parser::NOT_OP,
+        Python3Parser::NUMBER,
+        Python3Parser::OPEN_BRACE,
+        Python3Parser::OPEN_BRACK,
+        Python3Parser::OPEN_PAREN,
+        Python3Parser::POWER,
+        Python3Parser::STAR,
+        Python3Parser::STRING,
+        Python3Parser::TRUE
+});
+
+// FIRST(augassign)
+constexpr TokenSet FIRST_AUGASSIGN = TokenSet::of({
+        Python3Parser::ADD_ASSIGN,
+        Python3Parser::AND_ASSIGN,
+        Python3Parser::AT_ASSIGN,
+        Python3Parser::DIV_ASSIGN,
+        Python3Parser::IDIV_ASSIGN,
+        Python3Parser::LEFT_SHIFT_ASSIGN,
+        Python3Parser::MOD_ASSIGN,
+        Python3Parser::MULT_ASSIGN,
+        Python3Parser::OR_ASSIGN,
+        Python3Parser::POWER_ASSIGN,
+        Python3Parser::RIGHT_SHIFT_ASSIGN,
+        Python3Parser::SUB_ASSIGN,
+        Python3Parser::XOR_ASSIGN
+});
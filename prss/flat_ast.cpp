@@ -0,0 +1,440 @@
+#include "flat_ast.hpp"
+
+namespace {
+    bool hasPosition(const Position &pos) {
+        return pos.line_start != 0 || pos.line_end != 0 || pos.col_start_idx != 0 || pos.col_end_idx != 0;
+    }
+
+    // The children of a node being built back, resolved into the nodes already built for them
+    class ChildNodes {
+    public:
+        ChildNodes(const std::vector<Node *> &nodes, FlatAst::Children ids) : nodes_(nodes), ids_(ids) {}
+
+        inline size_t size() const noexcept { return ids_.size(); }
+
+        template<typename T = Node>
+        inline T *at(size_t idx) const noexcept {
+            return ids_[idx] == NO_NODE ? nullptr : static_cast<T *>(nodes_[ids_[idx]]);
+        }
+
+        // the children [first, last)
+        template<typename T = Node>
+        ArenaVector<T *> list(size_t first, size_t last) const {
+            ArenaVector<T *> list;
+            list.reserve(last - first);
+            for (auto i = first; i < last; ++i) {
+                list.push_back(at<T>(i));
+            }
+            return list;
+        }
+
+    private:
+        const std::vector<Node *> &nodes_;
+        FlatAst::Children ids_;
+    };
+}
+
+FlatAst::FlatAst(Node *root) {
+    // the nodes still to be laid out, along with the slot of children_ their ids go to
+    struct Item {
+        Node *node;
+        size_t slot;
+    };
+    std::vector<Item> stack;
+    // the children of the node at hand, the same vector for all of them
+    std::vector<Node *> children;
+    if (root) {
+        stack.push_back({root, SIZE_MAX});
+    }
+    while (!stack.empty()) {
+        const auto item = stack.back();
+        stack.pop_back();
+
+        const auto id = static_cast<NodeId>(kinds_.size());
+        if (item.slot != SIZE_MAX) {
+            children_[item.slot] = id;
+        }
+        kinds_.push_back(item.node->kind);
+        payloads_.push_back(addPayload(item.node));
+        if (hasPosition(item.node->pos_info)) {
+            positions_.emplace_back(id, item.node->pos_info);
+        }
+
+        children.clear();
+        item.node->forEachChild([&](Node *child) {
+            children.push_back(child);
+        });
+        const auto begin = children_.size();
+        children_begin_.push_back(static_cast<uint32_t>(begin));
+        children_.resize(begin + children.size(), NO_NODE);
+        // the first child ends up on the top, so that the ids go in preorder
+        for (size_t i = children.size(); i-- > 0;) {
+            if (children[i]) {
+                stack.push_back({children[i], begin + i});
+            }
+        }
+    }
+    children_begin_.push_back(static_cast<uint32_t>(children_.size()));
+
+    kinds_.shrink_to_fit();
+    children_begin_.shrink_to_fit();
+    children_.shrink_to_fit();
+    payloads_.shrink_to_fit();
+    names_.shrink_to_fit();
+    consts_.shrink_to_fit();
+    limbs_.shrink_to_fit();
+    defs_.shrink_to_fit();
+    parameters_.shrink_to_fit();
+    positions_.shrink_to_fit();
+}
+
+uint32_t FlatAst::addPayload(Node *node) {
+    const auto add = [](auto &table, auto &&entry) {
+        table.push_back(std::forward<decltype(entry)>(entry));
+        return static_cast<uint32_t>(table.size() - 1);
+    };
+
+    switch (node->kind) {
+        case NodeKind::BinOp:
+            return static_cast<BinOp *>(node)->op;
+        case NodeKind::BoolOp:
+            return static_cast<BoolOp *>(node)->op;
+        case NodeKind::UnaryOp:
+            return static_cast<UnaryOp *>(node)->op;
+        case NodeKind::Comparison:
+            return static_cast<Comparison *>(node)->op;
+        case NodeKind::AugAssign:
+            return static_cast<AugAssign *>(node)->op;
+        case NodeKind::ImportFrom:
+            return static_cast<ImportFrom *>(node)->level;
+        case NodeKind::Comprehension:
+            return static_cast<Comprehension *>(node)->is_async;
+        case NodeKind::Dict:
+            return static_cast<Dict *>(node)->keys.size();
+        case NodeKind::Arguments:
+            return static_cast<Arguments *>(node)->args.size();
+        case NodeKind::Name: {
+            const auto name = static_cast<Name *>(node);
+            return add(names_, FlatName{name->name, name->symbol});
+        }
+        case NodeKind::Keyword: {
+            const auto keyword = static_cast<Keyword *>(node);
+            return add(names_, FlatName{keyword->arg, keyword->arg_symbol});
+        }
+        case NodeKind::ExceptHandler: {
+            const auto handler = static_cast<ExceptHandler *>(node);
+            return add(names_, FlatName{handler->name, handler->name_symbol});
+        }
+        case NodeKind::ClassDef: {
+            const auto class_def = static_cast<ClassDef *>(node);
+            return add(names_, FlatName{class_def->name, class_def->name_symbol});
+        }
+        case NodeKind::Module:
+            return add(names_, FlatName{static_cast<Module *>(node)->doc, NO_SYMBOL});
+        case NodeKind::AssName: {
+            const auto ass_name = static_cast<AssName *>(node);
+            return add(names_, FlatName{ass_name->name, static_cast<Symbol>(ass_name->flags)});
+        }
+        case NodeKind::Const: {
+            const auto constant = static_cast<Const *>(node);
+            const auto &number = constant->number;
+            const auto limbs_begin = static_cast<uint32_t>(limbs_.size());
+            limbs_.insert(limbs_.end(), number.limbs.begin(), number.limbs.end());
+            return add(consts_, FlatConst{constant->value, constant->type, constant->literal, number.kind,
+                                          limbs_begin, static_cast<uint32_t>(number.limbs.size()),
+                                          number.int_value, number.float_value});
+        }
+        case NodeKind::FuncDef: {
+            const auto func_def = static_cast<FuncDef *>(node);
+            return add(defs_, FlatDef{func_def->name, func_def->name_symbol, func_def->body_begin,
+                                      func_def->body_end});
+        }
+        case NodeKind::AsyncFuncDef: {
+            const auto func_def = static_cast<AsyncFuncDef *>(node);
+            return add(defs_, FlatDef{func_def->name, func_def->name_symbol, func_def->body_begin,
+                                      func_def->body_end});
+        }
+        case NodeKind::Parameters: {
+            const auto parameters = static_cast<Parameters *>(node);
+            const auto &extra = parameters->extra;
+            return add(parameters_, FlatParameters{static_cast<uint32_t>(parameters->params.size()),
+                                                   static_cast<uint32_t>(extra.pos_only_args.size()),
+                                                   static_cast<uint32_t>(extra.kw_only_args.size()),
+                                                   static_cast<uint32_t>(extra.kw_defaults.size())});
+        }
+        default:
+            return NO_PAYLOAD;
+    }
+}
+
+Node *FlatAst::toTree() const {
+    // the children of a node come after it, so building the nodes from the last one on, the ones of its children
+    // are there already
+    std::vector<Node *> nodes(kinds_.size());
+    for (auto id = static_cast<NodeId>(kinds_.size()); id-- > 0;) {
+        const ChildNodes c(nodes, children(id));
+        const auto n = c.size();
+        const auto payload = payloads_[id];
+        Node *node = nullptr;
+        switch (kinds_[id]) {
+            case NodeKind::FileInput:
+                node = new FileInput(c.list(0, n));
+                break;
+            case NodeKind::Module:
+                node = new Module(name(id).text, c.at(0));
+                break;
+            case NodeKind::Comprehension:
+                node = new Comprehension(c.at(n - 2), c.at(n - 1), c.list(0, n - 2), payload != 0);
+                break;
+            case NodeKind::GeneratorExp:
+                node = new GeneratorExp(c.at(n - 1), c.list(0, n - 1));
+                break;
+            case NodeKind::Dict:
+                node = new Dict(c.list(0, payload), c.list(payload, n));
+                break;
+            case NodeKind::DictComp:
+                node = new DictComp(c.at(n - 2), c.at(n - 1), c.list(0, n - 2));
+                break;
+            case NodeKind::Set:
+                node = new Set(c.list(0, n));
+                break;
+            case NodeKind::List:
+                node = new List(c.list(0, n));
+                break;
+            case NodeKind::ListComp:
+                node = new ListComp(c.at(n - 1), c.list(0, n - 1));
+                break;
+            case NodeKind::SetComp:
+                node = new SetComp(c.at(n - 1), c.list(0, n - 1));
+                break;
+            case NodeKind::Stmt:
+                node = new Stmt(c.list(0, n));
+                break;
+            case NodeKind::SimpleStmt:
+                node = new SimpleStmt(c.list(0, n));
+                break;
+            case NodeKind::ForStmt:
+                node = new ForStmt(c.at(0), c.at(1), c.at(2), c.at(3));
+                break;
+            case NodeKind::AsyncForStmt:
+                node = new AsyncForStmt(c.at(0), c.at(1), c.at(2), c.at(3));
+                break;
+            case NodeKind::WithStmt:
+                node = new WithStmt(c.list(0, n - 2), c.at(n - 2), c.at(n - 1));
+                break;
+            case NodeKind::AsyncWithStmt:
+                node = new AsyncWithStmt(c.list(0, n - 2), c.at(n - 2), c.at(n - 1));
+                break;
+            case NodeKind::WithItem:
+                node = new WithItem(c.at(0), c.at(1));
+                break;
+            case NodeKind::TryStmt:
+                node = new TryStmt(c.at(n - 3), c.list(0, n - 3), c.at(n - 2), c.at(n - 1));
+                break;
+            case NodeKind::ExceptHandler: {
+                const auto handler = new ExceptHandler(c.at(0), name(id).text, c.at(1));
+                handler->name_symbol = name(id).symbol;
+                node = handler;
+                break;
+            }
+            case NodeKind::ExprList:
+                node = new ExprList(c.list(0, n));
+                break;
+            case NodeKind::ClassDef: {
+                const auto class_def = new ClassDef(name(id).text, c.at<Arguments>(n - 1), c.at(n - 2),
+                                                    c.list(0, n - 2));
+                class_def->name_symbol = name(id).symbol;
+                node = class_def;
+                break;
+            }
+            case NodeKind::Attribute:
+                node = new Attribute(c.at(0), c.at(1));
+                break;
+            case NodeKind::IfStmt:
+                node = new IfStmt(c.at(0), c.at(1), c.at(2));
+                break;
+            case NodeKind::Alias:
+                node = new Alias(c.at(0), c.at<Name>(1));
+                break;
+            case NodeKind::Aliases:
+                node = new Aliases(c.list<Alias>(0, n));
+                break;
+            case NodeKind::Import:
+                node = new Import(c.at<Aliases>(0));
+                break;
+            case NodeKind::ImportFrom:
+                node = new ImportFrom(c.at(0), c.at<Aliases>(1), static_cast<int32_t>(payload));
+                break;
+            case NodeKind::TestList:
+                node = new TestList(c.list(0, n));
+                break;
+            case NodeKind::Return:
+                node = new Return(c.at<TestList>(0));
+                break;
+            case NodeKind::Break:
+                node = new Break();
+                break;
+            case NodeKind::Continue:
+                node = new Continue();
+                break;
+            case NodeKind::Assign:
+                node = new Assign(c.at<TestList>(0), c.at(1));
+                break;
+            case NodeKind::AugAssign:
+                node = new AugAssign(c.at(0), static_cast<int32_t>(payload), c.at(1));
+                break;
+            case NodeKind::AnnAssign:
+                node = new AnnAssign(c.at(0), c.at(1), c.at(2));
+                break;
+            case NodeKind::AssName:
+                node = new AssName(name(id).text, static_cast<AssignFlag>(name(id).symbol));
+                break;
+            case NodeKind::Discard:
+                node = new Discard(c.at(0));
+                break;
+            case NodeKind::StarredExpr:
+                node = new StarredExpr(c.at(0));
+                break;
+            case NodeKind::WhileStmt:
+                node = new WhileStmt(c.at(0), c.at(1), c.at(2));
+                break;
+            case NodeKind::Raise:
+                node = new Raise(c.at(0), c.at(1));
+                break;
+            case NodeKind::Yield:
+                node = new Yield(c.at(0));
+                break;
+            case NodeKind::Index:
+                node = new Index(c.at(0));
+                break;
+            case NodeKind::Slice:
+                node = new Slice(c.at(0), c.at(1), c.at(2));
+                break;
+            case NodeKind::Subscript:
+                node = new Subscript(c.at(0), c.at(1));
+                break;
+            case NodeKind::ExtSlice:
+                node = new ExtSlice(c.list(0, n));
+                break;
+            case NodeKind::YieldFrom:
+                node = new YieldFrom(c.at(0));
+                break;
+            case NodeKind::Delete:
+                node = new Delete(c.at<ExprList>(0));
+                break;
+            case NodeKind::Const: {
+                const auto &flat = constant(id);
+                const auto const_node = new Const(flat.value, flat.type);
+                const_node->literal = flat.literal;
+                const_node->number.kind = flat.number_kind;
+                const_node->number.int_value = flat.int_value;
+                const_node->number.float_value = flat.float_value;
+                const_node->number.limbs.assign(limbs(flat), limbs(flat) + flat.num_of_limbs);
+                node = const_node;
+                break;
+            }
+            case NodeKind::Arguments:
+                node = new Arguments(c.list(0, payload), c.list(payload, n));
+                break;
+            case NodeKind::Name:
+                node = new Name(name(id).text, name(id).symbol);
+                break;
+            case NodeKind::Argument:
+                node = new Argument(c.at<Name>(0), c.at(1), c.at(2));
+                break;
+            case NodeKind::Parameter:
+                node = new Parameter(c.at<Name>(0), c.at(1), c.at(2));
+                break;
+            case NodeKind::Parameters: {
+                // params, kwarg, vararg, pos_only_args, kw_only_args, kw_defaults and defaults
+                const auto &sizes = parameters(id);
+                const auto pos_only_begin = sizes.num_of_params + 2;
+                const auto kw_only_begin = pos_only_begin + sizes.num_of_pos_only_args;
+                const auto kw_defaults_begin = kw_only_begin + sizes.num_of_kw_only_args;
+                const auto defaults_begin = kw_defaults_begin + sizes.num_of_kw_defaults;
+                node = new Parameters(c.list(0, sizes.num_of_params),
+                                      {c.at(sizes.num_of_params), c.at(sizes.num_of_params + 1),
+                                       c.list(pos_only_begin, kw_only_begin),
+                                       c.list(kw_only_begin, kw_defaults_begin),
+                                       c.list(kw_defaults_begin, defaults_begin),
+                                       c.list(defaults_begin, n)});
+                break;
+            }
+            case NodeKind::Keyword:
+                node = new Keyword(name(id).text, name(id).symbol, c.at(0));
+                break;
+            case NodeKind::BinOp:
+                node = new BinOp(c.at(0), c.at(1), static_cast<int32_t>(payload));
+                break;
+            case NodeKind::SubscriptList:
+                node = new SubscriptList(c.at(n - 1), c.list(0, n - 1));
+                break;
+            case NodeKind::UnaryOp:
+                node = new UnaryOp(static_cast<int32_t>(payload), c.at(0));
+                break;
+            case NodeKind::BoolOp:
+                node = new BoolOp(c.at(0), c.at(1), static_cast<int32_t>(payload));
+                break;
+            case NodeKind::Comparison:
+                node = new Comparison(c.at(0), c.at(1), static_cast<int32_t>(payload));
+                break;
+            case NodeKind::FuncDef: {
+                const auto &flat = def(id);
+                const auto func_def = new FuncDef(flat.name, c.at<Parameters>(n - 3), c.at(n - 2), c.at(n - 1),
+                                                  c.list(0, n - 3));
+                func_def->name_symbol = flat.name_symbol;
+                func_def->body_begin = flat.body_begin;
+                func_def->body_end = flat.body_end;
+                node = func_def;
+                break;
+            }
+            case NodeKind::AsyncFuncDef: {
+                const auto &flat = def(id);
+                const auto func_def = new AsyncFuncDef(flat.name, c.at<Parameters>(n - 4), c.at(n - 3),
+                                                       c.at(n - 2), c.list(0, n - 4), c.at(n - 1));
+                func_def->name_symbol = flat.name_symbol;
+                func_def->body_begin = flat.body_begin;
+                func_def->body_end = flat.body_end;
+                node = func_def;
+                break;
+            }
+            case NodeKind::Lambda:
+                node = new Lambda(c.at(0), c.at(1));
+                break;
+            case NodeKind::Call:
+                node = new Call(c.at(0), c.at<Arguments>(1));
+                break;
+            case NodeKind::Pass:
+                node = new Pass();
+                break;
+            case NodeKind::Global:
+                node = new Global(c.list<Name>(0, n));
+                break;
+            case NodeKind::Assert:
+                node = new Assert(c.at(0), c.at(1));
+                break;
+            case NodeKind::Nonlocal:
+                node = new Nonlocal(c.list<Name>(0, n));
+                break;
+        }
+        nodes[id] = node;
+    }
+    for (const auto &[id, pos] : positions_) {
+        nodes[id]->pos_info = pos;
+    }
+
+    return nodes.empty() ? nullptr : nodes.front();
+}
+
+size_t FlatAst::numOfBytes() const noexcept {
+    return kinds_.capacity() * sizeof(NodeKind) +
+           children_begin_.capacity() * sizeof(uint32_t) +
+           children_.capacity() * sizeof(NodeId) +
+           payloads_.capacity() * sizeof(uint32_t) +
+           names_.capacity() * sizeof(FlatName) +
+           consts_.capacity() * sizeof(FlatConst) +
+           limbs_.capacity() * sizeof(uint32_t) +
+           defs_.capacity() * sizeof(FlatDef) +
+           parameters_.capacity() * sizeof(FlatParameters) +
+           positions_.capacity() * sizeof(std::pair<NodeId, Position>);
+}
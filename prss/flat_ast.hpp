@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "literals.hpp"
+#include "parser.hpp"
+#include "symbols.hpp"
+
+// Index of a node of a FlatAst
+using NodeId = uint32_t;
+
+// a child that's missing (a null one in the Node tree)
+constexpr NodeId NO_NODE = UINT32_MAX;
+
+// the payload of a node that has none
+constexpr uint32_t NO_PAYLOAD = UINT32_MAX;
+
+// A name, or any other text a node keeps along with a symbol (the doc of a Module, the name of a FuncDef or of
+// a ClassDef, the arg of a Keyword). AssName keeps its flags in place of the symbol.
+struct FlatName {
+    std::string_view text;
+    Symbol symbol;
+};
+
+// A Const, the limbs of a BIGINT are limbs_[limbs_begin, limbs_begin + num_of_limbs) of the tree
+struct FlatConst {
+    std::string_view value;
+    int32_t type;
+    LiteralId literal;
+    NumberKind number_kind;
+    uint32_t limbs_begin;
+    uint32_t num_of_limbs;
+    int64_t int_value;
+    double float_value;
+};
+
+// A FuncDef or an AsyncFuncDef, along with the tokens of its skipped suite (see FuncDef::body)
+struct FlatDef {
+    std::string_view name;
+    Symbol name_symbol;
+    uint32_t body_begin;
+    uint32_t body_end;
+};
+
+// The sizes of the lists of a Parameters, the defaults take the rest of its children
+struct FlatParameters {
+    uint32_t num_of_params;
+    uint32_t num_of_pos_only_args;
+    uint32_t num_of_kw_only_args;
+    uint32_t num_of_kw_defaults;
+};
+
+// A tree of Nodes laid out flat, as arrays indexed by the NodeIds of the nodes. The nodes are numbered in
+// preorder, i.e. in the order of the source, a node coming before its children. Every node has its kind, the range
+// of children_ holding the ids of its children and a payload. The children are the ones forEachChild() of its Node
+// visits, in the same order, the missing ones being NO_NODE. The payload is whatever else the node holds:
+//  - the op of a BinOp, a BoolOp, a UnaryOp, a Comparison and an AugAssign, the level of an ImportFrom and whether
+//    a Comprehension is async
+//  - the amount of the keys of a Dict and of the args of an Arguments, their lists of children being split there
+//  - an index into names_ for a Name, a Keyword, an ExceptHandler, a ClassDef, a Module and an AssName, into
+//    consts_ for a Const, into defs_ for a FuncDef and an AsyncFuncDef and into parameters_ for a Parameters
+//  - NO_PAYLOAD for the rest.
+// The few nodes that have a position keep it in positions_. A pass going over the nodes of some kinds only looks at
+// the kinds, one byte per node, and the ids are 32 bits wide, so a tree takes a fraction of the memory its Nodes do.
+//
+// The conversion is lossless both ways, astEqual() of a tree and of toTree() of its FlatAst holds. The texts refer
+// to whatever the ones of the tree do (the source of its lexer), hence a FlatAst can't outlive the lexer either.
+class FlatAst {
+public:
+    // The ids of the children of a node
+    struct Children {
+        const NodeId *first;
+        const NodeId *last;
+
+        inline const NodeId *begin() const noexcept { return first; }
+
+        inline const NodeId *end() const noexcept { return last; }
+
+        inline size_t size() const noexcept { return last - first; }
+
+        inline NodeId operator[](size_t idx) const noexcept { return first[idx]; }
+    };
+
+    // Lays out the tree (a null root makes an empty FlatAst)
+    explicit FlatAst(Node *root);
+
+    // Builds the Node tree back, in the arena of the current ArenaScope
+    Node *toTree() const;
+
+    inline size_t size() const noexcept { return kinds_.size(); }
+
+    inline NodeId root() const noexcept { return kinds_.empty() ? NO_NODE : 0; }
+
+    inline NodeKind kind(NodeId node) const noexcept { return kinds_[node]; }
+
+    inline Children children(NodeId node) const noexcept {
+        return {children_.data() + children_begin_[node], children_.data() + children_begin_[node + 1]};
+    }
+
+    inline uint32_t payload(NodeId node) const noexcept { return payloads_[node]; }
+
+    inline const FlatName &name(NodeId node) const noexcept { return names_[payloads_[node]]; }
+
+    inline const FlatConst &constant(NodeId node) const noexcept { return consts_[payloads_[node]]; }
+
+    inline const FlatDef &def(NodeId node) const noexcept { return defs_[payloads_[node]]; }
+
+    inline const FlatParameters &parameters(NodeId node) const noexcept { return parameters_[payloads_[node]]; }
+
+    inline const uint32_t *limbs(const FlatConst &constant) const noexcept {
+        return limbs_.data() + constant.limbs_begin;
+    }
+
+    // the memory the arrays take
+    size_t numOfBytes() const noexcept;
+
+private:
+    // Adds whatever the node holds besides its children to the side tables, returns its payload
+    uint32_t addPayload(Node *node);
+
+    std::vector<NodeKind> kinds_;
+    // the children of the node i are children_[children_begin_[i], children_begin_[i + 1])
+    std::vector<uint32_t> children_begin_;
+    std::vector<NodeId> children_;
+    std::vector<uint32_t> payloads_;
+    std::vector<FlatName> names_;
+    std::vector<FlatConst> consts_;
+    std::vector<uint32_t> limbs_;
+    std::vector<FlatDef> defs_;
+    std::vector<FlatParameters> parameters_;
+    // the nodes with a position, in the order of their ids
+    std::vector<std::pair<NodeId, Position>> positions_;
+};
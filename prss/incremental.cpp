@@ -0,0 +1,346 @@
+#include "incremental.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+    // A statement can't start with one of those, it got a span of its own only because of a syntax error.
+    // Once the statement before it gets edited, it may very well continue that one.
+    inline bool isContinuation(const size_t type) {
+        return type == Python3Parser::ELSE ||
+               type == Python3Parser::ELIF ||
+               type == Python3Parser::EXCEPT ||
+               type == Python3Parser::FINALLY;
+    }
+
+    inline bool isLineBreak(const char c) {
+        return c == '\n' || c == '\r' || c == '\f';
+    }
+
+    // the end of the indentation of the line starting at pos
+    inline size_t indentEnd(const std::string &text, size_t pos) {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) {
+            pos++;
+        }
+        return pos;
+    }
+
+    // the index of the span the byte at pos belongs to
+    template<typename Spans>
+    size_t spanAt(const Spans &spans, const size_t pos) {
+        const auto it = std::upper_bound(spans.begin(), spans.end(), pos, [](const size_t p, const auto &span) {
+            return p < span.start;
+        });
+        return it == spans.begin() ? 0 : it - spans.begin() - 1;
+    }
+
+    template<typename Blocks>
+    void takeErrors(Blocks &blocks, std::vector<ParseError> &errors) {
+        for (auto &block : blocks) {
+            for (auto &span : block.spans) {
+                std::move(span.errors.begin(), span.errors.end(), std::back_inserter(errors));
+                takeErrors(span.blocks, errors);
+            }
+        }
+    }
+
+    // Moves the errors of the blocks of the span to the span itself, the span is reparsed as a whole from now on
+    template<typename Span>
+    void dropBlocks(Span &span) {
+        takeErrors(span.blocks, span.errors);
+        span.blocks.clear();
+        std::stable_sort(span.errors.begin(), span.errors.end(), [](const ParseError &a, const ParseError &b) {
+            return a.token_idx < b.token_idx;
+        });
+    }
+
+    // Turns the spans starting with spans[first] into a single one with no blocks
+    template<typename Spans>
+    void mergeSpans(Spans &spans, const size_t first) {
+        auto &merged = spans[first];
+        for (auto i = first + 1; i < spans.size(); ++i) {
+            merged.num_of_stmts += spans[i].num_of_stmts;
+            std::move(spans[i].errors.begin(), spans[i].errors.end(), std::back_inserter(merged.errors));
+            takeErrors(spans[i].blocks, merged.errors);
+        }
+        dropBlocks(merged);
+        spans.erase(spans.begin() + first + 1, spans.end());
+    }
+
+    template<typename Spans>
+    void appendErrors(const Spans &spans, std::vector<ParseError> &errors) {
+        for (const auto &span : spans) {
+            errors.insert(errors.end(), span.errors.begin(), span.errors.end());
+            for (const auto &block : span.blocks) {
+                appendErrors(block.spans, errors);
+            }
+        }
+    }
+}
+
+IncrementalParser::IncrementalParser(std::string text) : text_(std::move(text)) {
+    {
+        ArenaScope scope(arena_);
+        root_ = new FileInput({});
+    }
+    top_.stmts = &root_->statements;
+    top_.end = text_.size();
+    // a single empty span, reparsed along with the whole text after it
+    top_.spans.push_back({0, 1, Python3Parser::EOF, 0, {}, {}});
+    reparse({&top_, 0, 0, 0, 1});
+}
+
+IncrementalParser::~IncrementalParser() {
+    for (const auto lexer : lexers_) {
+        delete lexer;
+    }
+}
+
+void IncrementalParser::edit(const size_t start, const size_t end, const std::string_view replacement) {
+    if (start > end || end > text_.size()) {
+        throw std::out_of_range("the edit is out of the text");
+    }
+
+    // the blocks the edit lies within, from the top level down to the innermost one
+    std::vector<Target> targets;
+    auto block = &top_;
+    while (true) {
+        const auto span_idx = spanAt(block->spans, start);
+        Target target{block, span_idx, spanAt(block->spans, end > start ? end - 1 : start), 0, 0};
+
+        auto &span = block->spans[span_idx];
+        if (std::none_of(text_.begin() + span.start, text_.begin() + start, isLineBreak)) {
+            // the first line of the span, an edit there may join it to the span before
+            if (span_idx > 0) {
+                target.first--;
+            } else if (block != &top_) {
+                // or to the statement the block is in
+                break;
+            }
+        }
+        target.begin = block->spans[target.first].start;
+        target.line = block->spans[target.first].line;
+        targets.push_back(target);
+
+        if (target.last != span_idx) {
+            break;
+        }
+        const auto nested = std::find_if(span.blocks.begin(), span.blocks.end(), [&](const Block &b) {
+            return b.spans.front().start <= start && start < b.end && end <= b.end;
+        });
+        if (nested == span.blocks.end()) {
+            break;
+        }
+        block = &*nested;
+    }
+
+    const auto num_of_removed_lines = std::count(text_.begin() + start, text_.begin() + end, '\n');
+    const auto num_of_added_lines = std::count(replacement.begin(), replacement.end(), '\n');
+    text_.replace(start, end - start, replacement);
+    shift(top_, end, static_cast<ptrdiff_t>(replacement.size()) - static_cast<ptrdiff_t>(end - start),
+          num_of_added_lines - num_of_removed_lines);
+
+    stats_ = {};
+    for (auto it = targets.rbegin(); it != targets.rend(); ++it) {
+        stats_.depth = targets.rend() - it - 1;
+        if (reparse(*it)) {
+            break;
+        }
+    }
+}
+
+void IncrementalParser::edit(std::vector<TextEdit> edits) {
+    std::sort(edits.begin(), edits.end(), [](const TextEdit &a, const TextEdit &b) { return a.start > b.start; });
+    for (const auto &text_edit : edits) {
+        edit(text_edit.start, text_edit.end, text_edit.text);
+    }
+}
+
+std::vector<ParseError> IncrementalParser::errors() const {
+    std::vector<ParseError> errors;
+    appendErrors(top_.spans, errors);
+    return errors;
+}
+
+bool IncrementalParser::reparse(const Target &target) {
+    auto &block = *target.block;
+    const auto is_nested = !block.indents.empty();
+    const auto indent = is_nested ? block.indents.back() : 0;
+
+    std::vector<LexedToken> lexed_tokens;
+    auto limit = target.last + 1;
+    while (true) {
+        const auto is_block_end = limit == block.spans.size();
+        const auto end = is_block_end ? block.end : block.spans[limit].start;
+        // a span indented differently than the block got one of its own only because of a syntax error, once the
+        // part before it is relexed, it may very well be inside of a statement of the part
+        if (!is_block_end && (isContinuation(block.spans[limit].first_type) ||
+                              indentWidth(text_.data(), end, indentEnd(text_, end)) != indent)) {
+            ++limit;
+            continue;
+        }
+
+        stats_.relexed_bytes += end - target.begin;
+        size_t unsplittable;
+        if (!lexRegion(text_.data(), text_.size(), target.begin, end, target.line, block.indents, lexed_tokens,
+                       unsplittable)) {
+            if (is_block_end) {
+                return false;
+            }
+            ++limit;
+            continue;
+        }
+
+        // the symbols and the literals of the part point into its lexer from now on
+        const auto lexer = new PyLexer(text_, target.begin, end, lexed_tokens, symbols_, literals_);
+        lexers_.push_back(lexer);
+        std::vector<StmtMark> marks;
+        auto result = parse(*lexer, marks);
+        auto &stmts = static_cast<FileInput *>(result.root)->statements;
+
+        // an error at the EOF ending the part means the parser looked past it, at whatever comes next in the text
+        const auto eof_idx = lexer->tokens().size() - 1;
+        const auto looked_past = (is_nested || end < text_.size()) &&
+                                 std::any_of(result.errors.begin(), result.errors.end(), [&](const ParseError &e) {
+                                     return e.token_idx == eof_idx;
+                                 });
+        if (looked_past) {
+            if (is_block_end) {
+                return false;
+            }
+            ++limit;
+            continue;
+        }
+
+        Block part{&stmts, block.indents, {}, end};
+        size_t mark_idx = 0;
+        size_t error_idx = 0;
+        collectSpans(part, *lexer, marks, mark_idx, result.errors, error_idx);
+        if (part.spans.empty()) {
+            part.spans.push_back({target.begin, target.line, Python3Parser::EOF, 0, {}, {}});
+        }
+        if (unsplittable < end) {
+            // the part reaches the end of the text then, none of the lines after it can be reparsed on its own
+            mergeSpans(part.spans, spanAt(part.spans, unsplittable));
+        }
+        part.spans.front().start = target.begin;
+        part.spans.front().line = target.line;
+
+        size_t stmt_idx = 0;
+        for (size_t i = 0; i < target.first; ++i) {
+            stmt_idx += block.spans[i].num_of_stmts;
+        }
+        size_t num_of_old_stmts = 0;
+        for (auto i = target.first; i < limit; ++i) {
+            num_of_old_stmts += block.spans[i].num_of_stmts;
+        }
+
+        auto &block_stmts = *block.stmts;
+        block_stmts.erase(block_stmts.begin() + stmt_idx, block_stmts.begin() + stmt_idx + num_of_old_stmts);
+        block_stmts.insert(block_stmts.begin() + stmt_idx, stmts.begin(), stmts.end());
+        stats_.reparsed_stmts = stmts.size();
+        stmts.clear();
+
+        block.spans.erase(block.spans.begin() + target.first, block.spans.begin() + limit);
+        block.spans.insert(block.spans.begin() + target.first, std::make_move_iterator(part.spans.begin()),
+                           std::make_move_iterator(part.spans.end()));
+        return true;
+    }
+}
+
+void IncrementalParser::shift(Block &block, const size_t pos, const ptrdiff_t num_of_bytes,
+                              const int64_t num_of_lines) {
+    if (block.end >= pos) {
+        block.end += num_of_bytes;
+    }
+
+    // the spans before the one pos is in are out of the way, and so are their blocks
+    for (auto i = spanAt(block.spans, pos); i < block.spans.size(); ++i) {
+        auto &span = block.spans[i];
+        if (span.start >= pos) {
+            span.start += num_of_bytes;
+            span.line += num_of_lines;
+            for (auto &error : span.errors) {
+                error.line += num_of_lines;
+            }
+        }
+        for (auto &nested : span.blocks) {
+            shift(nested, pos, num_of_bytes, num_of_lines);
+        }
+    }
+}
+
+void IncrementalParser::collectSpans(Block &block, const PyLexer &lexer, const std::vector<StmtMark> &marks,
+                                     size_t &mark_idx, std::vector<ParseError> &errors, size_t &error_idx) const {
+    const auto stmts = marks[mark_idx].block;
+    // the amount of the statements of the block before the last span
+    uint32_t num_of_stmts = 0;
+    while (mark_idx < marks.size()) {
+        const auto &mark = marks[mark_idx];
+        // the errors found since the previous mark are the ones of the innermost span, the last one of the block
+        for (; error_idx < mark.num_of_errors && !block.spans.empty(); ++error_idx) {
+            block.spans.back().errors.push_back(std::move(errors[error_idx]));
+        }
+
+        const auto tok = lexer.token(mark.token_idx);
+        if (mark.block != stmts) {
+            // a block of the statement of the last span, right after its INDENT (the first line of the block may be
+            // joined to the next one by a backslash, so it's the INDENT that tells where the block starts)
+            const auto indent = lexer.token(mark.token_idx - 1);
+            Block nested{mark.block, block.indents, {}, 0};
+            nested.indents.push_back(indentWidth(text_.data(), indent.getStartIndex(),
+                                                 indent.getStartIndex() + indent.getLength()));
+            collectSpans(nested, lexer, marks, mark_idx, errors, error_idx);
+            if (!nested.spans.empty()) {
+                nested.spans.front().start = indent.getStartIndex();
+                nested.spans.front().line = static_cast<uint32_t>(indent.getLine());
+                block.spans.back().blocks.push_back(std::move(nested));
+            }
+            continue;
+        }
+
+        ++mark_idx;
+        if (mark.is_end) {
+            if (!block.spans.empty()) {
+                block.spans.back().num_of_stmts = mark.num_of_stmts - num_of_stmts;
+            }
+            const auto end = tok.getStartIndex();
+            block.end = end >= text_.size() ? text_.size() : lineStart(end);
+            break;
+        }
+
+        // a statement starts a span of its own if it's the first one on a logical line of the block, otherwise
+        // it was preceded by a syntax error and goes along with it
+        const auto type = tok.getType();
+        const auto line_start = lineStart(tok.getStartIndex());
+        const auto previous_type = mark.token_idx > 0 ? lexer.token(mark.token_idx - 1).getType() : 0;
+        const auto starts_span = block.spans.empty() ||
+                                 (line_start != std::string::npos &&
+                                  (previous_type == Python3Parser::NEWLINE || previous_type == Python3Parser::DEDENT) &&
+                                  type != Python3Parser::NEWLINE &&
+                                  type != Python3Parser::INDENT &&
+                                  type != Python3Parser::DEDENT);
+        if (starts_span) {
+            if (!block.spans.empty()) {
+                block.spans.back().num_of_stmts = mark.num_of_stmts - num_of_stmts;
+            }
+            num_of_stmts = mark.num_of_stmts;
+            block.spans.push_back({line_start, static_cast<uint32_t>(tok.getLine()), type, 0, {}, {}});
+        }
+    }
+
+    // a statement with errors of its own is reparsed as a whole, its blocks may not even be in the tree
+    for (auto &span : block.spans) {
+        if (!span.errors.empty() && !span.blocks.empty()) {
+            dropBlocks(span);
+        }
+    }
+}
+
+size_t IncrementalParser::lineStart(size_t pos) const {
+    while (pos > 0 && (text_[pos - 1] == ' ' || text_[pos - 1] == '\t')) {
+        pos--;
+    }
+    return pos == 0 || isLineBreak(text_[pos - 1]) ? pos : std::string::npos;
+}
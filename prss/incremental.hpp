@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.hpp"
+
+// Replaces the bytes [start, end) of a text with text
+struct TextEdit {
+    size_t start;
+    size_t end;
+    std::string text;
+};
+
+// What the last edit took
+struct ReparseStats {
+    // the bytes lexed again, along with the ones of the attempts that didn't end at a statement
+    size_t relexed_bytes = 0;
+    // the statements of the reparsed part
+    size_t reparsed_stmts = 0;
+    // the nesting depth of the block they're in, 0 at the top level
+    size_t depth = 0;
+};
+
+// Keeps the tree of a text up to date as the text gets edited, without parsing the whole of it again.
+//
+// Each block (the top level, or the suite of a compound statement) is split into spans, one per statement, a span
+// starting at the start of the line of its statement and ending where the next one starts (the blank lines and
+// comments in between go to the span before). The lexer and the parser are in the same state at the start of every
+// span of a block, so an edit only has to relex and reparse the spans it touches in the innermost block it lies
+// within (plus the span before, if it touches the first line of one, which might become the else of an if, or a
+// part of the suite before). The reparsed part goes on up to the first span that still starts a statement once
+// relexed. If the part can't end within the block (i.e. an edit dedents a line of it), the enclosing statement is
+// reparsed in the block around it instead. The nodes of the reparsed spans are replaced by the new ones, the rest of
+// the tree stays as is. A statement with a syntax error of its own is not split into blocks, it's reparsed as a whole.
+// A quote with no string after it, or a closing bracket with no opening one, change the way the rest of the text is
+// lexed, so everything from their span on makes up a single span reparsed along with the rest of the text.
+//
+// Every reparsed part gets a lexer of its own holding a copy of the part, which the nodes point into, so the lexers
+// live as long as the parser does. The nodes are made in the arenas of the lexers as well, so the ones an edit
+// replaces stay around until the parser goes away. The lexers share a single SymbolTable and LiteralPool, hence the
+// symbols and the literal ids are the same throughout the tree. The positions (pos_info) of the nodes kept after an
+// edit are not moved along, the errors are.
+class IncrementalParser {
+public:
+    explicit IncrementalParser(std::string text);
+
+    IncrementalParser(const IncrementalParser &) = delete;
+
+    IncrementalParser &operator=(const IncrementalParser &) = delete;
+
+    ~IncrementalParser();
+
+    // Replaces the bytes [start, end) of the text with replacement and brings the tree up to date
+    void edit(size_t start, size_t end, std::string_view replacement);
+
+    // Applies the edits, given as ranges of the current text that don't overlap, starting with the last one,
+    // so that the ranges of the others stay valid
+    void edit(std::vector<TextEdit> edits);
+
+    inline const std::string &text() const noexcept { return text_; }
+
+    inline FileInput *tree() const noexcept { return root_; }
+
+    // the errors of the whole text, in the order of the statements
+    std::vector<ParseError> errors() const;
+
+    inline const ReparseStats &lastStats() const noexcept { return stats_; }
+
+    inline const SymbolTable &symbols() const noexcept { return symbols_; }
+
+    inline LiteralPool &literals() noexcept { return literals_; }
+
+private:
+    struct Block;
+
+    struct Span {
+        // the start of the line the statement starts on
+        size_t start;
+        uint32_t line;
+        // the type of its first token
+        size_t first_type;
+        // the amount of the statements of the block that came out of the span
+        uint32_t num_of_stmts;
+        // the errors found in the span, but not in its blocks
+        std::vector<ParseError> errors;
+        // the blocks of the statement, none if it has errors of its own
+        std::vector<Block> blocks;
+    };
+
+    struct Block {
+        // the statements in the node of the block
+        NodeList *stmts;
+        // the indentation stack inside of the block, empty at the top level
+        std::vector<int32_t> indents;
+        std::vector<Span> spans;
+        // the start of the line following the block
+        size_t end;
+    };
+
+    // The spans of a block an edit touches
+    struct Target {
+        Block *block;
+        size_t first;
+        size_t last;
+        // the start and the line of the span first before the edit
+        size_t begin;
+        uint32_t line;
+    };
+
+    // Relexes and reparses the spans [first, last] of the block (already moved to their places in the edited text)
+    // and as many of the ones after them as needed. Returns false if that can't be done without the enclosing block.
+    bool reparse(const Target &target);
+
+    // Moves whatever is at or after pos by the given amounts of bytes and lines
+    void shift(Block &block, size_t pos, ptrdiff_t num_of_bytes, int64_t num_of_lines);
+
+    // Makes the spans of the block the marks starting at marks[mark_idx] are of, up to its end mark, and
+    // attributes the errors starting at errors[error_idx] to them
+    void collectSpans(Block &block, const PyLexer &lexer, const std::vector<StmtMark> &marks, size_t &mark_idx,
+                      std::vector<ParseError> &errors, size_t &error_idx) const;
+
+    // the start of the line of the byte at pos, or pos if there's something else than whitespace in front of it
+    size_t lineStart(size_t pos) const;
+
+    std::string text_;
+    SymbolTable symbols_;
+    LiteralPool literals_;
+    std::vector<PyLexer *> lexers_;
+    // the arena of the root, the rest of the tree is in the ones of the lexers
+    Arena arena_;
+    FileInput *root_;
+    Block top_;
+    ReparseStats stats_;
+};
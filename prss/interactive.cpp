@@ -0,0 +1,184 @@
+#include "interactive.hpp"
+
+#include <initializer_list>
+
+namespace {
+    inline bool isBlank(const char c) {
+        return c == ' ' || c == '\t' || c == '\f';
+    }
+
+    inline bool isWordChar(const char c) {
+        return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    }
+
+    bool isOneOf(std::string_view word, std::initializer_list<std::string_view> words) {
+        for (const auto w : words) {
+            if (word == w) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+void InteractiveParser::feed(std::string_view chunk, const StatementCallback &on_statement) {
+    buffer_.append(chunk.data(), chunk.size());
+    while (true) {
+        const auto newline = buffer_.find('\n', scan_pos_);
+        if (newline == std::string::npos) {
+            break;
+        }
+
+        scanLine(scan_pos_, newline + 1, on_statement);
+        scan_pos_ = newline + 1;
+        line_++;
+    }
+
+    // the text of the statements handed out is dropped once per chunk, not once per statement
+    if (stmt_start_ > 0) {
+        buffer_.erase(0, stmt_start_);
+        scan_pos_ -= stmt_start_;
+        stmt_start_ = 0;
+    }
+}
+
+void InteractiveParser::finish(const StatementCallback &on_statement) {
+    if (scan_pos_ < buffer_.size()) {
+        // the last line, with no newline at the end
+        scanLine(scan_pos_, buffer_.size(), on_statement);
+        scan_pos_ = buffer_.size();
+    }
+    if (has_stmt_) {
+        handOut(buffer_.size(), line_, on_statement);
+    }
+
+    buffer_.clear();
+    scan_pos_ = 0;
+    stmt_start_ = 0;
+    stmt_line_ = 1;
+    line_ = 1;
+    continued_ = false;
+    opened_ = 0;
+    quote_ = 0;
+    is_long_ = false;
+}
+
+void InteractiveParser::scanLine(size_t begin, size_t end, const StatementCallback &on_statement) {
+    if (continued_) {
+        scanLogical(begin, end);
+        if (!continued_ && !is_compound_) {
+            handOut(end, line_ + 1, on_statement);
+        }
+        return;
+    }
+
+    auto pos = begin;
+    while (pos < end && isBlank(buffer_[pos])) {
+        pos++;
+    }
+
+    if (pos == end || buffer_[pos] == '\r' || buffer_[pos] == '\n' || buffer_[pos] == '#') {
+        // no statement starts on a blank line, but in the interactive mode an empty one ends the compound one
+        if (interactive_ && has_stmt_ && (pos == end || buffer_[pos] != '#')) {
+            handOut(end, line_ + 1, on_statement);
+        }
+        return;
+    }
+
+    if (pos == begin) {
+        auto word_end = pos;
+        while (word_end < end && isWordChar(buffer_[word_end])) {
+            word_end++;
+        }
+        const std::string_view word(buffer_.data() + pos, word_end - pos);
+        const auto is_decorator = buffer_[pos] == '@';
+
+        if (!has_stmt_ || (!is_decorated_ && !isOneOf(word, {"else", "elif", "except", "finally"}))) {
+            if (has_stmt_) {
+                handOut(begin, line_, on_statement);
+            }
+            // the blank lines in front of it are dropped, the lexer would make a NEWLINE of them
+            stmt_start_ = begin;
+            stmt_line_ = line_;
+            has_stmt_ = true;
+            is_compound_ = is_decorator ||
+                           isOneOf(word, {"if", "while", "for", "try", "with", "def", "class", "async"});
+        }
+        is_decorated_ = is_decorator;
+    } else if (!has_stmt_) {
+        // an unexpected indent, the statement is handed out as is to get it reported
+        stmt_start_ = begin;
+        stmt_line_ = line_;
+        has_stmt_ = true;
+        is_compound_ = false;
+        is_decorated_ = false;
+    }
+
+    scanLogical(pos, end);
+    if (!continued_ && !is_compound_) {
+        handOut(end, line_ + 1, on_statement);
+    }
+}
+
+void InteractiveParser::scanLogical(size_t pos, size_t end) {
+    const auto data = buffer_.data();
+    auto backslash = false;
+    for (auto i = pos; i < end; ++i) {
+        const auto c = data[i];
+        if (quote_) {
+            if (c == '\\') {
+                // an escaped newline continues a short string too
+                i++;
+            } else if (c == quote_) {
+                if (!is_long_) {
+                    quote_ = 0;
+                } else if (i + 2 < end && data[i + 1] == c && data[i + 2] == c) {
+                    quote_ = 0;
+                    i += 2;
+                }
+            } else if (c == '\n' && !is_long_) {
+                // a short string with no end, the lexer is going to complain about it
+                quote_ = 0;
+            }
+            continue;
+        }
+
+        if (c == '#') {
+            break;
+        } else if (c == '\'' || c == '"') {
+            quote_ = c;
+            is_long_ = i + 2 < end && data[i + 1] == c && data[i + 2] == c;
+            if (is_long_) {
+                i += 2;
+            }
+        } else if (c == '(' || c == '[' || c == '{') {
+            opened_++;
+        } else if (c == ')' || c == ']' || c == '}') {
+            // an extra closing bracket is left to the parser
+            opened_ = opened_ > 0 ? opened_ - 1 : 0;
+        } else if (c == '\\' && (i + 1 == end || data[i + 1] == '\n' ||
+                                 (data[i + 1] == '\r' && (i + 2 == end || data[i + 2] == '\n')))) {
+            backslash = true;
+            break;
+        }
+    }
+
+    continued_ = quote_ != 0 || opened_ > 0 || backslash;
+}
+
+void InteractiveParser::handOut(size_t end, uint32_t next_line, const StatementCallback &on_statement) {
+    {
+        PyLexer lexer(std::string_view(buffer_).substr(stmt_start_, end - stmt_start_), stmt_line_);
+        const auto result = parseSingle(lexer);
+        if (on_statement) {
+            on_statement(lexer, result);
+        }
+    }
+
+    num_of_statements_++;
+    stmt_start_ = end;
+    stmt_line_ = next_line;
+    has_stmt_ = false;
+    is_compound_ = false;
+    is_decorated_ = false;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "parser.hpp"
+
+// Called with every statement as soon as it's complete, while the lexer the tree points into is still alive.
+// The tree is destroyed as soon as it returns.
+using StatementCallback = std::function<void(PyLexer &lexer, const ParseResult &result)>;
+
+// Parses an input that arrives in chunks (i.e. an interactive session, or a stream that doesn't fit into memory),
+// handing out each statement once it's complete.
+//
+// The input is looked at a line at a time, once the whole line is there. The lines are scanned just enough to tell
+// where the logical lines end (keeping track of the open brackets, strings and backslash continuations across the
+// lines, and hence across the chunks) and where the statements start. A simple statement is complete at the end of
+// its logical line, a compound one (or a decorated one) once a line at the top level that isn't else, elif, except,
+// finally, or the definition a decorator belongs to, shows up. In the interactive mode an empty line ends a
+// compound statement too, the way it does in the Python REPL.
+//
+// A complete statement is lexed on its own and parsed with parseSingle(), and then its text is dropped. None of the
+// input is ever lexed twice, and only the text of the statement being read is held, so an input made up of any amount
+// of statements is parsed in constant memory. The names are interned per statement, since the symbol tables only
+// hold views into the text.
+class InteractiveParser {
+public:
+    explicit InteractiveParser(bool interactive = false) : interactive_(interactive) {}
+
+    // Appends a chunk of the input, handing out the statements it completes
+    void feed(std::string_view chunk, const StatementCallback &on_statement);
+
+    // Hands out whatever is left at the end of the input
+    void finish(const StatementCallback &on_statement);
+
+    // whether a statement has been started but isn't complete yet, i.e. the prompt of a continuation line is due
+    inline bool isPending() const noexcept { return has_stmt_ || continued_; }
+
+    // the amount of the statements handed out so far
+    inline size_t numOfStatements() const noexcept { return num_of_statements_; }
+
+private:
+    // Scans the line [begin, end) of the buffer, handing out the statements it completes
+    void scanLine(size_t begin, size_t end, const StatementCallback &on_statement);
+
+    // Scans the part of the line [pos, end) that is a part of a logical line, which ends with it unless continued_
+    void scanLogical(size_t pos, size_t end);
+
+    // Lexes and parses the statement [stmt_start_, end) of the buffer, the next one starting at end on next_line
+    void handOut(size_t end, uint32_t next_line, const StatementCallback &on_statement);
+
+    const bool interactive_;
+    // the input not handed out yet, starting with the statement being read
+    std::string buffer_;
+    // the start of the first line of the buffer that hasn't been scanned
+    size_t scan_pos_ = 0;
+    // the start and the first line of the statement being read
+    size_t stmt_start_ = 0;
+    uint32_t stmt_line_ = 1;
+    // the line at scan_pos_
+    uint32_t line_ = 1;
+    // whether a statement has been started, whether it is a compound one, and whether its last line at the top level
+    // is a decorator
+    bool has_stmt_ = false;
+    bool is_compound_ = false;
+    bool is_decorated_ = false;
+    // whether the logical line goes on with the next line
+    bool continued_ = false;
+    // the amount of the open brackets
+    int32_t opened_ = 0;
+    // the quote of the string the line ends in (0 if none), whether it's a long string
+    char quote_ = 0;
+    bool is_long_ = false;
+    size_t num_of_statements_ = 0;
+};
@@ -0,0 +1,924 @@
+#include "lexer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace {
+    inline bool isDigit(const int32_t c) {
+        return c >= '0' && c <= '9';
+    }
+
+    inline bool isHexDigit(const int32_t c) {
+        return isDigit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+    }
+
+    inline bool isOctDigit(const int32_t c) {
+        return c >= '0' && c <= '7';
+    }
+
+    inline bool isBinDigit(const int32_t c) {
+        return c == '0' || c == '1';
+    }
+
+    inline bool isAsciiAlpha(const int32_t c) {
+        return (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+    }
+
+    // every byte of a multibyte UTF-8 sequence is considered to be a part of an identifier
+    inline bool isIdentStart(const int32_t c) {
+        return c == '_' || isAsciiAlpha(c) || c >= 0x80;
+    }
+
+    inline bool isIdentContinue(const int32_t c) {
+        return isIdentStart(c) || isDigit(c);
+    }
+
+    inline bool isSpace(const int32_t c) {
+        return c == ' ' || c == '\t';
+    }
+
+    inline bool isNewline(const int32_t c) {
+        return c == '\r' || c == '\n' || c == '\f';
+    }
+
+    inline bool isQuote(const int32_t c) {
+        return c == '\'' || c == '"';
+    }
+
+    size_t keywordType(const char *s, const size_t n) {
+#define KEYWORD(kw, type) if (n == sizeof(kw) - 1 && memcmp(s, kw, n) == 0) return Python3Parser::type
+        if (n < 2 || n > 8) {
+            return Python3Parser::NAME;
+        }
+
+        switch (s[0]) {
+            case 'F':
+                KEYWORD("False", FALSE);
+                break;
+            case 'N':
+                KEYWORD("None", NONE);
+                break;
+            case 'T':
+                KEYWORD("True", TRUE);
+                break;
+            case 'a':
+                KEYWORD("and", AND);
+                KEYWORD("as", AS);
+                KEYWORD("assert", ASSERT);
+                KEYWORD("async", ASYNC);
+                KEYWORD("await", AWAIT);
+                break;
+            case 'b':
+                KEYWORD("break", BREAK);
+                break;
+            case 'c':
+                KEYWORD("class", CLASS);
+                KEYWORD("continue", CONTINUE);
+                break;
+            case 'd':
+                KEYWORD("def", DEF);
+                KEYWORD("del", DEL);
+                break;
+            case 'e':
+                KEYWORD("elif", ELIF);
+                KEYWORD("else", ELSE);
+                KEYWORD("except", EXCEPT);
+                break;
+            case 'f':
+                KEYWORD("finally", FINALLY);
+                KEYWORD("for", FOR);
+                KEYWORD("from", FROM);
+                break;
+            case 'g':
+                KEYWORD("global", GLOBAL);
+                break;
+            case 'i':
+                KEYWORD("if", IF);
+                KEYWORD("import", IMPORT);
+                KEYWORD("in", IN);
+                KEYWORD("is", IS);
+                break;
+            case 'l':
+                KEYWORD("lambda", LAMBDA);
+                break;
+            case 'n':
+                KEYWORD("nonlocal", NONLOCAL);
+                KEYWORD("not", NOT);
+                break;
+            case 'o':
+                KEYWORD("or", OR);
+                break;
+            case 'p':
+                KEYWORD("pass", PASS);
+                break;
+            case 'r':
+                KEYWORD("raise", RAISE);
+                KEYWORD("return", RETURN);
+                break;
+            case 't':
+                KEYWORD("try", TRY);
+                break;
+            case 'w':
+                KEYWORD("while", WHILE);
+                KEYWORD("with", WITH);
+                break;
+            case 'y':
+                KEYWORD("yield", YIELD);
+                break;
+            default:
+                break;
+        }
+#undef KEYWORD
+
+        return Python3Parser::NAME;
+    }
+}
+
+int32_t indentWidth(const char *data, size_t spaces_start, size_t spaces_end) {
+    int32_t indent = 0;
+    for (auto i = spaces_start; i < spaces_end; ++i) {
+        if (data[i] == '\t') {
+            indent += 8 - (indent % 8);
+        } else {
+            indent++;
+        }
+    }
+    return indent;
+}
+
+NativeLexer::NativeLexer(const char *data, size_t size)
+        : data_(data), size_(size), limit_(size) {}
+
+NativeLexer::NativeLexer(const char *data, size_t size, size_t begin, size_t limit, uint32_t line)
+        : data_(data), size_(size), limit_(limit), defer_indentation_(true), pos_(begin), line_(line),
+          line_start_(begin) {}
+
+bool NativeLexer::next(LexedToken &tok) {
+    if (pending_head_ == pending_.size()) {
+        pending_.clear();
+        pending_head_ = 0;
+        if (done_) {
+            return false;
+        }
+        scan();
+        if (pending_.empty()) {
+            return false;
+        }
+    }
+
+    tok = pending_[pending_head_++];
+    return true;
+}
+
+void NativeLexer::push(size_t type, size_t start, size_t length) {
+    pending_.push_back({type, static_cast<uint32_t>(start), static_cast<uint32_t>(length), line_,
+                        static_cast<uint32_t>(start - line_start_)});
+}
+
+void NativeLexer::scan() {
+    while (pending_.empty()) {
+        if (pos_ >= limit_ && limit_ < size_) {
+            // the end of the chunk, the rest of the source is someone else's
+            done_ = true;
+            return;
+        }
+
+        if (pos_ >= size_) {
+            // same as the ANTLR lexer does: terminate the last statement and close all open blocks
+            if (!indents_.empty()) {
+                push(Python3Parser::NEWLINE, size_, 0);
+                while (!indents_.empty()) {
+                    push(Python3Parser::DEDENT, size_, 0);
+                    indents_.pop_back();
+                }
+            }
+            push(Python3Parser::EOF, size_, 0);
+            done_ = true;
+            return;
+        }
+
+        const auto c = peek(0);
+        switch (c) {
+            case ' ':
+            case '\t': {
+                // leading spaces of the very first line are matched by NEWLINE
+                if (pos_ == 0) {
+                    scanNewline();
+                    break;
+                }
+                while (isSpace(peek(0))) {
+                    pos_++;
+                }
+                break;
+            }
+            case '#': {
+                while (pos_ < size_ && !isNewline(peek(0))) {
+                    pos_++;
+                }
+                break;
+            }
+            case '\\': {
+                // line joining: '\\' SPACES? ('\r'? '\n' | '\r' | '\f')
+                size_t offset = 1;
+                while (isSpace(peek(offset))) {
+                    offset++;
+                }
+                if (!isNewline(peek(offset))) {
+                    push(Python3Parser::UNKNOWN_CHAR, pos_, 1);
+                    pos_++;
+                    break;
+                }
+                if (peek(offset) == '\r' && peek(offset + 1) == '\n') {
+                    offset++;
+                }
+                pos_ += offset + 1;
+                if (data_[pos_ - 1] == '\n') {
+                    line_++;
+                    line_start_ = pos_;
+                }
+                break;
+            }
+            case '\r':
+            case '\n':
+            case '\f':
+                scanNewline();
+                break;
+            case '\'':
+            case '"': {
+                const auto length = stringLength(0, false);
+                if (length == 0) {
+                    push(Python3Parser::UNKNOWN_CHAR, pos_, 1);
+                    pos_++;
+                } else {
+                    push(Python3Parser::STRING, pos_, length);
+                    skipString(length);
+                }
+                break;
+            }
+            default: {
+                if (isIdentStart(c)) {
+                    scanName();
+                } else if (isDigit(c) || (c == '.' && isDigit(peek(1)))) {
+                    scanNumber();
+                } else {
+                    scanOperator();
+                }
+                break;
+            }
+        }
+    }
+}
+
+void NativeLexer::skipString(size_t length) {
+    const auto end = pos_ + length;
+    for (; pos_ < end; pos_++) {
+        if (data_[pos_] == '\n') {
+            line_++;
+            line_start_ = pos_ + 1;
+        }
+    }
+}
+
+// NEWLINE: ( {atStartOfInput()}? SPACES | ( '\r'? '\n' | '\r' | '\f' ) SPACES? )
+void NativeLexer::scanNewline() {
+    const auto newline_start = pos_;
+    const auto newline_line = line_;
+    const auto newline_col = static_cast<uint32_t>(pos_ - line_start_);
+
+    if (peek(0) == '\r') {
+        pos_++;
+        if (peek(0) == '\n') {
+            pos_++;
+        }
+    } else if (isNewline(peek(0))) {
+        pos_++;
+    }
+
+    const auto newline_end = pos_;
+    if (newline_end > newline_start && data_[newline_end - 1] == '\n') {
+        line_++;
+        line_start_ = newline_end;
+    }
+
+    const auto spaces_start = pos_;
+    while (isSpace(peek(0))) {
+        pos_++;
+    }
+
+    // Strip newlines inside open clauses except if we are near EOF.
+    const auto next = peek(0);
+    const auto next_next = peek(1);
+    if (opened_ > 0 || (next_next != -1 && (isNewline(next) || next == '#'))) {
+        return;
+    }
+
+    pending_.push_back({Python3Parser::NEWLINE, static_cast<uint32_t>(newline_start),
+                        static_cast<uint32_t>(newline_end - newline_start), newline_line, newline_col});
+    pushIndentation(spaces_start, pos_);
+}
+
+void NativeLexer::pushIndentation(size_t spaces_start, size_t spaces_end) {
+    if (defer_indentation_) {
+        push(INDENTATION, spaces_start, spaces_end - spaces_start);
+        return;
+    }
+
+    const auto indent = indentWidth(data_, spaces_start, spaces_end);
+    const auto previous = indents_.empty() ? 0 : indents_.back();
+    if (indent > previous) {
+        indents_.push_back(indent);
+        push(Python3Parser::INDENT, spaces_start, spaces_end - spaces_start);
+    } else {
+        // possibly emit more than 1 DEDENT token
+        while (!indents_.empty() && indents_.back() > indent) {
+            push(Python3Parser::DEDENT, spaces_end, 0);
+            indents_.pop_back();
+        }
+    }
+}
+
+void NativeLexer::scanName() {
+    const auto c = peek(0) | 0x20;
+    if (c == 'r' || c == 'u' || c == 'f' || c == 'b') {
+        size_t prefix_len = 0;
+        bool is_bytes = false;
+        if (isQuote(peek(1))) {
+            prefix_len = 1;
+            is_bytes = c == 'b';
+        } else if (isAsciiAlpha(peek(1)) && isQuote(peek(2))) {
+            const auto c1 = peek(1) | 0x20;
+            if ((c == 'f' && c1 == 'r') || (c == 'r' && c1 == 'f')) {
+                prefix_len = 2;
+            } else if ((c == 'b' && c1 == 'r') || (c == 'r' && c1 == 'b')) {
+                prefix_len = 2;
+                is_bytes = true;
+            }
+        }
+
+        if (prefix_len > 0) {
+            const auto length = stringLength(prefix_len, is_bytes);
+            if (length > 0) {
+                push(Python3Parser::STRING, pos_, prefix_len + length);
+                skipString(prefix_len + length);
+                return;
+            }
+            // not a valid literal, so the prefix is lexed as NAME
+        }
+    }
+
+    auto end = pos_ + 1;
+    while (end < size_ && isIdentContinue(static_cast<unsigned char>(data_[end]))) {
+        end++;
+    }
+
+    push(keywordType(data_ + pos_, end - pos_), pos_, end - pos_);
+    pos_ = end;
+}
+
+size_t NativeLexer::stringLength(size_t prefix_len, bool is_bytes) const {
+    const auto quote_pos = pos_ + prefix_len;
+    const auto quote = data_[quote_pos];
+    const auto at = [this](size_t i) -> int32_t {
+        return i < size_ ? static_cast<unsigned char>(data_[i]) : -1;
+    };
+
+    if (at(quote_pos + 1) == quote && at(quote_pos + 2) == quote) {
+        // LONG_STRING, ends at the first unescaped triple quote
+        auto i = quote_pos + 3;
+        while (i < size_) {
+            const auto ch = at(i);
+            if (is_bytes && ch >= 0x80) {
+                break;
+            }
+            if (ch == '\\') {
+                if (i + 1 >= size_ || (is_bytes && at(i + 1) >= 0x80)) {
+                    break;
+                }
+                i += (at(i + 1) == '\r' && at(i + 2) == '\n') ? 3 : 2;
+                continue;
+            }
+            if (ch == quote && at(i + 1) == quote && at(i + 2) == quote) {
+                return i + 3 - quote_pos;
+            }
+            i++;
+        }
+
+        // unterminated, but the first two quotes still make up an empty string
+        return 2;
+    }
+
+    auto i = quote_pos + 1;
+    while (i < size_) {
+        const auto ch = at(i);
+        if (ch == quote) {
+            return i + 1 - quote_pos;
+        }
+        if (ch == '\\') {
+            if (i + 1 >= size_ || (is_bytes && at(i + 1) >= 0x80)) {
+                return 0;
+            }
+            i += (at(i + 1) == '\r' && at(i + 2) == '\n') ? 3 : 2;
+            continue;
+        }
+        if (isNewline(ch) || (is_bytes && ch >= 0x80)) {
+            return 0;
+        }
+        i++;
+    }
+
+    return 0;
+}
+
+// Picks the longest match among INTEGER, FLOAT_NUMBER and IMAG_NUMBER, just like the ANTLR lexer does.
+void NativeLexer::scanNumber() {
+    const auto start = pos_;
+    const auto at = [this](size_t i) -> int32_t {
+        return i < size_ ? static_cast<unsigned char>(data_[i]) : -1;
+    };
+    const auto skip = [&at](size_t i, bool (*pred)(int32_t)) {
+        while (pred(at(i))) {
+            i++;
+        }
+        return i;
+    };
+
+    size_t length = 0;
+
+    // OCT_INTEGER, HEX_INTEGER, BIN_INTEGER
+    if (at(start) == '0') {
+        const auto prefix = at(start + 1) | 0x20;
+        bool (*pred)(int32_t) = nullptr;
+        if (prefix == 'x') {
+            pred = isHexDigit;
+        } else if (prefix == 'o') {
+            pred = isOctDigit;
+        } else if (prefix == 'b') {
+            pred = isBinDigit;
+        }
+
+        if (pred) {
+            const auto end = skip(start + 2, pred);
+            if (end > start + 2) {
+                length = end - start;
+            }
+        }
+    }
+
+    // DECIMAL_INTEGER: NON_ZERO_DIGIT DIGIT* | '0'+
+    const auto int_end = skip(start, isDigit);
+    const auto int_len = int_end - start;
+    if (int_len > 0) {
+        if (at(start) != '0') {
+            length = std::max(length, int_len);
+        } else {
+            length = std::max(length, skip(start, [](int32_t c) { return c == '0'; }) - start);
+        }
+    }
+
+    // POINT_FLOAT: INT_PART? FRACTION | INT_PART '.'
+    size_t point_len = 0;
+    if (at(int_end) == '.') {
+        const auto fraction_end = skip(int_end + 1, isDigit);
+        if (fraction_end > int_end + 1) {
+            point_len = fraction_end - start;
+        } else if (int_len > 0) {
+            point_len = int_end + 1 - start;
+        }
+    }
+
+    // EXPONENT_FLOAT: (INT_PART | POINT_FLOAT) EXPONENT
+    const auto exponent_end = [&at, &skip](size_t i) -> size_t {
+        if ((at(i) | 0x20) != 'e') {
+            return 0;
+        }
+        i++;
+        if (at(i) == '+' || at(i) == '-') {
+            i++;
+        }
+        const auto end = skip(i, isDigit);
+        return end > i ? end : 0;
+    };
+
+    auto float_len = point_len;
+    if (int_len > 0) {
+        if (const auto end = exponent_end(int_end)) {
+            float_len = std::max(float_len, end - start);
+        }
+    }
+    if (point_len > 0) {
+        if (const auto end = exponent_end(start + point_len)) {
+            float_len = std::max(float_len, end - start);
+        }
+    }
+    length = std::max(length, float_len);
+
+    // IMAG_NUMBER: (FLOAT_NUMBER | INT_PART) [jJ]
+    if (float_len > 0 && (at(start + float_len) | 0x20) == 'j') {
+        length = std::max(length, float_len + 1);
+    }
+    if (int_len > 0 && (at(start + int_len) | 0x20) == 'j') {
+        length = std::max(length, int_len + 1);
+    }
+
+    push(Python3Parser::NUMBER, start, length);
+    pos_ += length;
+}
+
+void NativeLexer::scanOperator() {
+    const auto c = peek(0);
+    const auto c1 = peek(1);
+    const auto c2 = peek(2);
+
+    size_t type = Python3Parser::UNKNOWN_CHAR;
+    size_t length = 1;
+
+    switch (c) {
+        case '.':
+            if (c1 == '.' && c2 == '.') {
+                type = Python3Parser::ELLIPSIS;
+                length = 3;
+            } else {
+                type = Python3Parser::DOT;
+            }
+            break;
+        case '*':
+            if (c1 == '*') {
+                type = c2 == '=' ? Python3Parser::POWER_ASSIGN : Python3Parser::POWER;
+                length = c2 == '=' ? 3 : 2;
+            } else if (c1 == '=') {
+                type = Python3Parser::MULT_ASSIGN;
+                length = 2;
+            } else {
+                type = Python3Parser::STAR;
+            }
+            break;
+        case '(':
+            type = Python3Parser::OPEN_PAREN;
+            opened_++;
+            break;
+        case ')':
+            type = Python3Parser::CLOSE_PAREN;
+            opened_--;
+            break;
+        case '[':
+            type = Python3Parser::OPEN_BRACK;
+            opened_++;
+            break;
+        case ']':
+            type = Python3Parser::CLOSE_BRACK;
+            opened_--;
+            break;
+        case '{':
+            type = Python3Parser::OPEN_BRACE;
+            opened_++;
+            break;
+        case '}':
+            type = Python3Parser::CLOSE_BRACE;
+            opened_--;
+            break;
+        case ',':
+            type = Python3Parser::COMMA;
+            break;
+        case ':':
+            type = Python3Parser::COLON;
+            break;
+        case ';':
+            type = Python3Parser::SEMI_COLON;
+            break;
+        case '~':
+            type = Python3Parser::NOT_OP;
+            break;
+        case '=':
+            if (c1 == '=') {
+                type = Python3Parser::EQUALS;
+                length = 2;
+            } else {
+                type = Python3Parser::ASSIGN;
+            }
+            break;
+        case '!':
+            if (c1 == '=') {
+                type = Python3Parser::NOT_EQ_2;
+                length = 2;
+            }
+            break;
+        case '|':
+            if (c1 == '=') {
+                type = Python3Parser::OR_ASSIGN;
+                length = 2;
+            } else {
+                type = Python3Parser::OR_OP;
+            }
+            break;
+        case '^':
+            if (c1 == '=') {
+                type = Python3Parser::XOR_ASSIGN;
+                length = 2;
+            } else {
+                type = Python3Parser::XOR;
+            }
+            break;
+        case '&':
+            if (c1 == '=') {
+                type = Python3Parser::AND_ASSIGN;
+                length = 2;
+            } else {
+                type = Python3Parser::AND_OP;
+            }
+            break;
+        case '+':
+            if (c1 == '=') {
+                type = Python3Parser::ADD_ASSIGN;
+                length = 2;
+            } else {
+                type = Python3Parser::ADD;
+            }
+            break;
+        case '-':
+            if (c1 == '=') {
+                type = Python3Parser::SUB_ASSIGN;
+                length = 2;
+            } else if (c1 == '>') {
+                type = Python3Parser::ARROW;
+                length = 2;
+            } else {
+                type = Python3Parser::MINUS;
+            }
+            break;
+        case '%':
+            if (c1 == '=') {
+                type = Python3Parser::MOD_ASSIGN;
+                length = 2;
+            } else {
+                type = Python3Parser::MOD;
+            }
+            break;
+        case '@':
+            if (c1 == '=') {
+                type = Python3Parser::AT_ASSIGN;
+                length = 2;
+            } else {
+                type = Python3Parser::AT;
+            }
+            break;
+        case '/':
+            if (c1 == '/') {
+                type = c2 == '=' ? Python3Parser::IDIV_ASSIGN : Python3Parser::IDIV;
+                length = c2 == '=' ? 3 : 2;
+            } else if (c1 == '=') {
+                type = Python3Parser::DIV_ASSIGN;
+                length = 2;
+            } else {
+                type = Python3Parser::DIV;
+            }
+            break;
+        case '<':
+            if (c1 == '<') {
+                type = c2 == '=' ? Python3Parser::LEFT_SHIFT_ASSIGN : Python3Parser::LEFT_SHIFT;
+                length = c2 == '=' ? 3 : 2;
+            } else if (c1 == '=') {
+                type = Python3Parser::LT_EQ;
+                length = 2;
+            } else if (c1 == '>') {
+                type = Python3Parser::NOT_EQ_1;
+                length = 2;
+            } else {
+                type = Python3Parser::LESS_THAN;
+            }
+            break;
+        case '>':
+            if (c1 == '>') {
+                type = c2 == '=' ? Python3Parser::RIGHT_SHIFT_ASSIGN : Python3Parser::RIGHT_SHIFT;
+                length = c2 == '=' ? 3 : 2;
+            } else if (c1 == '=') {
+                type = Python3Parser::GT_EQ;
+                length = 2;
+            } else {
+                type = Python3Parser::GREATER_THAN;
+            }
+            break;
+        default:
+            break;
+    }
+
+    push(type, pos_, length);
+    pos_ += length;
+}
+
+namespace {
+    // chunks smaller than that aren't worth a thread
+    constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+    // Returns the first position at or after from where a line starts with a name or a decorator
+    // right at column 0, size if there's none. Unless it's inside a string or brackets (or the previous
+    // line ends with a backslash), that's the start of a top-level statement, a safe point to split at.
+    size_t findChunkStart(const char *data, size_t size, size_t from) {
+        for (auto pos = from; pos < size; ++pos) {
+            const auto newline = static_cast<const char *>(memchr(data + pos, '\n', size - pos));
+            if (!newline) {
+                break;
+            }
+
+            pos = newline - data + 1;
+            if (pos < size && (isIdentStart(static_cast<unsigned char>(data[pos])) || data[pos] == '@')) {
+                return pos;
+            }
+        }
+
+        return size;
+    }
+
+    std::vector<LexedToken> lexChunk(const char *data, size_t size, size_t begin, size_t limit, uint32_t line,
+                                     bool &is_balanced) {
+        std::vector<LexedToken> tokens;
+        tokens.reserve((limit - begin) / 4);
+
+        NativeLexer lexer(data, size, begin, limit, line);
+        LexedToken tok{};
+        while (lexer.next(tok)) {
+            tokens.push_back(tok);
+        }
+        is_balanced = lexer.isBalanced();
+
+        return tokens;
+    }
+
+    // Appends the tokens of the chunk to tokens, replacing its INDENTATION tokens by INDENT/DEDENT tokens just like
+    // NativeLexer::pushIndentation does, indents being the indentation stack. The first num_of_outer levels of the
+    // stack are the ones of the blocks the chunk is nested in: its last INDENTATION (and EOF) don't close them,
+    // and if any other one does, the chunk isn't nested in them after all and false is returned.
+    bool resolveIndentation(const char *data, const std::vector<LexedToken> &chunk, std::vector<int32_t> &indents,
+                            const size_t num_of_outer, std::vector<LexedToken> &tokens) {
+        // whether the last INDENTATION would've closed all of the outer blocks too
+        bool closes_outer = false;
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            const auto &tok = chunk[i];
+            if (tok.type == NativeLexer::INDENTATION) {
+                const auto indent = indentWidth(data, tok.start, tok.start + tok.length);
+                const auto previous = indents.empty() ? 0 : indents.back();
+                const auto is_last = i + 1 == chunk.size() || chunk[i + 1].type == Python3Parser::EOF;
+                if (indent > previous) {
+                    indents.push_back(indent);
+                    tokens.push_back({Python3Parser::INDENT, tok.start, tok.length, tok.line, tok.col});
+                } else {
+                    while (!indents.empty() && indents.back() > indent) {
+                        if (indents.size() == num_of_outer) {
+                            if (!is_last) {
+                                return false;
+                            }
+                            closes_outer = indents.front() > indent;
+                            break;
+                        }
+                        tokens.push_back({Python3Parser::DEDENT, tok.start + tok.length, 0, tok.line,
+                                          tok.col + tok.length});
+                        indents.pop_back();
+                    }
+                }
+                continue;
+            }
+
+            if (tok.type == Python3Parser::EOF && !indents.empty() && !closes_outer) {
+                tokens.push_back({Python3Parser::NEWLINE, tok.start, 0, tok.line, tok.col});
+                while (indents.size() > num_of_outer) {
+                    tokens.push_back({Python3Parser::DEDENT, tok.start, 0, tok.line, tok.col});
+                    indents.pop_back();
+                }
+            }
+            tokens.push_back(tok);
+        }
+
+        return true;
+    }
+}
+
+// The source is split at the starts of the lines beginning with a name or '@' at column 0, and each chunk
+// is lexed on its own thread in the chunk mode, which leaves the indentation unresolved. Whether a split point
+// really was the start of a logical line gets known only once the chunk before it is lexed: the chunk has to stop
+// exactly there, outside of any brackets, with its last token being the INDENTATION after a NEWLINE. Starting
+// with the first chunk that doesn't, the rest of the source is lexed again serially. The INDENTATION tokens
+// are then replaced by INDENT/DEDENT tokens just like NativeLexer::pushIndentation does, in a single pass
+// over all of the chunks.
+std::vector<LexedToken> lexParallel(const char *data, size_t size, uint32_t num_of_threads) {
+    const auto num_of_chunks = std::max<size_t>(1, std::min<size_t>(num_of_threads, size / MIN_CHUNK_SIZE));
+
+    std::vector<size_t> starts{0};
+    std::vector<uint32_t> lines{1};
+    for (size_t i = 1; i < num_of_chunks; ++i) {
+        const auto start = findChunkStart(data, size, std::max(i * (size / num_of_chunks), starts.back() + 1));
+        if (start >= size) {
+            break;
+        }
+
+        lines.push_back(lines.back() + std::count(data + starts.back(), data + start, '\n'));
+        starts.push_back(start);
+    }
+    starts.push_back(size);
+
+    std::vector<std::vector<LexedToken>> chunks(lines.size());
+    // not a vector<bool>, the threads write to their elements concurrently
+    std::vector<uint8_t> balanced(lines.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        threads.emplace_back([&, i] {
+            bool is_balanced;
+            chunks[i] = lexChunk(data, size, starts[i], starts[i + 1], lines[i], is_balanced);
+            balanced[i] = is_balanced;
+        });
+    }
+    bool is_balanced;
+    chunks[0] = lexChunk(data, size, starts[0], starts[1], lines[0], is_balanced);
+    balanced[0] = is_balanced;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i + 1 < chunks.size(); ++i) {
+        const auto &chunk = chunks[i];
+        const auto num_of_chunk_tokens = chunk.size();
+        const auto ends_at_split = balanced[i] &&
+                                   num_of_chunk_tokens >= 2 &&
+                                   chunk[num_of_chunk_tokens - 2].type == Python3Parser::NEWLINE &&
+                                   chunk.back().type == NativeLexer::INDENTATION &&
+                                   chunk.back().start + chunk.back().length == starts[i + 1] &&
+                                   chunk.back().line == lines[i + 1];
+        if (!ends_at_split) {
+            chunks.resize(i + 1);
+            chunks[i] = lexChunk(data, size, starts[i], size, lines[i], is_balanced);
+            break;
+        }
+    }
+
+    size_t num_of_tokens = 0;
+    for (const auto &chunk : chunks) {
+        num_of_tokens += chunk.size();
+    }
+
+    std::vector<LexedToken> tokens;
+    tokens.reserve(num_of_tokens);
+    std::vector<int32_t> indents;
+    for (const auto &chunk : chunks) {
+        resolveIndentation(data, chunk, indents, 0, tokens);
+    }
+
+    return tokens;
+}
+
+bool lexRegion(const char *data, size_t size, size_t begin, size_t limit, uint32_t line,
+               const std::vector<int32_t> &indents, std::vector<LexedToken> &tokens, size_t &unsplittable) {
+    bool is_balanced;
+    const auto chunk = lexChunk(data, size, begin, limit, line, is_balanced);
+    if (limit < size) {
+        const auto num_of_chunk_tokens = chunk.size();
+        const auto ends_at_limit = is_balanced &&
+                                   num_of_chunk_tokens >= 2 &&
+                                   chunk[num_of_chunk_tokens - 2].type == Python3Parser::NEWLINE &&
+                                   chunk.back().type == NativeLexer::INDENTATION &&
+                                   chunk.back().start == limit;
+        if (!ends_at_limit) {
+            return false;
+        }
+    }
+
+    tokens.clear();
+    tokens.reserve(chunk.size() + 1);
+    auto region_indents = indents;
+    if (!resolveIndentation(data, chunk, region_indents, indents.size(), tokens)) {
+        return false;
+    }
+    if (limit < size) {
+        tokens.push_back({Python3Parser::EOF, static_cast<uint32_t>(limit), 0, chunk.back().line, 0});
+    }
+
+    unsplittable = size;
+    int32_t opened = 0;
+    for (const auto &tok : tokens) {
+        const auto end = tok.start + tok.length;
+        if (tok.type == Python3Parser::OPEN_PAREN ||
+            tok.type == Python3Parser::OPEN_BRACK ||
+            tok.type == Python3Parser::OPEN_BRACE) {
+            opened++;
+        } else if (tok.type == Python3Parser::CLOSE_PAREN ||
+                   tok.type == Python3Parser::CLOSE_BRACK ||
+                   tok.type == Python3Parser::CLOSE_BRACE) {
+            if (--opened < 0) {
+                unsplittable = tok.start;
+                break;
+            }
+        } else if (tok.type == Python3Parser::UNKNOWN_CHAR && (data[tok.start] == '\'' || data[tok.start] == '"')) {
+            // a short string with no end
+            unsplittable = tok.start;
+            break;
+        } else if (tok.type == Python3Parser::STRING && tok.length >= 2 && end < size &&
+                   data[end] == data[end - 1] && data[end - 1] == data[end - 2]) {
+            // the empty string the first two quotes of a long string with no end make up
+            unsplittable = tok.start;
+            break;
+        }
+    }
+    if (limit < size && unsplittable < size) {
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Python3Lexer.h"
+#include "symbols.hpp"
+
+// Selects which lexer feeds PyLexer. NATIVE is the hand-written lexer below,
+// ANTLR is the generated Python3Lexer (kept around for benchmarking and for
+// checking that both of them produce the same token stream).
+enum class LexerKind : uint8_t {
+    ANTLR = 0,
+    NATIVE,
+};
+
+// How many tokens PyLexer holds. FULL tokenizes the whole source up front; STREAM lexes tokens
+// on demand as the parser advances, keeping only a fixed window of them (native lexer only).
+enum class TokenBuffering : uint8_t {
+    FULL = 0,
+    STREAM,
+};
+
+// A token as produced by NativeLexer. Its text is never copied, instead
+// it's described by the byte range [start, start + length) of the source.
+struct LexedToken {
+    size_t type;
+    uint32_t start;
+    uint32_t length;
+    uint32_t line;
+    uint32_t col;
+};
+
+// Tokens of a source stored column-wise, so that the parser's type checks touch
+// nothing but the densely packed types array. The text of a token is the byte range
+// [start, start + length) of the source. Types are kept as int16_t: every token type
+// fits into it, and EOF (size_t(-1)) becomes -1, which sign-extends back to Python3Parser::EOF.
+//
+// The table either holds every token of the source (push), or serves as a ring buffer
+// keeping only the last few of them (initRing/store), token i being at slot i & mask.
+// NAME tokens are interned as they're lexed, the symbols of other tokens are NO_SYMBOL.
+//
+// Tokens are read through the *_column pointers. seal() points them at the vectors once those are
+// filled (or sized, for the ring buffer), map() at columns living elsewhere, i.e. in a mapped token cache.
+struct TokenTable {
+    std::vector<int16_t> types;
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> lengths;
+    std::vector<uint32_t> lines;
+    std::vector<Symbol> symbols;
+    uint32_t mask = UINT32_MAX;
+
+    const int16_t *type_column = nullptr;
+    const uint32_t *start_column = nullptr;
+    const uint32_t *length_column = nullptr;
+    const uint32_t *line_column = nullptr;
+    const Symbol *symbol_column = nullptr;
+    size_t num_of_tokens = 0;
+
+    inline void push(size_t type, uint32_t start, uint32_t length, uint32_t line, Symbol symbol) {
+        types.push_back(static_cast<int16_t>(type));
+        starts.push_back(start);
+        lengths.push_back(length);
+        lines.push_back(line);
+        symbols.push_back(symbol);
+    }
+
+    // capacity has to be a power of two
+    inline void initRing(uint32_t capacity) {
+        types.resize(capacity);
+        starts.resize(capacity);
+        lengths.resize(capacity);
+        lines.resize(capacity);
+        symbols.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    inline void store(uint32_t idx, size_t type, uint32_t start, uint32_t length, uint32_t line, Symbol symbol) {
+        const auto slot = idx & mask;
+        types[slot] = static_cast<int16_t>(type);
+        starts[slot] = start;
+        lengths[slot] = length;
+        lines[slot] = line;
+        symbols[slot] = symbol;
+    }
+
+    inline void reserve(size_t n) {
+        types.reserve(n);
+        starts.reserve(n);
+        lengths.reserve(n);
+        lines.reserve(n);
+        symbols.reserve(n);
+    }
+
+    inline void seal() {
+        map(types.data(), starts.data(), lengths.data(), lines.data(), symbols.data(), types.size());
+    }
+
+    inline void map(const int16_t *type_data, const uint32_t *start_data, const uint32_t *length_data,
+                    const uint32_t *line_data, const Symbol *symbol_data, size_t size) {
+        type_column = type_data;
+        start_column = start_data;
+        length_column = length_data;
+        line_column = line_data;
+        symbol_column = symbol_data;
+        num_of_tokens = size;
+    }
+
+    inline size_t size() const noexcept { return num_of_tokens; }
+};
+
+// A handle to a single token of a TokenTable. It's two words wide and is passed around by value,
+// the accessors are named after the ones of antlr4::Token the parser used to call.
+// A default-constructed TokenRef refers to no token at all and converts to false.
+class TokenRef {
+public:
+    TokenRef() = default;
+
+    TokenRef(const TokenTable *table, uint32_t idx) : table_(table), idx_(idx) {}
+
+    inline size_t getType() const noexcept {
+        return static_cast<size_t>(static_cast<ptrdiff_t>(table_->type_column[slot()]));
+    }
+
+    inline size_t getLine() const noexcept { return table_->line_column[slot()]; }
+
+    inline size_t getStartIndex() const noexcept { return table_->start_column[slot()]; }
+
+    inline size_t getLength() const noexcept { return table_->length_column[slot()]; }
+
+    inline Symbol getSymbol() const noexcept { return table_->symbol_column[slot()]; }
+
+    // the index of the last byte, one before the start for the tokens with no text
+    inline size_t getStopIndex() const noexcept { return getStartIndex() + getLength() - 1; }
+
+    inline uint32_t getTokenIndex() const noexcept { return idx_; }
+
+    inline explicit operator bool() const noexcept { return table_ != nullptr; }
+
+private:
+    inline uint32_t slot() const noexcept { return idx_ & table_->mask; }
+
+    const TokenTable *table_ = nullptr;
+    uint32_t idx_ = 0;
+};
+
+// The width of the indentation [spaces_start, spaces_end), tabs are replaced by 1 to 8 spaces to reach a multiple of 8
+int32_t indentWidth(const char *data, size_t spaces_start, size_t spaces_end);
+
+// Direct-coded lexer working on raw UTF-8 bytes. It emits exactly the same token types
+// the ANTLR lexer does (see @lexer::members in grammar/Python3.g4), including the
+// synthesized NEWLINE, INDENT and DEDENT tokens.
+//
+// Deviations from the grammar: any non-ASCII code point is accepted as a part of NAME
+// rather than only the ones listed in ID_START/ID_CONTINUE.
+class NativeLexer {
+public:
+    NativeLexer(const char *data, size_t size);
+
+    // Lexes the chunk [begin, limit) of the source only, begin being the start of the given line
+    // outside of any brackets or strings. The indentation of each logical line is not turned into
+    // INDENT/DEDENT tokens, since the indentation stack is unknown in the middle of the source.
+    // An INDENTATION token spanning the leading whitespace is emitted after every NEWLINE instead.
+    NativeLexer(const char *data, size_t size, size_t begin, size_t limit, uint32_t line);
+
+    // Stores the next token in tok. Returns false once EOF has already been handed out
+    // (or the end of the chunk has been reached).
+    bool next(LexedToken &tok);
+
+    // whether the brackets opened so far are all closed, and no more than those (an extra closing one goes
+    // unnoticed until the parser gets to it, but it changes how the rest of the source is lexed)
+    inline bool isBalanced() const noexcept { return opened_ == 0; }
+
+    // the type of the tokens standing in for INDENT/DEDENT in the chunk mode
+    static constexpr size_t INDENTATION = Python3Parser::DEDENT + 1;
+
+private:
+    // scans the input until at least one token is pending or EOF is reached
+    void scan();
+
+    void scanNewline();
+
+    void scanName();
+
+    void scanNumber();
+
+    void scanOperator();
+
+    // returns the length of a string literal starting at pos_ + prefix_len, 0 if there's none
+    size_t stringLength(size_t prefix_len, bool is_bytes) const;
+
+    // advances past a string literal of the given length, keeping track of the line numbers
+    void skipString(size_t length);
+
+    void push(size_t type, size_t start, size_t length);
+
+    void pushIndentation(size_t spaces_start, size_t spaces_end);
+
+    inline int32_t peek(size_t offset) const noexcept {
+        return pos_ + offset < size_ ? static_cast<unsigned char>(data_[pos_ + offset]) : -1;
+    }
+
+    const char *data_;
+    size_t size_;
+    // the end of the chunk being lexed, size_ unless in the chunk mode
+    size_t limit_;
+    bool defer_indentation_ = false;
+    size_t pos_ = 0;
+    uint32_t line_ = 1;
+    size_t line_start_ = 0;
+    // the amount of opened braces, brackets and parenthesis
+    int32_t opened_ = 0;
+    bool done_ = false;
+    std::vector<int32_t> indents_;
+    // tokens scanned but not handed out yet, consumed from pending_head_
+    std::vector<LexedToken> pending_;
+    size_t pending_head_ = 0;
+};
+
+// Lexes the source with up to num_of_threads NativeLexers working on separate chunks and returns
+// exactly the tokens a single NativeLexer would (see lexer.cpp for how the chunks are picked and joined)
+std::vector<LexedToken> lexParallel(const char *data, size_t size, uint32_t num_of_threads);
+
+// Lexes the part [begin, limit) of the source on its own and stores its tokens ending with EOF into tokens. begin has
+// to be the start of a line that starts a statement of a block (or 0), indents being the indentation stack there
+// (empty at the top level). Returns false unless limit is the start of such a line too (or the end of the source),
+// with no line in between indented less than the block. The tokens are then exactly the ones a NativeLexer produces
+// for [begin, limit) of the whole source, except for the DEDENTs closing the block and the ones it's nested in.
+// A closing bracket without an opening one, or a quote that doesn't start a string (scanned for its end up to the
+// end of the source), make the way the rest of the source is lexed depend on what's before them and the other way
+// around. unsplittable is set to the start of the first of those in the part (size if there's none), and unless
+// limit is the end of the source, false is returned if there's one.
+bool lexRegion(const char *data, size_t size, size_t begin, size_t limit, uint32_t line,
+               const std::vector<int32_t> &indents, std::vector<LexedToken> &tokens, size_t &unsplittable);
@@ -0,0 +1,314 @@
+#include "literals.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <string>
+
+namespace {
+    inline bool isImaginary(const std::string_view text) {
+        return text.back() == 'j' || text.back() == 'J';
+    }
+
+    inline bool isFloat(const std::string_view text) {
+        return text.find_first_of(".eE") != std::string_view::npos;
+    }
+
+    inline uint32_t digitValue(const char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+
+        return (c | 0x20) - 'a' + 10;
+    }
+
+    // limbs = limbs * base + digit, for every digit
+    ArenaVector<uint32_t> toLimbs(const std::string_view digits, const uint32_t base) {
+        ArenaVector<uint32_t> limbs;
+        for (const auto c: digits) {
+            uint64_t carry = digitValue(c);
+            for (auto &limb: limbs) {
+                const auto value = static_cast<uint64_t>(limb) * base + carry;
+                limb = static_cast<uint32_t>(value);
+                carry = value >> 32;
+            }
+            if (carry) {
+                limbs.push_back(static_cast<uint32_t>(carry));
+            }
+        }
+
+        return limbs;
+    }
+
+    struct StringPiece {
+        // the text between the quotes
+        std::string_view contents;
+        bool is_raw;
+        bool is_bytes;
+    };
+
+    StringPiece splitString(const std::string_view text) {
+        StringPiece piece = {};
+        size_t quote_pos = 0;
+        while (quote_pos < text.size() && text[quote_pos] != '\'' && text[quote_pos] != '"') {
+            const auto prefix = text[quote_pos] | 0x20;
+            piece.is_raw |= prefix == 'r';
+            piece.is_bytes |= prefix == 'b';
+            quote_pos++;
+        }
+
+        const auto rest = text.substr(quote_pos);
+        const size_t quote_len = rest.size() >= 6 && rest[0] == rest[1] && rest[1] == rest[2] ? 3 : 1;
+        if (rest.size() >= 2 * quote_len) {
+            piece.contents = rest.substr(quote_len, rest.size() - 2 * quote_len);
+        }
+
+        return piece;
+    }
+
+    // writes the code point as UTF-8, returns the amount of bytes it takes
+    size_t putUtf8(uint32_t code_point, char *out) {
+        char buf[4];
+        size_t n;
+        if (code_point < 0x80) {
+            buf[0] = static_cast<char>(code_point);
+            n = 1;
+        } else if (code_point < 0x800) {
+            buf[0] = static_cast<char>(0xC0 | (code_point >> 6));
+            buf[1] = static_cast<char>(0x80 | (code_point & 0x3F));
+            n = 2;
+        } else if (code_point < 0x10000) {
+            buf[0] = static_cast<char>(0xE0 | (code_point >> 12));
+            buf[1] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            buf[2] = static_cast<char>(0x80 | (code_point & 0x3F));
+            n = 3;
+        } else {
+            buf[0] = static_cast<char>(0xF0 | ((code_point >> 18) & 0x07));
+            buf[1] = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+            buf[2] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            buf[3] = static_cast<char>(0x80 | (code_point & 0x3F));
+            n = 4;
+        }
+        if (out) {
+            std::copy(buf, buf + n, out);
+        }
+
+        return n;
+    }
+
+    // reads up to max_digits digits of the given base starting at pos
+    uint32_t readDigits(const std::string_view s, size_t &pos, const size_t max_digits, const uint32_t base) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < max_digits && pos < s.size(); ++i, ++pos) {
+            const auto c = s[pos];
+            const auto is_digit = base == 8 ? c >= '0' && c <= '7' : std::isxdigit(static_cast<unsigned char>(c));
+            if (!is_digit) {
+                break;
+            }
+            value = value * base + digitValue(c);
+        }
+
+        return value;
+    }
+
+    // Resolves the escapes of the piece and writes the result to out, unless it's null.
+    // Returns the length of the decoded piece either way.
+    size_t decodePiece(const StringPiece &piece, char *out) {
+        const auto s = piece.contents;
+        if (piece.is_raw) {
+            if (out) {
+                std::copy(s.begin(), s.end(), out);
+            }
+            return s.size();
+        }
+
+        size_t n = 0;
+        const auto put = [&](const char c) {
+            if (out) {
+                out[n] = c;
+            }
+            n++;
+        };
+
+        size_t pos = 0;
+        while (pos < s.size()) {
+            const auto c = s[pos++];
+            if (c != '\\' || pos == s.size()) {
+                put(c);
+                continue;
+            }
+
+            const auto e = s[pos++];
+            switch (e) {
+                case '\n':
+                    // line continuation
+                    break;
+                case '\r':
+                    if (pos < s.size() && s[pos] == '\n') {
+                        pos++;
+                    }
+                    break;
+                case '\\':
+                case '\'':
+                case '"':
+                    put(e);
+                    break;
+                case 'a':
+                    put('\a');
+                    break;
+                case 'b':
+                    put('\b');
+                    break;
+                case 'f':
+                    put('\f');
+                    break;
+                case 'n':
+                    put('\n');
+                    break;
+                case 'r':
+                    put('\r');
+                    break;
+                case 't':
+                    put('\t');
+                    break;
+                case 'v':
+                    put('\v');
+                    break;
+                case '0':
+                case '1':
+                case '2':
+                case '3':
+                case '4':
+                case '5':
+                case '6':
+                case '7':
+                case 'x': {
+                    const auto is_hex = e == 'x';
+                    if (!is_hex) {
+                        pos--;
+                    }
+                    const auto value = readDigits(s, pos, is_hex ? 2 : 3, is_hex ? 16 : 8);
+                    if (piece.is_bytes) {
+                        put(static_cast<char>(value));
+                    } else {
+                        n += putUtf8(value, out ? out + n : nullptr);
+                    }
+                    break;
+                }
+                case 'u':
+                case 'U':
+                    if (!piece.is_bytes) {
+                        const auto value = readDigits(s, pos, e == 'u' ? 4 : 8, 16);
+                        n += putUtf8(value, out ? out + n : nullptr);
+                        break;
+                    }
+                    // no such escapes in bytes
+                    [[fallthrough]];
+                default:
+                    // unknown escapes are kept as they are
+                    put('\\');
+                    put(e);
+                    break;
+            }
+        }
+
+        return n;
+    }
+
+    double toDouble(const std::string_view text) {
+        double value = 0;
+        const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec == std::errc::result_out_of_range) {
+            // from_chars leaves the value as is, whereas Python rounds to inf or zero (i.e. 1e400)
+            return std::strtod(std::string(text).c_str(), nullptr);
+        }
+
+        return value;
+    }
+}
+
+Number decodeNumber(std::string_view text) {
+    Number number;
+
+    if (isImaginary(text)) {
+        number.kind = NumberKind::COMPLEX;
+        number.float_value = toDouble(text.substr(0, text.size() - 1));
+        return number;
+    }
+
+    uint32_t base = 10;
+    if (text.size() > 1 && text[0] == '0') {
+        switch (text[1] | 0x20) {
+            case 'x':
+                base = 16;
+                break;
+            case 'o':
+                base = 8;
+                break;
+            case 'b':
+                base = 2;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (base == 10 && isFloat(text)) {
+        number.kind = NumberKind::FLOAT;
+        number.float_value = toDouble(text);
+        return number;
+    }
+
+    const auto digits = base == 10 ? text : text.substr(2);
+    const auto result = std::from_chars(digits.data(), digits.data() + digits.size(), number.int_value, base);
+    if (result.ec == std::errc::result_out_of_range) {
+        number.kind = NumberKind::BIGINT;
+        number.int_value = 0;
+        number.limbs = toLimbs(digits, base);
+    }
+
+    return number;
+}
+
+LiteralId LiteralPool::finish() {
+    // values which need no decoding are referred to right in the source
+    if (pieces_.size() == 1) {
+        const auto piece = splitString(pieces_[0]);
+        if (piece.is_raw || piece.contents.find('\\') == std::string_view::npos) {
+            pieces_.clear();
+            return intern(piece.contents, piece.is_bytes);
+        }
+    }
+
+    size_t length = 0;
+    bool is_bytes = false;
+    for (const auto text: pieces_) {
+        const auto piece = splitString(text);
+        length += decodePiece(piece, nullptr);
+        is_bytes |= piece.is_bytes;
+    }
+
+    std::string value(length, '\0');
+    size_t offset = 0;
+    for (const auto text: pieces_) {
+        offset += decodePiece(splitString(text), &value[offset]);
+    }
+    pieces_.clear();
+
+    const auto it = ids_[is_bytes].find(value);
+    if (it != ids_[is_bytes].end()) {
+        return it->second;
+    }
+
+    return intern(storage_.emplace_back(std::move(value)), is_bytes);
+}
+
+LiteralId LiteralPool::intern(std::string_view value, bool is_bytes) {
+    const auto [it, inserted] = ids_[is_bytes].try_emplace(value, static_cast<LiteralId>(entries_.size()));
+    if (inserted) {
+        entries_.push_back({value, is_bytes});
+    }
+
+    return it->second;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.hpp"
+
+enum class NumberKind : uint8_t {
+    INT = 0,
+    // an integer that doesn't fit into int64_t
+    BIGINT,
+    FLOAT,
+    // an imaginary literal, i.e. 3j, the real part is always zero
+    COMPLEX,
+};
+
+// Value of a NUMBER token, decoded once by the parser so that nobody has to look at its text again
+struct Number {
+    NumberKind kind = NumberKind::INT;
+    int64_t int_value = 0;
+    // the value of FLOAT, the imaginary part of COMPLEX
+    double float_value = 0;
+    // magnitude of BIGINT in base 2^32, the least significant limb first, in the arena of the tree of the NUMBER
+    // (if decoded in an ArenaScope)
+    ArenaVector<uint32_t> limbs;
+};
+
+// Decodes the text of a NUMBER token (decimal, hex, octal and binary integers, floats, imaginary numbers)
+Number decodeNumber(std::string_view text);
+
+// Index of a decoded string literal in a LiteralPool
+using LiteralId = uint32_t;
+
+constexpr LiteralId NO_LITERAL = UINT32_MAX;
+
+// Decoded values of the STRING tokens of a source. Prefixes and quotes are stripped and escapes
+// are resolved (except for \N{...}, which is kept as is). Adjacent literals are concatenated into
+// a single value, allocated once with the exact size. Values that didn't need any decoding are
+// views into the source, every distinct value is stored only once.
+class LiteralPool {
+public:
+    // Adds the text of a STRING token to the literal being built
+    inline void append(std::string_view token_text) { pieces_.push_back(token_text); }
+
+    // Decodes the pieces appended so far into a single literal and returns its id
+    LiteralId finish();
+
+    inline std::string_view value(LiteralId id) const noexcept { return entries_[id].value; }
+
+    inline bool isBytes(LiteralId id) const noexcept { return entries_[id].is_bytes; }
+
+    inline size_t size() const noexcept { return entries_.size(); }
+
+private:
+    struct Entry {
+        std::string_view value;
+        bool is_bytes;
+    };
+
+    LiteralId intern(std::string_view value, bool is_bytes);
+
+    std::vector<std::string_view> pieces_;
+    std::vector<Entry> entries_;
+    // str and bytes literals with the same contents are different constants
+    std::unordered_map<std::string_view, LiteralId> ids_[2];
+    std::deque<std::string> storage_;
+};
@@ -1,41 +1,630 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include <malloc.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "antlr_ast.hpp"
+#include "driver.hpp"
+#include "flat_ast.hpp"
+#include "incremental.hpp"
+#include "interactive.hpp"
 #include "parser.hpp"
+#include "visitor.hpp"
+
+
+
+// NEWLINE, INDENT, DEDENT and EOF are synthesized by the lexers, hence only their types are compared
+std::string tokenToStr(const PyLexer &lexer, const TokenRef token) {
+    const auto type = token.getType();
+    if (type == Python3Parser::EOF) {
+        return "TokEOF";
+    }
+
+    const auto &name = tok_utils::tokTypeName(type);
+    if (type == Python3Parser::NEWLINE ||
+        type == Python3Parser::INDENT ||
+        type == Python3Parser::DEDENT) {
+        return name;
+    }
+
+    return std::to_string(token.getLine()) + " " + name + " " + std::string(lexer.text(token));
+}
+
+void dumpTokens(PyLexer &lexer) {
+    for (uint32_t i = 0; i < lexer.tokens().size(); ++i) {
+        puts(tokenToStr(lexer, lexer.token(i)).c_str());
+    }
+}
+
+// Lexes the file with both lexers and checks that the produced token streams are identical
+int compareLexers(const char *path) {
+    using clock = std::chrono::steady_clock;
+
+    const auto antlr_start = clock::now();
+    PyLexer antlr_lexer(path, {LexerKind::ANTLR});
+    const auto native_start = clock::now();
+    PyLexer native_lexer(path, {LexerKind::NATIVE});
+    const auto native_end = clock::now();
+
+    const auto &antlr_tokens = antlr_lexer.tokens();
+    const auto &native_tokens = native_lexer.tokens();
+    const auto num_of_tokens = std::min(antlr_tokens.size(), native_tokens.size());
+
+    int ret = 0;
+    for (size_t i = 0; i < num_of_tokens; ++i) {
+        const auto antlr_str = tokenToStr(antlr_lexer, antlr_lexer.token(i));
+        const auto native_str = tokenToStr(native_lexer, native_lexer.token(i));
+        if (antlr_str != native_str) {
+            fprintf(stderr, "%s: token %zu differs: antlr '%s', native '%s'\n", path, i, antlr_str.c_str(),
+                    native_str.c_str());
+            ret = 1;
+            break;
+        }
+    }
+
+    if (ret == 0 && antlr_tokens.size() != native_tokens.size()) {
+        fprintf(stderr, "%s: antlr produced %zu tokens, native %zu\n", path, antlr_tokens.size(),
+                native_tokens.size());
+        ret = 1;
+    }
+
+    const auto antlr_ms = std::chrono::duration<double, std::milli>(native_start - antlr_start).count();
+    const auto native_ms = std::chrono::duration<double, std::milli>(native_end - native_start).count();
+    printf("%s: %zu tokens, antlr %.3f ms, native %.3f ms, %s\n", path, native_tokens.size(), antlr_ms, native_ms,
+           ret == 0 ? "match" : "MISMATCH");
+
+    return ret;
+}
+
+// the bytes of the heap in use, what a front end holds on to is the growth of it while its structures are alive
+size_t heapInUse() {
+    return mallinfo2().uordblks;
+}
+
+// Parses every file with ANTLR (file_input() building the parse tree, which is then converted into the AST
+// of prss) and with prss, timing both and measuring the heap each one's structures take, and checks that the
+// trees are the same and that prss accepts nothing ANTLR rejects. The DFA ANTLR caches across the files counts
+// towards the heap of the first ones.
+int compareParsers(const std::vector<std::string> &paths, LexerOptions options) {
+    using clock = std::chrono::steady_clock;
+    // every body is needed for the comparison
+    options.lazy_bodies = false;
+
+    size_t num_of_matches = 0;
+    size_t num_of_mismatches = 0;
+    size_t num_of_antlr_failed = 0;
+    size_t num_of_prss_failed = 0;
+    // ANTLR rejecting what prss accepts is as much a divergence as a mismatch
+    size_t num_of_prss_accepted = 0;
+    size_t num_of_unloaded = 0;
+    double antlr_ms = 0;
+    double convert_ms = 0;
+    double prss_ms = 0;
+    size_t antlr_heap = 0;
+    size_t prss_heap = 0;
+    for (const auto &path : paths) {
+        const auto antlr_heap_start = heapInUse();
+        const auto antlr_start = clock::now();
+        opt<SourceBuffer> source;
+        try {
+            source.emplace(path.c_str());
+        } catch (const std::exception &e) {
+            // the file couldn't be loaded, the rest are compared all the same
+            printf("%s: not loaded\n", path.c_str());
+            fprintf(stderr, "%s: %s\n", path.c_str(), e.what());
+            num_of_unloaded++;
+            continue;
+        }
+        ANTLRInputStream input_stream(source->data(), source->size());
+        Python3Lexer py_lexer(&input_stream);
+        CommonTokenStream tokens(&py_lexer);
+        Python3Parser py_parser(&tokens);
+        // the errors are counted, not printed
+        py_lexer.removeErrorListeners();
+        py_parser.removeErrorListeners();
+        const auto tree = py_parser.file_input();
+        const auto convert_start = clock::now();
+        AntlrAstBuilder builder;
+        // the tree of a source with a syntax error is missing some of its parts
+        const auto is_antlr_failed = py_parser.getNumberOfSyntaxErrors() > 0;
+        const auto antlr_root = is_antlr_failed ? nullptr : builder.build(tree);
+        const auto antlr_end = clock::now();
+        const auto file_antlr_heap = heapInUse() - antlr_heap_start;
+
+        const auto prss_heap_start = heapInUse();
+        const auto prss_start = clock::now();
+        opt<PyLexer> lexer;
+        try {
+            lexer.emplace(path.c_str(), options);
+        } catch (const std::exception &e) {
+            printf("%s: not loaded\n", path.c_str());
+            fprintf(stderr, "%s: %s\n", path.c_str(), e.what());
+            num_of_unloaded++;
+            continue;
+        }
+        const auto result = parse(*lexer);
+        const auto prss_end = clock::now();
+        const auto file_prss_heap = heapInUse() - prss_heap_start;
+
+        const char *verdict;
+        std::string difference;
+        if (is_antlr_failed && result.errors.empty()) {
+            verdict = "ACCEPTED BY PRSS ONLY";
+            num_of_prss_accepted++;
+            difference = "antlr failed, prss parsed it";
+        } else if (is_antlr_failed) {
+            verdict = "antlr failed";
+            num_of_antlr_failed++;
+        } else if (!result.errors.empty()) {
+            verdict = "prss failed";
+            num_of_prss_failed++;
+            difference = std::to_string(result.errors[0].line) + ": " + result.errors[0].message;
+        } else if (astEqual(antlr_root, result.root, &difference)) {
+            verdict = "match";
+            num_of_matches++;
+        } else {
+            verdict = "MISMATCH";
+            num_of_mismatches++;
+        }
+
+        const auto file_antlr_ms = std::chrono::duration<double, std::milli>(convert_start - antlr_start).count();
+        const auto file_convert_ms = std::chrono::duration<double, std::milli>(antlr_end - convert_start).count();
+        const auto file_prss_ms = std::chrono::duration<double, std::milli>(prss_end - prss_start).count();
+        printf("%s: antlr %.3f ms (+%.3f ms to convert) %zu KiB, prss %.3f ms %zu KiB, %s\n", path.c_str(),
+               file_antlr_ms, file_convert_ms, file_antlr_heap / 1024, file_prss_ms, file_prss_heap / 1024, verdict);
+        if (!difference.empty()) {
+            fprintf(stderr, "%s: %s\n", path.c_str(), difference.c_str());
+        }
 
+        antlr_ms += file_antlr_ms;
+        convert_ms += file_convert_ms;
+        prss_ms += file_prss_ms;
+        antlr_heap = std::max(antlr_heap, file_antlr_heap);
+        prss_heap = std::max(prss_heap, file_prss_heap);
+    }
+
+    printf("%zu files: %zu match, %zu mismatch, %zu accepted by prss only, %zu failed by antlr, "
+           "%zu failed by prss only, %zu not loaded\n"
+           "antlr %.3f ms (+%.3f ms to convert), peak %zu KiB, prss %.3f ms, peak %zu KiB, prss is %.1fx faster\n",
+           paths.size(), num_of_matches, num_of_mismatches, num_of_prss_accepted, num_of_antlr_failed,
+           num_of_prss_failed, num_of_unloaded, antlr_ms, convert_ms, antlr_heap / 1024, prss_ms, prss_heap / 1024,
+           antlr_ms / std::max(prss_ms, 1e-9));
+
+    return num_of_mismatches == 0 && num_of_prss_accepted == 0 && num_of_unloaded == 0 ? 0 : 1;
+}
 
+// Lexes the file a few times over and reports the best run, the first one mostly warms up caches
+// (and the DFA of the ANTLR lexer, which is shared by all of its instances)
+int benchLexer(const char *path, const LexerOptions &options) {
+    using clock = std::chrono::steady_clock;
+    constexpr int32_t num_of_runs = 5;
 
-void parseAntlr(const std::string& path) {
-    std::ifstream in_stream(path);
+    double best_ms = 0;
+    size_t num_of_tokens = 0;
+    for (int32_t i = 0; i < num_of_runs; ++i) {
+        const auto start = clock::now();
+        PyLexer lexer(path, options);
+        const auto end = clock::now();
 
-    if (!in_stream) {
-        return;
+        const auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+        if (i == 0 || ms < best_ms) {
+            best_ms = ms;
+        }
+        num_of_tokens = lexer.tokens().size();
     }
-    ANTLRInputStream input_stream(in_stream);
-    Python3Lexer py_lexer(&input_stream);
-    CommonTokenStream tokens(&py_lexer);
 
-    Python3Parser py_parser(&tokens);
+    printf("%s: %s lexer, %u thread(s), %zu tokens, %.3f ms, %.0f tokens/s\n", path,
+           options.kind == LexerKind::ANTLR ? "antlr" : "native", options.num_of_threads, num_of_tokens, best_ms,
+           num_of_tokens / (best_ms / 1000));
 
-    const auto tree = py_parser.file_input();
+    return 0;
+}
 
-    const auto statements = tree->stmt();
+void printErrors(const char *path, const std::vector<ParseError> &errors) {
+    for (const auto &error : errors) {
+        fprintf(stderr, "%s:%zu: %s\n", path, error.line, error.message.c_str());
+    }
+}
 
-    in_stream.close();
+bool sameErrors(const std::vector<ParseError> &a, const std::vector<ParseError> &b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const ParseError &x, const ParseError &y) {
+        return x.line == y.line && x.message == y.message;
+    });
+}
+
+// Inserts a 'pass' line (indented like the line it's inserted in front of) in front of every few lines of the file
+// and removes it again, reparsing incrementally after every edit. Each time the errors and the amount of statements
+// of the top level are checked against the ones of parsing the edited text from scratch.
+int benchIncremental(const char *path) {
+    using clock = std::chrono::steady_clock;
+    constexpr size_t max_num_of_lines = 200;
+
+    const SourceBuffer source(path);
+    const std::string text(source.data(), source.size());
+
+    const auto full_start = clock::now();
+    IncrementalParser parser(text);
+    const auto full_ms = std::chrono::duration<double, std::milli>(clock::now() - full_start).count();
+
+    std::vector<size_t> line_starts{0};
+    for (size_t i = 0; i + 1 < text.size(); ++i) {
+        if (text[i] == '\n') {
+            line_starts.push_back(i + 1);
+        }
+    }
+    const auto step = std::max<size_t>(1, line_starts.size() / max_num_of_lines);
+
+    int ret = 0;
+    size_t num_of_edits = 0;
+    size_t num_of_relexed_bytes = 0;
+    double edit_ms = 0;
+    const auto check = [&](size_t line_start) {
+        IncrementalParser from_scratch(parser.text());
+        // astEqual() replaces it with where the trees differ
+        std::string difference = "the errors differ";
+        if (sameErrors(parser.errors(), from_scratch.errors()) &&
+            astEqual(parser.tree(), from_scratch.tree(), &difference)) {
+            return;
+        }
+        fprintf(stderr, "%s: the incremental parse differs after an edit at byte %zu: %s\n", path, line_start,
+                difference.c_str());
+        ret = 1;
+    };
+
+    for (size_t i = 0; i < line_starts.size() && ret == 0; i += step) {
+        const auto line_start = line_starts[i];
+        auto indent_end = line_start;
+        while (indent_end < text.size() && (text[indent_end] == ' ' || text[indent_end] == '\t')) {
+            indent_end++;
+        }
+        const auto line = text.substr(line_start, indent_end - line_start) + "pass\n";
+
+        for (const auto undo : {false, true}) {
+            const auto start = clock::now();
+            if (undo) {
+                parser.edit(line_start, line_start + line.size(), "");
+            } else {
+                parser.edit(line_start, line_start, line);
+            }
+            edit_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            num_of_relexed_bytes += parser.lastStats().relexed_bytes;
+            num_of_edits++;
+            check(line_start);
+        }
+    }
+
+    printf("%s: %zu bytes, full parse %.3f ms, %zu edits, %.3f ms and %.0f relexed bytes per edit, %s\n", path,
+           text.size(), full_ms, num_of_edits, edit_ms / std::max<size_t>(1, num_of_edits),
+           static_cast<double>(num_of_relexed_bytes) / std::max<size_t>(1, num_of_edits),
+           ret == 0 ? "match" : "MISMATCH");
+
+    return ret;
+}
+
+// Lays the tree of the file out flat and builds it back, checking the copy against the tree and reporting the memory
+// the tree (everything in the arena of the lexer) and its FlatAst take
+int checkFlatAst(const char *path, PyLexer &lexer, Node *root) {
+    using clock = std::chrono::steady_clock;
+
+    const auto flatten_start = clock::now();
+    const FlatAst flat(root);
+    const auto build_start = clock::now();
+    Arena arena;
+    Node *copy;
+    {
+        ArenaScope scope(arena);
+        copy = flat.toTree();
+    }
+    const auto build_end = clock::now();
+
+    std::string difference;
+    const auto is_equal = astEqual(root, copy, &difference);
+    if (!is_equal) {
+        fprintf(stderr, "%s: %s\n", path, difference.c_str());
+    }
+
+    const auto tree_bytes = lexer.arena().usedBytes();
+    printf("%s: %zu nodes, tree %zu KiB, flat %zu KiB (%.1f%%), flattened in %.3f ms, built back in %.3f ms, %s\n",
+           path, flat.size(), tree_bytes / 1024, flat.numOfBytes() / 1024,
+           100.0 * flat.numOfBytes() / std::max<size_t>(1, tree_bytes),
+           std::chrono::duration<double, std::milli>(build_start - flatten_start).count(),
+           std::chrono::duration<double, std::milli>(build_end - build_start).count(),
+           is_equal ? "match" : "MISMATCH");
+
+    return is_equal ? 0 : 1;
+}
+
+// Puts a new Name in place of every Name (some of them are typed children) and a new BinOp with the operands swapped
+// in place of every BinOp, so that rewriting a tree twice gives the same tree
+class SwappingRewriter : public AstRewriter<SwappingRewriter> {
+public:
+    Node *rewriteName(Name *node) {
+        num_of_rewritten++;
+        const auto name = new Name(node->name, node->symbol);
+        name->pos_info = node->pos_info;
+        return name;
+    }
+
+    Node *rewriteBinOp(BinOp *node) {
+        num_of_rewritten++;
+        const auto bin_op = new BinOp(node->right, node->left, node->op);
+        bin_op->pos_info = node->pos_info;
+        return bin_op;
+    }
+
+    size_t num_of_rewritten = 0;
+};
+
+// Rewrites a copy of the tree of the file twice with a SwappingRewriter, checking the result against the tree
+int checkRewriter(const char *path, Node *root) {
+    using clock = std::chrono::steady_clock;
+
+    Arena arena;
+    ArenaScope scope(arena);
+    auto copy = FlatAst(root).toTree();
+
+    const auto start = clock::now();
+    SwappingRewriter rewriter;
+    copy = rewriter.rewrite(copy);
+    copy = rewriter.rewrite(copy);
+    const auto end = clock::now();
+
+    std::string difference;
+    const auto is_equal = astEqual(root, copy, &difference);
+    if (!is_equal) {
+        fprintf(stderr, "%s: %s\n", path, difference.c_str());
+    }
+
+    printf("%s: %d nodes, %zu rewritten, rewritten twice in %.3f ms, %s\n", path, astNumNodes(root),
+           rewriter.num_of_rewritten, std::chrono::duration<double, std::milli>(end - start).count(),
+           is_equal ? "match" : "MISMATCH");
+
+    return is_equal ? 0 : 1;
+}
+
+// Parses the statements read from stdin as they come. If it's a terminal, a prompt is shown for every line
+// and an empty line ends a compound statement, otherwise the input is parsed like a file would be.
+int parseStdin() {
+    using clock = std::chrono::steady_clock;
+
+    const auto is_tty = isatty(STDIN_FILENO) == 1;
+    InteractiveParser parser(is_tty);
+    size_t num_of_failed = 0;
+    const auto on_statement = [&](PyLexer &, const ParseResult &result) {
+        printErrors("<stdin>", result.errors);
+        num_of_failed += !result.errors.empty();
+    };
+
+    const auto start = clock::now();
+    size_t num_of_bytes = 0;
+    char chunk[1 << 16];
+    while (true) {
+        if (is_tty) {
+            fputs(parser.isPending() ? "... " : ">>> ", stdout);
+            fflush(stdout);
+        }
+        const auto n = read(STDIN_FILENO, chunk, sizeof(chunk));
+        if (n <= 0) {
+            break;
+        }
+        num_of_bytes += n;
+        parser.feed({chunk, static_cast<size_t>(n)}, on_statement);
+    }
+    parser.finish(on_statement);
+    const auto ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+    if (!is_tty) {
+        printf("%zu statements (%zu failed), %zu bytes, %.3f ms, %.2f MB/s\n", parser.numOfStatements(),
+               num_of_failed, num_of_bytes, ms, num_of_bytes / (ms * 1000));
+    }
+
+    return num_of_failed == 0 ? 0 : 1;
+}
+
+// Reads the paths listed in list_path, one per line
+std::vector<std::string> readFileList(const char *list_path) {
+    std::vector<std::string> paths;
+    std::ifstream list(list_path);
+    for (std::string line; std::getline(list, line);) {
+        if (!line.empty()) {
+            paths.push_back(line);
+        }
+    }
+
+    return paths;
+}
+
+// Parses every file listed in list_path (one path per line) on num_of_jobs threads, interning the names of all of
+// them into one table if shared_symbols is set
+int parseFileList(const char *list_path, LexerOptions options, uint32_t num_of_jobs, bool shared_symbols) {
+    using clock = std::chrono::steady_clock;
+
+    const auto paths = readFileList(list_path);
+    SymbolTable symbols(true);
+    if (shared_symbols) {
+        options.symbols = &symbols;
+    }
+
+    std::atomic<size_t> num_of_bytes{0};
+    std::atomic<size_t> num_of_tokens{0};
+    const auto start = clock::now();
+    const auto errors = parseFiles(paths, options, num_of_jobs, [&](size_t, PyLexer &lexer, const ParseResult &) {
+        num_of_bytes += lexer.source().size();
+        num_of_tokens += lexer.tokens().size();
+    });
+    const auto end = clock::now();
+
+    size_t num_of_failed = 0;
+    size_t num_of_errors = 0;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        printErrors(paths[i].c_str(), errors[i]);
+        num_of_failed += !errors[i].empty();
+        num_of_errors += errors[i].size();
+    }
+
+    const auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+    printf("%zu files (%zu failed, %zu errors), %u job(s), %zu tokens, %.3f ms, %.1f files/s, %.2f MB/s\n",
+           paths.size(), num_of_failed, num_of_errors, num_of_jobs, num_of_tokens.load(), ms,
+           paths.size() / (ms / 1000), num_of_bytes.load() / (ms * 1000));
+    if (shared_symbols) {
+        printf("%zu distinct names\n", symbols.size() - 1);
+    }
+
+    return num_of_failed == 0 ? 0 : 1;
+}
+
+
+// Page faults and peak RSS of the whole run, to compare the ways sources are loaded
+void printResourceUsage() {
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "minor faults: %ld, major faults: %ld, max rss: %ld KiB\n", usage.ru_minflt, usage.ru_majflt,
+            usage.ru_maxrss);
 }
 
 
 int main(int argc, const char *argv[]) {
-    if (argc < 2) {
-        puts("usage: ./program_name <path_to_source>");
+    const char *path = nullptr;
+    const char *list_path = nullptr;
+    uint32_t num_of_jobs = 1;
+    LexerOptions options;
+    bool dump_tokens = false;
+    bool dump_ast = false;
+    bool flat_ast = false;
+    bool rewrite = false;
+    bool compare_lexers = false;
+    bool compare_parsers = false;
+    bool bench_lexer = false;
+    bool bench_incremental = false;
+    bool print_stats = false;
+    bool shared_symbols = false;
+    bool repl = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--lexer=antlr") == 0) {
+            options.kind = LexerKind::ANTLR;
+        } else if (strcmp(argv[i], "--lexer=native") == 0) {
+            options.kind = LexerKind::NATIVE;
+        } else if (strcmp(argv[i], "--dump-tokens") == 0) {
+            dump_tokens = true;
+        } else if (strcmp(argv[i], "--dump-ast") == 0) {
+            dump_ast = true;
+        } else if (strcmp(argv[i], "--flat-ast") == 0) {
+            flat_ast = true;
+        } else if (strcmp(argv[i], "--rewrite") == 0) {
+            rewrite = true;
+        } else if (strcmp(argv[i], "--compare-lexers") == 0) {
+            compare_lexers = true;
+        } else if (strcmp(argv[i], "--compare-parsers") == 0) {
+            compare_parsers = true;
+        } else if (strcmp(argv[i], "--bench-lexer") == 0) {
+            bench_lexer = true;
+        } else if (strcmp(argv[i], "--bench-incremental") == 0) {
+            bench_incremental = true;
+        } else if (strcmp(argv[i], "--no-mmap") == 0) {
+            options.load = SourceLoad::READ;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            options.buffering = TokenBuffering::STREAM;
+        } else if (strcmp(argv[i], "--lazy-bodies") == 0) {
+            options.lazy_bodies = true;
+        } else if (strncmp(argv[i], "--max-depth=", 12) == 0) {
+            options.max_nesting_depth = std::max(1, atoi(argv[i] + 12));
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            options.num_of_threads = std::max(1, atoi(argv[i] + 10));
+        } else if (strncmp(argv[i], "--token-cache=", 14) == 0) {
+            options.cache_dir = argv[i] + 14;
+        } else if (strncmp(argv[i], "--files=", 8) == 0) {
+            list_path = argv[i] + 8;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            num_of_jobs = std::max(1, atoi(argv[i] + 7));
+        } else if (strcmp(argv[i], "--shared-symbols") == 0) {
+            shared_symbols = true;
+        } else if (strcmp(argv[i], "--repl") == 0) {
+            repl = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            print_stats = true;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (compare_parsers && (list_path || path)) {
+        return compareParsers(list_path ? readFileList(list_path) : std::vector<std::string>{path}, options);
+    }
+
+    if (list_path) {
+        return parseFileList(list_path, options, num_of_jobs, shared_symbols);
+    }
+
+    if (repl) {
+        const auto ret = parseStdin();
+        if (print_stats) {
+            printResourceUsage();
+        }
+        return ret;
+    }
+
+    if (!path) {
+        puts("usage: ./program_name [--lexer=native|antlr] [--no-mmap] [--stream] [--lazy-bodies] [--max-depth=N] [--threads=N] [--token-cache=DIR] [--stats] "
+             "[--dump-tokens] [--dump-ast] [--flat-ast] [--rewrite] [--compare-lexers] [--compare-parsers] [--bench-lexer] [--bench-incremental] <path_to_source>\n"
+             "       ./program_name [lexer options] [--jobs=N] [--shared-symbols] [--compare-parsers] --files=<file_with_a_path_per_line>\n"
+             "       ./program_name [--stats] --repl");
         return -1;
     }
 
-    PyLexer lexer(argv[1]);
+    if (compare_lexers) {
+        return compareLexers(path);
+    }
+
+    if (bench_lexer) {
+        return benchLexer(path, options);
+    }
+
+    if (bench_incremental) {
+        return benchIncremental(path);
+    }
+
+    if (dump_tokens) {
+        // the whole token table is needed for dumping
+        options.buffering = TokenBuffering::FULL;
+    }
+
+    PyLexer lexer(path, options);
 
-    auto root = buildAst(lexer);
+    if (dump_tokens) {
+        dumpTokens(lexer);
+        return 0;
+    }
 
-    //const auto ast_str = root->str();
-    //parseAntlr(argv[1]);
+    const auto result = parse(lexer);
+    if (!result.errors.empty()) {
+        printErrors(path, result.errors);
+        return 1;
+    }
 
-    destroyNode(root);
+    if (dump_ast) {
+        puts(result.root->str().c_str());
+        fprintf(stderr, "%d nodes\n", astNumNodes(result.root));
+    }
+
+    if (flat_ast) {
+        return checkFlatAst(path, lexer, result.root);
+    }
+
+    if (rewrite) {
+        return checkRewriter(path, result.root);
+    }
+
+    if (print_stats) {
+        printResourceUsage();
+    }
 
     return 0;
 }
@@ -1,122 +1,211 @@
+#include <cstdarg>
+
 #include "parser.hpp"
 
+// The error of a source nested deeper than the lexer allows
+static ParseError tooDeepError(const PyLexer &lexer) {
+    auto error = parseError(lexer, "too deeply nested, more than %u levels", lexer.maxNestingDepth());
+    error.is_too_deep = true;
+    return error;
+}
+
+// Counts a level of the recursion of the parser for as long as it lives. Every cycle of the grammar goes through
+// one, so a source nested deeper than the lexer allows gets an error instead of overflowing the stack.
+class NestingGuard {
+public:
+    explicit NestingGuard(PyLexer &lexer) : depth_(lexer.nestingDepth()) {
+        if (depth_ >= lexer.maxNestingDepth()) {
+            throw tooDeepError(lexer);
+        }
+        depth_++;
+    }
+
+    NestingGuard(const NestingGuard &) = delete;
+
+    NestingGuard &operator=(const NestingGuard &) = delete;
+
+    ~NestingGuard() {
+        depth_--;
+    }
+
+private:
+    uint32_t &depth_;
+};
 
 Node *parseSingleInput(PyLexer &lexer) {
-    switch (lexer.curr->getType()) {
-        case Python3Parser::NEWLINE: {
+    const auto token_type = lexer.curr.getType();
+    if (token_type == Python3Parser::NEWLINE) {
+        lexer.consume(Python3Parser::NEWLINE);
+    } else if (FIRST_SIMPLE_STMT.contains(token_type)) {
+        return parseSimpleStmt(lexer);
+    } else if (FIRST_COMPOUND_STMT.contains(token_type)) {
+        const auto comp_stmt = parseCompoundStmt(lexer);
+        // the blank line ending a compound statement doesn't make it into the tokens, the end of the input does
+        if (lexer.curr.getType() != Python3Parser::EOF) {
             lexer.consume(Python3Parser::NEWLINE);
-            break;
         }
-        case Python3Parser::STRING:
-        case Python3Parser::NUMBER:
-        case Python3Parser::RETURN:
-        case Python3Parser::RAISE:
-        case Python3Parser::FROM:
-        case Python3Parser::IMPORT:
-        case Python3Parser::GLOBAL:
-        case Python3Parser::NONLOCAL:
-        case Python3Parser::ASSERT:
-        case Python3Parser::LAMBDA:
-        case Python3Parser::NOT:
-        case Python3Parser::NONE:
-        case Python3Parser::TRUE:
-        case Python3Parser::FALSE:
-        case Python3Parser::YIELD:
-        case Python3Parser::DEL:
-        case Python3Parser::PASS:
-        case Python3Parser::CONTINUE:
-        case Python3Parser::BREAK:
-        case Python3Parser::AWAIT:
-        case Python3Parser::NAME:
-        case Python3Parser::ELLIPSIS:
-        case Python3Parser::STAR:
-        case Python3Parser::OPEN_PAREN:
-        case Python3Parser::OPEN_BRACK:
-        case Python3Parser::ADD:
-        case Python3Parser::MINUS:
-        case Python3Parser::NOT_OP:
-        case Python3Parser::OPEN_BRACE: {
-            return parseSimpleStmt(lexer);
+        return comp_stmt;
+    }
+
+    return nullptr;
+}
+
+// Panic mode: skips the rest of the statement a syntax error occurred in, up to and including its NEWLINE.
+// Stops in front of the DEDENT closing the enclosing block, or of an INDENT (the error being an unexpected one).
+static void synchronize(PyLexer &lexer) {
+    while (true) {
+        const auto token_type = lexer.curr.getType();
+        if (token_type == Python3Parser::EOF ||
+            token_type == Python3Parser::DEDENT ||
+            token_type == Python3Parser::INDENT) {
+            return;
         }
-        case Python3Parser::DEF:
-        case Python3Parser::IF:
-        case Python3Parser::WHILE:
-        case Python3Parser::FOR:
-        case Python3Parser::TRY:
-        case Python3Parser::WITH:
-        case Python3Parser::CLASS:
-        case Python3Parser::ASYNC:
-        case Python3Parser::AT: {
-            const auto comp_stmt = parseCompoundStmt(lexer);
-            lexer.consume(Python3Parser::NEWLINE);
-            return comp_stmt;
+
+        lexer.consume(token_type);
+        if (token_type == Python3Parser::NEWLINE) {
+            return;
         }
     }
+}
 
-    return nullptr;
+// Skips the block starting at the current INDENT, up to and including the DEDENT balancing it. Only the INDENTs and
+// DEDENTs are counted, so a block of any depth takes no stack.
+static void skipBlock(PyLexer &lexer) {
+    uint32_t depth = 0;
+    do {
+        const auto token_type = lexer.curr.getType();
+        if (token_type == Python3Parser::EOF) {
+            return;
+        }
+
+        if (token_type == Python3Parser::INDENT) {
+            depth++;
+        } else if (token_type == Python3Parser::DEDENT) {
+            depth--;
+        }
+        lexer.consume(token_type);
+    } while (depth > 0);
 }
 
-Node *parseFileInput(PyLexer &lexer) {
-    auto file_input = new FileInput({});
-    while (isStmt(lexer.curr)) {
-        switch (lexer.curr->getType()) {
-            case Python3Parser::NEWLINE: {
-                lexer.consume(Python3Parser::NEWLINE);
-                break;
+static void parseStmts(PyLexer &lexer, NodeList &stmts, size_t end_type);
+
+// Reports the error of the statement starting at start_idx and skips the rest of it
+static void recover(PyLexer &lexer, ParseError &&error, uint32_t start_idx) {
+    const auto is_too_deep = error.is_too_deep;
+    lexer.diagnostics().report(std::move(error));
+    synchronize(lexer);
+
+    if (lexer.curr.getType() == Python3Parser::INDENT &&
+        (is_too_deep || lexer.nestingDepth() >= lexer.maxNestingDepth())) {
+        // the suite is nested too deep to be parsed, and parsing what's deeper still would only report
+        // the error once per level
+        if (!is_too_deep) {
+            lexer.diagnostics().report(tooDeepError(lexer));
+        }
+        skipBlock(lexer);
+    } else if (lexer.curr.getType() == Python3Parser::INDENT) {
+        // the suite of a broken compound statement (or an unexpectedly indented block), it's still
+        // parsed to report the errors in it, but doesn't make it into the tree. It's a level of its own.
+        const NestingGuard guard(lexer);
+        lexer.consume(Python3Parser::INDENT);
+        NodeList orphans;
+        parseStmts(lexer, orphans, Python3Parser::DEDENT);
+        if (lexer.curr.getType() == Python3Parser::DEDENT) {
+            lexer.consume(Python3Parser::DEDENT);
+        }
+    } else if (lexer.curr.getTokenIndex() == start_idx) {
+        // a stray DEDENT at the top level
+        lexer.consume(lexer.curr.getType());
+    }
+}
+
+// Parses the statements of a block up to its end_type (DEDENT, or EOF at the top level). A statement with a syntax
+// error is reported to the diagnostics of the lexer and skipped, the parsing goes on with the next one.
+static void parseStmts(PyLexer &lexer, NodeList &stmts, const size_t end_type) {
+    const auto marks = lexer.stmtMarks();
+    while (lexer.curr.getType() != end_type && lexer.curr.getType() != Python3Parser::EOF) {
+        const auto start_idx = lexer.curr.getTokenIndex();
+        if (marks) {
+            marks->push_back({start_idx, static_cast<uint32_t>(stmts.size()),
+                              static_cast<uint32_t>(lexer.diagnostics().errors().size()), &stmts, false});
+        }
+        try {
+            if (!isStmt(lexer.curr)) {
+                ERR_MSG_THROW("should be a statement");
             }
-            case Python3Parser::STRING:
-            case Python3Parser::NUMBER:
-            case Python3Parser::DEF:
-            case Python3Parser::RETURN:
-            case Python3Parser::RAISE:
-            case Python3Parser::FROM:
-            case Python3Parser::IMPORT:
-            case Python3Parser::GLOBAL:
-            case Python3Parser::NONLOCAL:
-            case Python3Parser::ASSERT:
-            case Python3Parser::IF:
-            case Python3Parser::WHILE:
-            case Python3Parser::FOR:
-            case Python3Parser::TRY:
-            case Python3Parser::WITH:
-            case Python3Parser::LAMBDA:
-            case Python3Parser::NOT:
-            case Python3Parser::NONE:
-            case Python3Parser::TRUE:
-            case Python3Parser::FALSE:
-            case Python3Parser::CLASS:
-            case Python3Parser::YIELD:
-            case Python3Parser::DEL:
-            case Python3Parser::PASS:
-            case Python3Parser::CONTINUE:
-            case Python3Parser::BREAK:
-            case Python3Parser::ASYNC:
-            case Python3Parser::AWAIT:
-            case Python3Parser::NAME:
-            case Python3Parser::ELLIPSIS:
-            case Python3Parser::STAR:
-            case Python3Parser::OPEN_PAREN:
-            case Python3Parser::OPEN_BRACK:
-            case Python3Parser::ADD:
-            case Python3Parser::MINUS:
-            case Python3Parser::NOT_OP:
-            case Python3Parser::OPEN_BRACE:
-            case Python3Parser::AT: {
-                file_input->statements.push_back(parseStmt(lexer));
-                break;
+
+            if (lexer.curr.getType() == Python3Parser::NEWLINE) {
+                lexer.consume(Python3Parser::NEWLINE);
+            } else {
+                stmts.push_back(parseStmt(lexer));
             }
+        } catch (ParseError &error) {
+            // the nodes of the broken statement (and of its orphaned suite) stay in the arena of the lexer
+            recover(lexer, std::move(error), start_idx);
         }
     }
 
+    if (marks) {
+        marks->push_back({lexer.curr.getTokenIndex(), static_cast<uint32_t>(stmts.size()),
+                          static_cast<uint32_t>(lexer.diagnostics().errors().size()), &stmts, true});
+    }
+}
+
+Node *parseFileInput(PyLexer &lexer) {
+    auto file_input = new FileInput({});
+    parseStmts(lexer, file_input->statements, Python3Parser::EOF);
+
     return file_input;
 }
 
 
+// Moves past the suite starting at the current token without building any nodes, looking at the token types only:
+// up to the NEWLINE of a simple statement, or up to the DEDENT balancing the INDENT of a block. Returns false, leaving
+// the lexer as is, if the suite isn't one of those, so that it gets parsed right away to report the error.
+static bool skipSuite(PyLexer &lexer, uint32_t &begin, uint32_t &end) {
+    const auto &tokens = lexer.tokens();
+    const auto types = tokens.type_column;
+    const auto num_of_tokens = static_cast<uint32_t>(tokens.size());
+    const auto first = lexer.curr.getTokenIndex();
+
+    auto idx = first;
+    if (types[idx] != Python3Parser::NEWLINE) {
+        while (idx < num_of_tokens && types[idx] != Python3Parser::NEWLINE) {
+            idx++;
+        }
+        if (idx == num_of_tokens) {
+            return false;
+        }
+        idx++;
+    } else {
+        if (idx + 1 >= num_of_tokens || types[idx + 1] != Python3Parser::INDENT) {
+            return false;
+        }
+        idx += 2;
+        int32_t depth = 1;
+        for (; idx < num_of_tokens && depth > 0; ++idx) {
+            if (types[idx] == Python3Parser::INDENT) {
+                depth++;
+            } else if (types[idx] == Python3Parser::DEDENT) {
+                depth--;
+            }
+        }
+        if (depth > 0) {
+            return false;
+        }
+    }
+
+    begin = first;
+    end = idx;
+    lexer.seek(end);
+    return true;
+}
+
 Parameters *parseParameters(PyLexer &lexer) {
-    Parameters *parameters;
+    Parameters *parameters = nullptr;
     lexer.consume(Python3Parser::OPEN_PAREN);
     // if function takes some parameters
-    if (lexer.curr->getType() != Python3Parser::CLOSE_PAREN) {
+    if (lexer.curr.getType() != Python3Parser::CLOSE_PAREN) {
         parameters = parseTypedArgsList(lexer);
     }
     lexer.consume(Python3Parser::CLOSE_PAREN);
@@ -127,9 +216,9 @@ Parameter *parseParameter(PyLexer &lexer, const bool check_type = true) {
     const auto current_token = lexer.curr;
     lexer.consume(Python3Parser::NAME);
 
-    auto param = new Parameter(new Name(current_token->getText()), nullptr, nullptr);
+    auto param = new Parameter(new Name(lexer.text(current_token), current_token.getSymbol()), nullptr, nullptr);
     param->pos_info = getTokPos(current_token);
-    if (check_type && lexer.curr->getType() == Python3Parser::COLON) {
+    if (check_type && lexer.curr.getType() == Python3Parser::COLON) {
         lexer.consume(Python3Parser::COLON);
         param->type = parseTest(lexer);
     }
@@ -137,21 +226,6 @@ Parameter *parseParameter(PyLexer &lexer, const bool check_type = true) {
     return param;
 }
 
-// factor: ('+'|'-'|'~') factor | power;
-Node *parseFactor(PyLexer &lexer) {
-    // parsing unary expression
-    auto current_token = lexer.curr;
-    switch (current_token->getType()) {
-        case Python3Parser::ADD:
-        case Python3Parser::MINUS:
-        case Python3Parser::NOT_OP:
-            lexer.consume(current_token->getType());
-            return new UnaryOp(current_token->getType(), parseFactor(lexer));
-        default:
-            return parsePower(lexer);
-    }
-}
-
 // (tfpdef ( ASSIGN test )? ( COMMA tfpdef (ASSIGN test)? )* ( COMMA ( STAR (tfpdef)? (COMMA tfpdef (ASSIGN test)? )* ( COMMA (STAR (tfpdef)? (COMMA tfpdef (ASSIGN test)?)* (COMMA (POWER tfpdef (COMMA)? )?)?
 //      | POWER tfpdef (COMMA)?)?)?
 //      | STAR (tfpdef)? (COMMA tfpdef (ASSIGN test)?)* (COMMA (POWER tfpdef (COMMA)?)?)?
@@ -159,11 +233,11 @@ Node *parseFactor(PyLexer &lexer) {
 // )
 Parameters *parseTypedArgsList(PyLexer &lexer) {
     Parameters *parameters = new Parameters({}, {});
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::NAME: {
             auto parameter = parseParameter(lexer, true);
 
-            if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+            if (lexer.curr.getType() == Python3Parser::ASSIGN) {
                 lexer.consume(Python3Parser::ASSIGN);
                 parameter->default_val = parseTest(lexer);
             }
@@ -172,32 +246,33 @@ Parameters *parseTypedArgsList(PyLexer &lexer) {
             // (',' tfpdef ('=' test)?)*
             // able to parse parameters represented as follows:
             // (param, param1: type, param2: type = default)
-            while (lexer.curr->getType() == Python3Parser::COMMA &&
-                   lexer.next->getType() == Python3Parser::NAME) {
+            while (lexer.curr.getType() == Python3Parser::COMMA &&
+                   lexer.next.getType() == Python3Parser::NAME) {
                 lexer.consume(Python3Parser::COMMA);
                 auto param = parseParameter(lexer, true);
-                if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+                if (lexer.curr.getType() == Python3Parser::ASSIGN) {
                     lexer.consume(Python3Parser::ASSIGN);
-                    parameter->default_val = parseTest(lexer);
+                    param->default_val = parseTest(lexer);
                 }
                 parameters->params.push_back(param);
             }
 
-            if (lexer.curr->getType() == Python3Parser::COMMA) {
+            if (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
-                switch (lexer.curr->getType()) {
+                switch (lexer.curr.getType()) {
                     case Python3Parser::STAR: {
                         lexer.consume(Python3Parser::STAR);
-                        if (lexer.curr->getType() == Python3Parser::NAME) {
+                        if (lexer.curr.getType() == Python3Parser::NAME) {
                             parameters->extra.vararg = parseParameter(lexer, true);
                         }
 
-                        while (lexer.curr->getType() == Python3Parser::COMMA &&
-                               lexer.next->getType() == Python3Parser::NAME) {
+                        while (lexer.curr.getType() == Python3Parser::COMMA &&
+                               lexer.next.getType() == Python3Parser::NAME) {
 
                             lexer.consume(Python3Parser::COMMA);
                             parameters->extra.kw_only_args.push_back(parseParameter(lexer, true));
-                            if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+                            if (lexer.curr.getType() == Python3Parser::ASSIGN) {
+                                lexer.consume(Python3Parser::ASSIGN);
                                 parameters->extra.kw_defaults.push_back(parseTest(lexer));
                             } else {
                                 // might seem really silly, but i've no idea (yet) how to do this anyway
@@ -205,10 +280,10 @@ Parameters *parseTypedArgsList(PyLexer &lexer) {
                             }
                         }
 
-                        if (lexer.curr->getType() == Python3Parser::COMMA) {
+                        if (lexer.curr.getType() == Python3Parser::COMMA) {
                             lexer.consume(Python3Parser::COMMA);
 
-                            if (lexer.curr->getType() == Python3Parser::POWER) {
+                            if (lexer.curr.getType() == Python3Parser::POWER) {
                                 lexer.consume(Python3Parser::POWER);
                                 parameters->extra.kwarg = parseParameter(lexer, true);
                             }
@@ -218,7 +293,7 @@ Parameters *parseTypedArgsList(PyLexer &lexer) {
                     case Python3Parser::POWER: {
                         lexer.consume(Python3Parser::POWER);
                         parameters->extra.kwarg = parseParameter(lexer, true);
-                        if (lexer.curr->getType() == Python3Parser::COMMA) {
+                        if (lexer.curr.getType() == Python3Parser::COMMA) {
                             lexer.consume(Python3Parser::COMMA);
                         }
                         break;
@@ -232,16 +307,17 @@ Parameters *parseTypedArgsList(PyLexer &lexer) {
         case Python3Parser::STAR: {
             lexer.consume(Python3Parser::STAR);
 
-            if (lexer.curr->getType() == Python3Parser::NAME) {
+            if (lexer.curr.getType() == Python3Parser::NAME) {
                 parameters->extra.vararg = parseParameter(lexer, true);
             }
 
-            while (lexer.curr->getType() == Python3Parser::COMMA &&
-                   lexer.next->getType() == Python3Parser::NAME) {
+            while (lexer.curr.getType() == Python3Parser::COMMA &&
+                   lexer.next.getType() == Python3Parser::NAME) {
 
                 lexer.consume(Python3Parser::COMMA);
                 parameters->extra.kw_only_args.push_back(parseParameter(lexer, true));
-                if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+                if (lexer.curr.getType() == Python3Parser::ASSIGN) {
+                    lexer.consume(Python3Parser::ASSIGN);
                     parameters->extra.kw_defaults.push_back(parseTest(lexer));
                 } else {
                     // might seem really silly, but i've no idea (yet) how to do this anyway
@@ -249,13 +325,13 @@ Parameters *parseTypedArgsList(PyLexer &lexer) {
                 }
             }
 
-            if (lexer.curr->getType() == Python3Parser::COMMA) {
+            if (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
 
-                if (lexer.curr->getType() == Python3Parser::POWER) {
+                if (lexer.curr.getType() == Python3Parser::POWER) {
                     lexer.consume(Python3Parser::POWER);
                     parameters->extra.kwarg = parseParameter(lexer, true);
-                    if (lexer.curr->getType() == Python3Parser::COMMA) {
+                    if (lexer.curr.getType() == Python3Parser::COMMA) {
                         lexer.consume(Python3Parser::COMMA);
                     }
                 }
@@ -265,13 +341,13 @@ Parameters *parseTypedArgsList(PyLexer &lexer) {
         case Python3Parser::POWER: {
             lexer.consume(Python3Parser::POWER);
             parameters->extra.kwarg = parseParameter(lexer, true);
-            if (lexer.curr->getType() == Python3Parser::COMMA) {
+            if (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
             }
             break;
         }
         default:
-        ERR_MSG_EXIT("Expected NAME, STAR or POWER");
+        ERR_MSG_THROW("Expected NAME, STAR or POWER");
     }
 
 
@@ -287,23 +363,23 @@ Parameters *parseTypedArgsList(PyLexer &lexer) {
 // );
 Node *parseVarArgsList(PyLexer &lexer) {
     auto parameters = new Parameters({}, {});
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::NAME: {
             const auto arg = parseParameter(lexer, false);
 
-            if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+            if (lexer.curr.getType() == Python3Parser::ASSIGN) {
                 lexer.consume(Python3Parser::ASSIGN);
                 arg->default_val = parseTest(lexer);
             }
 
             parameters->params.push_back(arg);
 
-            while (lexer.curr->getType() == Python3Parser::COMMA &&
-                   lexer.next->getType() == Python3Parser::NAME) {
+            while (lexer.curr.getType() == Python3Parser::COMMA &&
+                   lexer.next.getType() == Python3Parser::NAME) {
                 lexer.consume(Python3Parser::COMMA);
                 const auto arg = parseParameter(lexer, false);
 
-                if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+                if (lexer.curr.getType() == Python3Parser::ASSIGN) {
                     lexer.consume(Python3Parser::ASSIGN);
                     arg->default_val = parseTest(lexer);
                 }
@@ -311,46 +387,48 @@ Node *parseVarArgsList(PyLexer &lexer) {
                 parameters->params.push_back(arg);
             }
 
-            const auto text = lexer.curr->getText();
-            if (lexer.curr->getType() == Python3Parser::COMMA) {
+            if (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
 
-                if (lexer.curr->getType() == Python3Parser::STAR) {
-                    if (lexer.curr->getType() == Python3Parser::NAME) {
+                if (lexer.curr.getType() == Python3Parser::STAR) {
+                    lexer.consume(Python3Parser::STAR);
+                    if (lexer.curr.getType() == Python3Parser::NAME) {
                         parameters->extra.vararg = parseParameter(lexer, false);
                     }
 
-                    while (lexer.curr->getType() == Python3Parser::COMMA &&
-                           lexer.next->getType() == Python3Parser::NAME) {
+                    while (lexer.curr.getType() == Python3Parser::COMMA &&
+                           lexer.next.getType() == Python3Parser::NAME) {
 
                         lexer.consume(Python3Parser::COMMA);
                         const auto arg = parseParameter(lexer, false);
-                        if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+                        if (lexer.curr.getType() == Python3Parser::ASSIGN) {
                             lexer.consume(Python3Parser::ASSIGN);
                             parameters->extra.kw_defaults.push_back(parseTest(lexer));
+                        } else {
+                            parameters->extra.kw_defaults.push_back(nullptr);
                         }
                         parameters->extra.kw_only_args.push_back(arg);
                     }
-                }
 
-                if (lexer.curr->getType() == Python3Parser::COMMA) {
-                    lexer.consume(Python3Parser::COMMA);
+                    if (lexer.curr.getType() == Python3Parser::COMMA) {
+                        lexer.consume(Python3Parser::COMMA);
 
-                    if (lexer.curr->getType() == Python3Parser::POWER) {
-                        lexer.consume(Python3Parser::POWER);
-                        parameters->extra.kwarg = parseParameter(lexer, false);
+                        if (lexer.curr.getType() == Python3Parser::POWER) {
+                            lexer.consume(Python3Parser::POWER);
+                            parameters->extra.kwarg = parseParameter(lexer, false);
 
-                        if (lexer.curr->getType() == Python3Parser::COMMA) {
-                            lexer.consume(Python3Parser::COMMA);
+                            if (lexer.curr.getType() == Python3Parser::COMMA) {
+                                lexer.consume(Python3Parser::COMMA);
+                            }
                         }
                     }
-                }
-
-                lexer.consume(Python3Parser::POWER);
-                parameters->extra.kwarg = parseParameter(lexer, false);
+                } else if (lexer.curr.getType() == Python3Parser::POWER) {
+                    lexer.consume(Python3Parser::POWER);
+                    parameters->extra.kwarg = parseParameter(lexer, false);
 
-                if (lexer.curr->getType() == Python3Parser::COMMA) {
-                    lexer.consume(Python3Parser::COMMA);
+                    if (lexer.curr.getType() == Python3Parser::COMMA) {
+                        lexer.consume(Python3Parser::COMMA);
+                    }
                 }
             }
             break;
@@ -358,31 +436,33 @@ Node *parseVarArgsList(PyLexer &lexer) {
         case Python3Parser::STAR: {
             lexer.consume(Python3Parser::STAR);
 
-            if (lexer.curr->getType() == Python3Parser::NAME) {
+            if (lexer.curr.getType() == Python3Parser::NAME) {
                 parameters->extra.vararg = parseParameter(lexer, false);
             }
 
-            while (lexer.curr->getType() == Python3Parser::COMMA &&
-                   lexer.next->getType() == Python3Parser::NAME) {
+            while (lexer.curr.getType() == Python3Parser::COMMA &&
+                   lexer.next.getType() == Python3Parser::NAME) {
 
                 lexer.consume(Python3Parser::COMMA);
                 auto arg = parseParameter(lexer, false);
 
-                if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+                if (lexer.curr.getType() == Python3Parser::ASSIGN) {
                     lexer.consume(Python3Parser::ASSIGN);
                     parameters->extra.kw_defaults.push_back(parseTest(lexer));
+                } else {
+                    parameters->extra.kw_defaults.push_back(nullptr);
                 }
                 parameters->extra.kw_only_args.push_back(arg);
             }
 
-            if (lexer.curr->getType() == Python3Parser::COMMA) {
+            if (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
 
-                if (lexer.curr->getType() == Python3Parser::POWER) {
+                if (lexer.curr.getType() == Python3Parser::POWER) {
                     lexer.consume(Python3Parser::POWER);
                     parameters->extra.kwarg = parseParameter(lexer, false);
 
-                    if (lexer.curr->getType() == Python3Parser::COMMA) {
+                    if (lexer.curr.getType() == Python3Parser::COMMA) {
                         lexer.consume(Python3Parser::COMMA);
                     }
                 }
@@ -392,13 +472,13 @@ Node *parseVarArgsList(PyLexer &lexer) {
         case Python3Parser::POWER: {
             lexer.consume(Python3Parser::POWER);
             parameters->extra.kwarg = parseParameter(lexer, false);
-            if (lexer.curr->getType() == Python3Parser::COMMA) {
+            if (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
             }
             break;
         }
         default:
-        ERR_MSG_EXIT("Expected NAME, STAR or POWER");
+        ERR_MSG_THROW("Expected NAME, STAR or POWER");
     }
 
 
@@ -406,31 +486,34 @@ Node *parseVarArgsList(PyLexer &lexer) {
 }
 
 
-FuncDef *parseFuncDef(PyLexer &lexer, std::vector<Node *> &&decorator_list) {
+FuncDef *parseFuncDef(PyLexer &lexer, NodeList &&decorator_list) {
     lexer.consume(Python3Parser::DEF);
 
     const auto current_token = lexer.curr;
     lexer.consume(Python3Parser::NAME);
-    auto func_def = new FuncDef(current_token->getText(), nullptr, nullptr, nullptr, {});
+    auto func_def = new FuncDef(lexer.text(current_token), nullptr, nullptr, nullptr, {});
+    func_def->name_symbol = current_token.getSymbol();
 
     func_def->parameters = parseParameters(lexer);
 
-    if (lexer.curr->getType() == Python3Parser::ARROW) {
+    if (lexer.curr.getType() == Python3Parser::ARROW) {
         lexer.consume(Python3Parser::ARROW);
         func_def->return_type = parseTest(lexer);
     }
 
     lexer.consume(Python3Parser::COLON);
 
-    func_def->body = parseSuite(lexer);
+    if (!lexer.lazyBodies() || !skipSuite(lexer, func_def->body_begin, func_def->body_end)) {
+        func_def->body = parseSuite(lexer);
+    }
     func_def->decorator_list = std::move(decorator_list);
 
     return func_def;
 }
 
-AsyncFuncDef *parseAsyncFuncDef(PyLexer &lexer, std::vector<Node *> &&decorator_list) {
+AsyncFuncDef *parseAsyncFuncDef(PyLexer &lexer, NodeList &&decorator_list) {
     lexer.consume(Python3Parser::ASYNC);
-    auto async_func_def = new AsyncFuncDef(parseFuncDef(lexer, std::forward<std::vector<Node *>>(decorator_list)),
+    auto async_func_def = new AsyncFuncDef(parseFuncDef(lexer, std::move(decorator_list)),
                                            true);
     return async_func_def;
 }
@@ -448,19 +531,19 @@ Node *parseSimpleStmt(PyLexer &lexer) {
     const auto node = parseSmallStmt(lexer);
 
     simple_stmt->small_stmts.push_back(node);
-    while (lexer.curr->getType() == Python3Parser::SEMI_COLON) {
+    while (lexer.curr.getType() == Python3Parser::SEMI_COLON) {
         lexer.consume(Python3Parser::SEMI_COLON);
 
         // handle a terminal semicolon
-        if (lexer.curr->getType() == Python3Parser::EOF ||
-            lexer.curr->getType() == Python3Parser::NEWLINE) {
+        if (lexer.curr.getType() == Python3Parser::EOF ||
+            lexer.curr.getType() == Python3Parser::NEWLINE) {
             break;
         }
         const auto node = parseSmallStmt(lexer);
         simple_stmt->small_stmts.push_back(node);
     }
 
-    if (lexer.curr->getType() == Python3Parser::NEWLINE) {
+    if (lexer.curr.getType() == Python3Parser::NEWLINE) {
         lexer.consume(Python3Parser::NEWLINE);
     }
 
@@ -468,7 +551,7 @@ Node *parseSimpleStmt(PyLexer &lexer) {
 }
 
 Node *parseSmallStmt(PyLexer &lexer) {
-    switch (lexer.curr->getType()) {
+    switch (FIRST_TESTLIST_STAR_EXPR.classify(lexer.curr.getType())) {
         case Python3Parser::ASSERT:
             return parseAssertStmt(lexer);
         case Python3Parser::NONLOCAL:
@@ -488,26 +571,10 @@ Node *parseSmallStmt(PyLexer &lexer) {
         case Python3Parser::RAISE:
         case Python3Parser::YIELD:
             return parseFlowStmt(lexer);
-        case Python3Parser::STAR:
-        case Python3Parser::STRING:
-        case Python3Parser::NUMBER:
-        case Python3Parser::LAMBDA:
-        case Python3Parser::NOT:
-        case Python3Parser::NONE:
-        case Python3Parser::TRUE:
-        case Python3Parser::FALSE:
-        case Python3Parser::AWAIT:
-        case Python3Parser::NAME:
-        case Python3Parser::ELLIPSIS:
-        case Python3Parser::OPEN_PAREN:
-        case Python3Parser::OPEN_BRACK:
-        case Python3Parser::ADD:
-        case Python3Parser::MINUS:
-        case Python3Parser::NOT_OP:
-        case Python3Parser::OPEN_BRACE:
+        case TokenSet::MEMBER:
             return parseExprStmt(lexer);
         default:
-        ERR_MSG_EXIT("expected EXPR, DEL, PASS, FLOW, IMPORT, GLOBAL, NONLOCAL or ASSERT");
+        ERR_MSG_THROW("expected EXPR, DEL, PASS, FLOW, IMPORT, GLOBAL, NONLOCAL or ASSERT");
     }
 }
 
@@ -518,7 +585,7 @@ Assert *parseAssertStmt(PyLexer &lexer) {
 
     assert->test = parseTest(lexer);
 
-    if (lexer.curr->getType() == Python3Parser::COMMA) {
+    if (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
         assert->message = parseTest(lexer);
     }
@@ -527,7 +594,7 @@ Assert *parseAssertStmt(PyLexer &lexer) {
 }
 
 Node *parseFlowStmt(PyLexer &lexer) {
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::BREAK:
             return parseBreakStmt(lexer);
         case Python3Parser::CONTINUE:
@@ -539,7 +606,7 @@ Node *parseFlowStmt(PyLexer &lexer) {
         case Python3Parser::YIELD:
             return parseYieldStmt(lexer);
         default:
-        ERR_MSG_EXIT("expected BREAK, CONTINUE, RETURN, RAISE or YIELD");
+        ERR_MSG_THROW("expected BREAK, CONTINUE, RETURN, RAISE or YIELD");
     }
 }
 
@@ -552,15 +619,15 @@ Pass *parsePassStmt(PyLexer &lexer) {
 ExprList *parseExprList(PyLexer &lexer) {
     auto expr_list = new ExprList({});
 
-    if (lexer.curr->getType() == Python3Parser::STAR) {
+    if (lexer.curr.getType() == Python3Parser::STAR) {
         expr_list->expr_list.push_back(parseStarExpr(lexer));
     } else {
         expr_list->expr_list.push_back(parseExpr(lexer));
     }
 
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
-        if (lexer.curr->getType() == Python3Parser::STAR) {
+        if (lexer.curr.getType() == Python3Parser::STAR) {
             expr_list->expr_list.push_back(parseStarExpr(lexer));
         } else {
             expr_list->expr_list.push_back(parseExpr(lexer));
@@ -574,23 +641,20 @@ ExprList *parseExprList(PyLexer &lexer) {
 ImportFrom *parseImportFrom(PyLexer &lexer) {
     lexer.consume(Python3Parser::FROM);
     auto import_from = new ImportFrom(nullptr, nullptr, 0);
-    int32_t level;
+    int32_t level = 0;
 
-    // TODO(threadedstream): handle case with ellipsis
-    while (lexer.curr->getType() == Python3Parser::DOT) {
-        lexer.consume(Python3Parser::DOT);
-        level++;
+    // '...' is lexed as an ELLIPSIS, it's three levels up
+    while (lexer.curr.getType() == Python3Parser::DOT || lexer.curr.getType() == Python3Parser::ELLIPSIS) {
+        level += lexer.curr.getType() == Python3Parser::DOT ? 1 : 3;
+        lexer.consume(lexer.curr.getType());
     }
 
-    if (level == 0 && !(lexer.curr->getType() == Python3Parser::NAME)) {
-        // TODO(threadedstream): adhoc method to report an error and terminate application
-        // call to destroyAst() would be great
-        ERR_TOK(Python3Parser::NAME);
-        exit(1);
+    if (level == 0 && !(lexer.curr.getType() == Python3Parser::NAME)) {
+        ERR_MSG_THROW("expected NAME");
     }
 
     import_from->level = level;
-    if (lexer.curr->getType() == Python3Parser::NAME) {
+    if (lexer.curr.getType() == Python3Parser::NAME) {
         const auto name = parseDottedName(lexer);
         import_from->module = name;
     }
@@ -598,10 +662,11 @@ ImportFrom *parseImportFrom(PyLexer &lexer) {
     lexer.consume(Python3Parser::IMPORT);
 
     // may look really dumb
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::STAR: {
-            const auto name = new Name("*");
-            import_from->aliases->aliases.push_back(new Alias(name, nullptr));
+            const auto name = new Name("*", lexer.intern("*"));
+            lexer.consume(Python3Parser::STAR);
+            import_from->aliases = new Aliases({new Alias(name, nullptr)});
             break;
         }
         case Python3Parser::OPEN_PAREN: {
@@ -614,7 +679,7 @@ ImportFrom *parseImportFrom(PyLexer &lexer) {
             import_from->aliases = parseImportAsNames(lexer);
             break;
         default:
-        ERR_MSG_EXIT("expected STAR, OPEN_PAREN or NAME\n");
+        ERR_MSG_THROW("expected STAR, OPEN_PAREN or NAME\n");
     }
 
     return import_from;
@@ -625,42 +690,51 @@ ImportFrom *parseImportFrom(PyLexer &lexer) {
 // a simple name
 Node *parseDottedName(PyLexer &lexer, bool as_attr) {
     if (!as_attr) {
-        std::string name;
-        const auto current_token = lexer.curr;
+        const auto start = lexer.curr.getStartIndex();
+        auto end = start + lexer.curr.getLength();
         lexer.consume(Python3Parser::NAME);
 
-        name += current_token->getText();
-
-        while (lexer.curr->getType() == Python3Parser::DOT) {
+        while (lexer.curr.getType() == Python3Parser::DOT) {
             lexer.consume(Python3Parser::DOT);
-            const auto current_token = lexer.curr;
+            end = lexer.curr.getStartIndex() + lexer.curr.getLength();
             lexer.consume(Python3Parser::NAME);
-            name += current_token->getText();
         }
 
-        auto dotted_name = new Name(name);
+        // the dotted name is referred to right in the source, unless there's whitespace in between
+        auto name = lexer.source().view(start, end - start);
+        if (name.find_first_of(" \t\\\r\n\f") != std::string_view::npos) {
+            std::string stripped;
+            for (const auto c: name) {
+                if (c != ' ' && c != '\t' && c != '\\' && c != '\r' && c != '\n' && c != '\f') {
+                    stripped.push_back(c);
+                }
+            }
+            name = lexer.keep(std::move(stripped));
+        }
+
+        auto dotted_name = new Name(name, lexer.intern(name));
 
         return dotted_name;
     } else {
         const auto attr_value_token = lexer.curr;
         lexer.consume(Python3Parser::NAME);
-        if (lexer.curr->getType() == Python3Parser::DOT) {
-            auto attribute = new Attribute(new Name(attr_value_token->getText()), nullptr);
+        if (lexer.curr.getType() == Python3Parser::DOT) {
+            auto attribute = new Attribute(new Name(lexer.text(attr_value_token), attr_value_token.getSymbol()), nullptr);
             lexer.consume(Python3Parser::DOT);
             const auto attr_attr_token = lexer.curr;
             lexer.consume(Python3Parser::NAME);
-            attribute->attr = new Name(attr_attr_token->getText());
+            attribute->attr = new Name(lexer.text(attr_attr_token), attr_attr_token.getSymbol());
 
-            while (lexer.curr->getType() == Python3Parser::DOT) {
+            while (lexer.curr.getType() == Python3Parser::DOT) {
                 lexer.consume(Python3Parser::DOT);
                 const auto attr_attr_token = lexer.curr;
                 lexer.consume(Python3Parser::NAME);
-                attribute = new Attribute(attribute, new Name(attr_attr_token->getText()));
+                attribute = new Attribute(attribute, new Name(lexer.text(attr_attr_token), attr_attr_token.getSymbol()));
             }
 
             return attribute;
         } else {
-            return new Name(attr_value_token->getText());
+            return new Name(lexer.text(attr_value_token), attr_value_token.getSymbol());
         }
     }
 }
@@ -668,9 +742,10 @@ Node *parseDottedName(PyLexer &lexer, bool as_attr) {
 Alias *parseDottedAsName(PyLexer &lexer) {
     const auto dotted_name = parseDottedName(lexer);
     auto alias = new Alias(dotted_name, nullptr);
-    if (lexer.curr->getType() == Python3Parser::AS) {
+    if (lexer.curr.getType() == Python3Parser::AS) {
         lexer.consume(Python3Parser::AS);
-        alias->as = new Name(lexer.curr->getText());
+        alias->as = new Name(lexer.text(lexer.curr), lexer.curr.getSymbol());
+        lexer.consume(Python3Parser::NAME);
     }
 
     return alias;
@@ -681,7 +756,7 @@ Aliases *parseDottedAsNames(PyLexer &lexer) {
     auto aliases = new Aliases({});
     aliases->aliases.push_back(dotted_as_name);
 
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
         const auto dotted_as_name = parseDottedAsName(lexer);
         aliases->aliases.push_back(dotted_as_name);
@@ -701,16 +776,24 @@ IfStmt *parseIfStmt(PyLexer &lexer, int32_t depth) {
 
     if_stmt->body = parseSuite(lexer);
 
-    while (lexer.curr->getType() == Python3Parser::ELIF) {
+    // every elif nests in the or_else of the one before, built in a loop so that a long chain of them
+    // doesn't go deep on the stack
+    auto last = if_stmt;
+    while (lexer.curr.getType() == Python3Parser::ELIF) {
         lexer.consume(Python3Parser::ELIF);
-        if_stmt->or_else = parseIfStmt(lexer, depth + 1);
+        const auto elif = new IfStmt(nullptr, nullptr, nullptr);
+        last->or_else = elif;
+        last = elif;
+        elif->test = parseTest(lexer);
+        lexer.consume(Python3Parser::COLON);
+        elif->body = parseSuite(lexer);
     }
 
-    if (lexer.curr->getType() == Python3Parser::ELSE) {
+    if (lexer.curr.getType() == Python3Parser::ELSE) {
         lexer.consume(Python3Parser::ELSE);
         lexer.consume(Python3Parser::COLON);
 
-        if_stmt->or_else = parseSuite(lexer);
+        last->or_else = parseSuite(lexer);
     }
 
     return if_stmt;
@@ -722,7 +805,7 @@ WhileStmt *parseWhileStmt(PyLexer &lexer) {
     while_stmt->test = parseTest(lexer);
     lexer.consume(Python3Parser::COLON);
     while_stmt->body = parseSuite(lexer);
-    if (lexer.curr->getType() == Python3Parser::ELSE) {
+    if (lexer.curr.getType() == Python3Parser::ELSE) {
         lexer.consume(Python3Parser::ELSE);
         lexer.consume(Python3Parser::COLON);
         while_stmt->or_else = parseSuite(lexer);
@@ -734,12 +817,12 @@ WhileStmt *parseWhileStmt(PyLexer &lexer) {
 Alias *parseImportAsName(PyLexer &lexer) {
     auto alias = new Alias(nullptr, nullptr);
 
-    auto name = new Name(lexer.curr->getText());
+    auto name = new Name(lexer.text(lexer.curr), lexer.curr.getSymbol());
 
     lexer.consume(Python3Parser::NAME);
-    if (lexer.curr->getType() == Python3Parser::AS) {
+    if (lexer.curr.getType() == Python3Parser::AS) {
         lexer.consume(Python3Parser::AS);
-        auto as = new Name(lexer.curr->getText());
+        auto as = new Name(lexer.text(lexer.curr), lexer.curr.getSymbol());
         lexer.consume(Python3Parser::NAME);
         alias->as = as;
     }
@@ -755,8 +838,12 @@ Aliases *parseImportAsNames(PyLexer &lexer) {
 
     aliases->aliases.push_back(alias);
 
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
+        // a trailing comma
+        if (lexer.curr.getType() != Python3Parser::NAME) {
+            break;
+        }
         const auto alias = parseImportAsName(lexer);
         aliases->aliases.push_back(alias);
     }
@@ -765,20 +852,11 @@ Aliases *parseImportAsNames(PyLexer &lexer) {
 }
 
 Node *parseStmt(PyLexer &lexer) {
-    switch (lexer.curr->getType()) {
-        case Python3Parser::IF:
-        case Python3Parser::WHILE:
-        case Python3Parser::FOR:
-        case Python3Parser::TRY:
-        case Python3Parser::WITH:
-        case Python3Parser::DEF:
-        case Python3Parser::CLASS:
-        case Python3Parser::AT:
-        case Python3Parser::ASYNC:
-            return parseCompoundStmt(lexer);
-        default:
-            return parseSimpleStmt(lexer);
+    if (FIRST_COMPOUND_STMT.contains(lexer.curr.getType())) {
+        return parseCompoundStmt(lexer);
     }
+
+    return parseSimpleStmt(lexer);
 }
 
 Node *parseCompIf(PyLexer &lexer) {
@@ -792,19 +870,19 @@ Node *parseCompIf(PyLexer &lexer) {
 
 
 Node *parseCompIter(PyLexer &lexer) {
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::IF:
             return parseCompIf(lexer);
         case Python3Parser::ASYNC:
         case Python3Parser::FOR:
             return parseCompFor(lexer);
         default:
-        ERR_MSG_EXIT("Expected IF, ASYNC or FOR");
+        ERR_MSG_THROW("Expected IF, ASYNC or FOR");
     }
 }
 
 Node *parseCompoundStmt(PyLexer &lexer) {
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::IF:
             return parseIfStmt(lexer, 0);
         case Python3Parser::WHILE:
@@ -824,29 +902,33 @@ Node *parseCompoundStmt(PyLexer &lexer) {
         case Python3Parser::ASYNC:
             return parseAsyncStmt(lexer);
         default: {
-            ERR_MSG_EXIT("expected IF, WHILE, FOR, TRY, DEF, CLASS, AT or ASYNC");
+            ERR_MSG_THROW("expected IF, WHILE, FOR, TRY, DEF, CLASS, AT or ASYNC");
         }
     }
 }
 
 // classdef: 'class' NAME ('(' (arglist)? ')')? ':' suite;
-ClassDef *parseClassDef(PyLexer &lexer, std::vector<Node *> &&decorator_list) {
-    const auto line_start = lexer.curr->getLine();
-    const auto col_start = lexer.curr->getStartIndex();
+ClassDef *parseClassDef(PyLexer &lexer, NodeList &&decorator_list) {
+    const auto line_start = lexer.curr.getLine();
+    const auto col_start = lexer.curr.getStartIndex();
     lexer.consume(Python3Parser::CLASS);
 
-    const auto class_name = lexer.curr->getText();
-    Arguments *arglist;
+    const auto class_name = lexer.text(lexer.curr);
+    const auto class_symbol = lexer.curr.getSymbol();
+    Arguments *arglist = nullptr;
     lexer.consume(Python3Parser::NAME);
-    if (lexer.curr->getType() == Python3Parser::OPEN_PAREN) {
+    if (lexer.curr.getType() == Python3Parser::OPEN_PAREN) {
         lexer.consume(Python3Parser::OPEN_PAREN);
-        arglist = parseArglist(lexer);
+        if (lexer.curr.getType() != Python3Parser::CLOSE_PAREN) {
+            arglist = parseArglist(lexer);
+        }
         lexer.consume(Python3Parser::CLOSE_PAREN);
     }
 
     lexer.consume(Python3Parser::COLON);
     const auto body = parseSuite(lexer);
     auto class_def = new ClassDef(class_name, arglist, body, std::move(decorator_list));
+    class_def->name_symbol = class_symbol;
 
     // temporary
     (void) line_start;
@@ -856,16 +938,12 @@ ClassDef *parseClassDef(PyLexer &lexer, std::vector<Node *> &&decorator_list) {
 }
 
 Node *parseSuite(PyLexer &lexer) {
-    if (lexer.curr->getType() == Python3Parser::NEWLINE) {
+    const NestingGuard guard(lexer);
+    if (lexer.curr.getType() == Python3Parser::NEWLINE) {
         lexer.consume(Python3Parser::NEWLINE);
         lexer.consume(Python3Parser::INDENT);
-        if (!isStmt(lexer.curr)) {
-            ERR_MSG_EXIT("should be a statement");
-        }
         auto stmt = new Stmt({});
-        while (isStmt(lexer.curr)) {
-            stmt->nodes.push_back(parseStmt(lexer));
-        }
+        parseStmts(lexer, stmt->nodes, Python3Parser::DEDENT);
         lexer.consume(Python3Parser::DEDENT);
         return stmt;
     } else {
@@ -874,12 +952,12 @@ Node *parseSuite(PyLexer &lexer) {
 }
 
 Node *parseImportStmt(PyLexer &lexer) {
-    if (lexer.curr->getType() == Python3Parser::IMPORT) {
+    if (lexer.curr.getType() == Python3Parser::IMPORT) {
         return parseImportName(lexer);
-    } else if (lexer.curr->getType() == Python3Parser::FROM) {
+    } else if (lexer.curr.getType() == Python3Parser::FROM) {
         return parseImportFrom(lexer);
     } else {
-        ERR_MSG_EXIT("expected IMPORT or FROM\n");
+        ERR_MSG_THROW("expected IMPORT or FROM\n");
     }
 }
 
@@ -904,35 +982,22 @@ Continue *parseContinueStmt(PyLexer &lexer) {
 }
 
 Node *parseTestNoCond(PyLexer &lexer) {
-    switch (lexer.curr->getType()) {
-        case Python3Parser::STRING:
-        case Python3Parser::NUMBER:
-        case Python3Parser::NOT:
-        case Python3Parser::NONE:
-        case Python3Parser::TRUE:
-        case Python3Parser::FALSE:
-        case Python3Parser::AWAIT:
-        case Python3Parser::NAME:
-        case Python3Parser::ELLIPSIS:
-        case Python3Parser::OPEN_PAREN:
-        case Python3Parser::OPEN_BRACK:
-        case Python3Parser::ADD:
-        case Python3Parser::MINUS:
-        case Python3Parser::NOT_OP:
-        case Python3Parser::OPEN_BRACE: {
+    switch (FIRST_OR_TEST.classify(lexer.curr.getType())) {
+        case TokenSet::MEMBER: {
             return parseOrTest(lexer);
         }
         case Python3Parser::LAMBDA:
             return parseLambDefNoCond(lexer);
         default:
-        ERR_MSG_EXIT("Expected OR_TEST or LAMBDA");
+        ERR_MSG_THROW("Expected OR_TEST or LAMBDA");
     }
 }
 
 Node *parseLambDefNoCond(PyLexer &lexer) {
+    const NestingGuard guard(lexer);
     lexer.consume(Python3Parser::LAMBDA);
     auto lambda = new Lambda(nullptr, nullptr);
-    const auto current_type = lexer.curr->getType();
+    const auto current_type = lexer.curr.getType();
     if (current_type == Python3Parser::NAME ||
         current_type == Python3Parser::STAR ||
         current_type == Python3Parser::POWER) {
@@ -950,7 +1015,7 @@ TestList *parseTestlist(PyLexer &lexer) {
     auto node = parseTest(lexer);
     test_list->nodes.push_back(node);
 
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
 
         const auto node = parseTest(lexer);
@@ -972,7 +1037,7 @@ WithStmt *parseWithStmt(PyLexer &lexer) {
     const auto with_item = parseWithItem(lexer);
     with_stmt->items.push_back(with_item);
 
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
 
         const auto with_item = parseWithItem(lexer);
@@ -990,7 +1055,7 @@ WithItem *parseWithItem(PyLexer &lexer) {
     auto with_item = new WithItem(nullptr, nullptr);
     with_item->context_expr = parseTest(lexer);
 
-    if (lexer.curr->getType() == Python3Parser::AS) {
+    if (lexer.curr.getType() == Python3Parser::AS) {
         lexer.consume(Python3Parser::AS);
         with_item->optional_vars = parseExpr(lexer);
     }
@@ -1002,7 +1067,9 @@ Return *parseReturnStmt(PyLexer &lexer) {
     lexer.consume(Python3Parser::RETURN);
     auto node = new Return(nullptr);
 
-    node->test_list = parseTestlist(lexer);
+    if (isTest(lexer.curr)) {
+        node->test_list = parseTestlist(lexer);
+    }
 
     return node;
 }
@@ -1012,9 +1079,14 @@ Raise *parseRaiseStmt(PyLexer &lexer) {
 
     auto raise = new Raise(nullptr, nullptr);
 
+    if (!isTest(lexer.curr)) {
+        // re-raising the exception being handled
+        return raise;
+    }
+
     raise->exception = parseTest(lexer);
 
-    if (lexer.curr->getType() == Python3Parser::FROM) {
+    if (lexer.curr.getType() == Python3Parser::FROM) {
         lexer.consume(Python3Parser::FROM);
 
         raise->from = parseTest(lexer);
@@ -1030,7 +1102,7 @@ Node *parseYieldStmt(PyLexer &lexer) {
 Node *parseYieldExpr(PyLexer &lexer) {
     lexer.consume(Python3Parser::YIELD);
 
-    if (lexer.curr->getType() == Python3Parser::FROM) {
+    if (lexer.curr.getType() == Python3Parser::FROM) {
         lexer.consume(Python3Parser::FROM);
 
         auto yield_from = new YieldFrom(nullptr);
@@ -1041,7 +1113,9 @@ Node *parseYieldExpr(PyLexer &lexer) {
 
     auto yield_stmt = new Yield(nullptr);
 
-    yield_stmt->target = parseTestlist(lexer);
+    if (isTest(lexer.curr)) {
+        yield_stmt->target = parseTestlist(lexer);
+    }
 
     return yield_stmt;
 }
@@ -1052,7 +1126,7 @@ TestList *parseTestList(PyLexer &lexer) {
     const auto node = parseTest(lexer);
     test_list->nodes.push_back(node);
 
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
         test_list->nodes.push_back(parseTest(lexer));
     }
@@ -1071,27 +1145,10 @@ Arguments *parseArglist(PyLexer &lexer) {
         arguments->args.push_back(argument);
     }
 
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
-        switch (lexer.curr->getType()) {
-            case Python3Parser::STRING:
-            case Python3Parser::NUMBER:
-            case Python3Parser::LAMBDA:
-            case Python3Parser::NOT:
-            case Python3Parser::NONE:
-            case Python3Parser::TRUE:
-            case Python3Parser::FALSE:
-            case Python3Parser::AWAIT:
-            case Python3Parser::NAME:
-            case Python3Parser::ELLIPSIS:
-            case Python3Parser::OPEN_PAREN:
-            case Python3Parser::OPEN_BRACK:
-            case Python3Parser::ADD:
-            case Python3Parser::MINUS:
-            case Python3Parser::NOT_OP:
-            case Python3Parser::OPEN_BRACE:
-            case Python3Parser::POWER:
-            case Python3Parser::STAR: {
+        switch (FIRST_ARGLIST.classify(lexer.curr.getType())) {
+            case TokenSet::MEMBER: {
                 const auto argument = parseArgument(lexer);
                 // i'm going to leave as it is until i come up with
                 // something much better
@@ -1114,38 +1171,25 @@ Arguments *parseArglist(PyLexer &lexer) {
 
 Node *parseArgument(PyLexer &lexer) {
     Node *fallback_arg;
-    switch (lexer.curr->getType()) {
-        case Python3Parser::STRING:
-        case Python3Parser::NUMBER:
-        case Python3Parser::LAMBDA:
-        case Python3Parser::NOT:
-        case Python3Parser::NONE:
-        case Python3Parser::TRUE:
-        case Python3Parser::FALSE:
-        case Python3Parser::AWAIT:
-        case Python3Parser::NAME:
-        case Python3Parser::ELLIPSIS:
-        case Python3Parser::OPEN_PAREN:
-        case Python3Parser::OPEN_BRACK:
-        case Python3Parser::ADD:
-        case Python3Parser::MINUS:
-        case Python3Parser::NOT_OP:
-        case Python3Parser::OPEN_BRACE: {
-            const auto arg_name = lexer.curr->getText();
+    switch (FIRST_TEST.classify(lexer.curr.getType())) {
+        case TokenSet::MEMBER: {
+            const auto arg_name = lexer.text(lexer.curr);
+            const auto arg_symbol = lexer.curr.getSymbol();
             fallback_arg = parseTest(lexer);
-            if (lexer.curr->getType() == Python3Parser::ASYNC ||
-                lexer.curr->getType() == Python3Parser::FOR) {
+            if (lexer.curr.getType() == Python3Parser::ASYNC ||
+                lexer.curr.getType() == Python3Parser::FOR) {
                 const auto generator_exp = new GeneratorExp(fallback_arg, {});
-                while (lexer.curr->getType() == Python3Parser::FOR) {
+                while (lexer.curr.getType() == Python3Parser::FOR) {
                     const auto comprehension = parseCompFor(lexer);
                     generator_exp->generators.push_back(comprehension);
                 }
                 return generator_exp;
             }
-            if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+            if (lexer.curr.getType() == Python3Parser::ASSIGN) {
                 lexer.consume(Python3Parser::ASSIGN);
+                // the name is kept as the text and the symbol of the keyword, its node stays in the arena
                 const auto value = parseTest(lexer);
-                const auto keyword = new Keyword(arg_name, value);
+                const auto keyword = new Keyword(arg_name, arg_symbol, value);
                 return keyword;
             }
             break;
@@ -1153,7 +1197,7 @@ Node *parseArgument(PyLexer &lexer) {
         case Python3Parser::POWER: {
             lexer.consume(Python3Parser::POWER);
             const auto value = parseTest(lexer);
-            const auto keyword = new Keyword("", value);
+            const auto keyword = new Keyword("", NO_SYMBOL, value);
             return keyword;
         }
         case Python3Parser::STAR: {
@@ -1163,7 +1207,7 @@ Node *parseArgument(PyLexer &lexer) {
             return keyword;
         }
         default:
-        ERR_MSG_EXIT("Expected STAR, POWER or TEST");
+        ERR_MSG_THROW("Expected STAR, POWER or TEST");
     }
 
     return fallback_arg;
@@ -1174,22 +1218,22 @@ TryStmt *parseTryStmt(PyLexer &lexer) {
     lexer.consume(Python3Parser::COLON);
     auto try_stmt = new TryStmt(nullptr, {}, nullptr, nullptr);
     try_stmt->body = parseSuite(lexer);
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::EXCEPT: {
-            while (lexer.curr->getType() == Python3Parser::EXCEPT) {
+            while (lexer.curr.getType() == Python3Parser::EXCEPT) {
                 auto except_handler = parseExceptClause(lexer);
                 lexer.consume(Python3Parser::COLON);
                 except_handler->body = parseSuite(lexer);
                 try_stmt->handlers.push_back(except_handler);
             }
 
-            if (lexer.curr->getType() == Python3Parser::ELSE) {
+            if (lexer.curr.getType() == Python3Parser::ELSE) {
                 lexer.consume(Python3Parser::ELSE);
                 lexer.consume(Python3Parser::COLON);
                 try_stmt->or_else = parseSuite(lexer);
             }
 
-            if (lexer.curr->getType() == Python3Parser::FINALLY) {
+            if (lexer.curr.getType() == Python3Parser::FINALLY) {
                 lexer.consume(Python3Parser::FINALLY);
                 lexer.consume(Python3Parser::COLON);
                 try_stmt->final_body = parseSuite(lexer);
@@ -1212,7 +1256,7 @@ TryStmt *parseTryStmt(PyLexer &lexer) {
 ExceptHandler *parseExceptClause(PyLexer &lexer) {
     lexer.consume(Python3Parser::EXCEPT);
     auto except_handler = new ExceptHandler(nullptr, "", nullptr);
-    const auto current_type = lexer.curr->getType();
+    const auto current_type = lexer.curr.getType();
     if (current_type == Python3Parser::STRING ||
         current_type == Python3Parser::NUMBER ||
         current_type == Python3Parser::LAMBDA ||
@@ -1232,9 +1276,10 @@ ExceptHandler *parseExceptClause(PyLexer &lexer) {
 
         except_handler->type = parseTest(lexer);
 
-        if (lexer.curr->getType() == Python3Parser::AS) {
+        if (lexer.curr.getType() == Python3Parser::AS) {
             lexer.consume(Python3Parser::AS);
-            except_handler->name = lexer.curr->getText();
+            except_handler->name = lexer.text(lexer.curr);
+            except_handler->name_symbol = lexer.curr.getSymbol();
             lexer.consume(Python3Parser::NAME);
         }
     }
@@ -1247,9 +1292,11 @@ Node *parseDecorator(PyLexer &lexer) {
     lexer.consume(Python3Parser::AT);
     auto call = new Call(nullptr, nullptr);
     call->func = parseDottedName(lexer, false);
-    if (lexer.curr->getType() == Python3Parser::OPEN_PAREN) {
+    if (lexer.curr.getType() == Python3Parser::OPEN_PAREN) {
         lexer.consume(Python3Parser::OPEN_PAREN);
-        call->arguments = parseArglist(lexer);
+        if (lexer.curr.getType() != Python3Parser::CLOSE_PAREN) {
+            call->arguments = parseArglist(lexer);
+        }
         lexer.consume(Python3Parser::CLOSE_PAREN);
     }
 
@@ -1258,9 +1305,9 @@ Node *parseDecorator(PyLexer &lexer) {
     return call;
 }
 
-std::vector<Node *> parseDecorators(PyLexer &lexer) {
-    std::vector<Node *> decorators;
-    while (lexer.curr->getType() == Python3Parser::AT) {
+NodeList parseDecorators(PyLexer &lexer) {
+    NodeList decorators;
+    while (lexer.curr.getType() == Python3Parser::AT) {
         decorators.push_back(parseDecorator(lexer));
     }
 
@@ -1270,22 +1317,21 @@ std::vector<Node *> parseDecorators(PyLexer &lexer) {
 Node *parseDecorated(PyLexer &lexer) {
     auto decorator_list = parseDecorators(lexer);
 
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::CLASS:
-            return parseClassDef(lexer, std::forward<std::vector<Node *>>(decorator_list));
+            return parseClassDef(lexer, std::move(decorator_list));
         case Python3Parser::ASYNC:
             return parseAsyncFuncDef(lexer, decorator_list);
         case Python3Parser::DEF:
-            return parseFuncDef(lexer, std::forward<std::vector<Node *>>(decorator_list));
+            return parseFuncDef(lexer, std::move(decorator_list));
         default:
-        ERR_MSG_EXIT("Expected CLASS, ASYNC or DEF");
+        ERR_MSG_THROW("Expected CLASS, ASYNC or DEF");
     }
 }
 
 Node *parseAsyncStmt(PyLexer &lexer) {
-    lexer.consume(Python3Parser::ASYNC);
-
-    switch (lexer.curr->getType()) {
+    // ASYNC is consumed by the one that parses the statement
+    switch (lexer.next.getType()) {
         case Python3Parser::DEF:
             return parseAsyncFuncDef(lexer, {});
         case Python3Parser::WITH:
@@ -1293,14 +1339,14 @@ Node *parseAsyncStmt(PyLexer &lexer) {
         case Python3Parser::FOR:
             return parseAsyncForStmt(lexer);
         default:
-        ERR_MSG_EXIT("Expected DEF, WITH or FOR");
+        ERR_MSG_THROW("Expected DEF, WITH or FOR");
     }
 }
 
-AsyncFuncDef *parseAsyncFuncDef(PyLexer &lexer, std::vector<Node *> &decorator_list) {
+AsyncFuncDef *parseAsyncFuncDef(PyLexer &lexer, NodeList &decorator_list) {
     lexer.consume(Python3Parser::ASYNC);
     const auto async_func_def = new AsyncFuncDef(
-            parseFuncDef(lexer, std::forward<std::vector<Node *>>(decorator_list)), true);
+            parseFuncDef(lexer, std::move(decorator_list)), true);
     return async_func_def;
 }
 
@@ -1316,19 +1362,95 @@ AsyncWithStmt *parseAsyncWithStmt(PyLexer &lexer) {
     return async_with_stmt;
 }
 
-Node *parseOrTest(PyLexer &lexer) {
-    auto node = parseAndTest(lexer);
+// The binding powers of the binary operators, indexed by token type. The comparison operators
+// are missing, some of them take two tokens and are recognized by isCompOp instead.
+static constexpr std::array<Precedence, TokenSet::MEMBER> makeBinaryPrecedences() {
+    std::array<Precedence, TokenSet::MEMBER> precedences{};
+    precedences[Python3Parser::OR] = Precedence::OR_TEST;
+    precedences[Python3Parser::AND] = Precedence::AND_TEST;
+    precedences[Python3Parser::OR_OP] = Precedence::EXPR;
+    precedences[Python3Parser::XOR] = Precedence::XOR_EXPR;
+    precedences[Python3Parser::AND_OP] = Precedence::AND_EXPR;
+    precedences[Python3Parser::LEFT_SHIFT] = Precedence::SHIFT_EXPR;
+    precedences[Python3Parser::RIGHT_SHIFT] = Precedence::SHIFT_EXPR;
+    precedences[Python3Parser::ADD] = Precedence::ARITH_EXPR;
+    precedences[Python3Parser::MINUS] = Precedence::ARITH_EXPR;
+    precedences[Python3Parser::STAR] = Precedence::TERM;
+    precedences[Python3Parser::DIV] = Precedence::TERM;
+    precedences[Python3Parser::IDIV] = Precedence::TERM;
+    precedences[Python3Parser::MOD] = Precedence::TERM;
+    precedences[Python3Parser::POWER] = Precedence::POWER;
+    return precedences;
+}
 
-    while (lexer.curr->getType() == Python3Parser::OR) {
-        lexer.consume(Python3Parser::OR);
+static constexpr auto BINARY_PRECEDENCES = makeBinaryPrecedences();
+
+static inline Precedence binaryPrecedence(size_t token_type) {
+    return token_type < BINARY_PRECEDENCES.size() ? BINARY_PRECEDENCES[token_type] : Precedence::NONE;
+}
 
-        const auto rhs = parseAndTest(lexer);
-        node = new BoolOp(node, rhs, Python3Parser::OR);
+static inline Precedence tighter(Precedence precedence) {
+    return static_cast<Precedence>(static_cast<uint8_t>(precedence) + 1);
+}
+
+// Precedence climbing over or_test down to power, a bare atom costs a single table lookup
+// instead of a call per grammar level. Builds the same trees the recursive descent did:
+// BoolOp, BinOp and Comparison nest to the left, except for '**', whose right operand is a factor.
+Node *parseBinary(PyLexer &lexer, Precedence min_precedence) {
+    const NestingGuard guard(lexer);
+    Node *node;
+    const auto op = lexer.curr.getType();
+    if (op == Python3Parser::NOT && min_precedence <= Precedence::NOT_TEST) {
+        // not_test: 'not' not_test
+        lexer.consume(Python3Parser::NOT);
+        node = new UnaryOp(Python3Parser::NOT, parseBinary(lexer, Precedence::NOT_TEST));
+    } else if (min_precedence <= Precedence::NOT_TEST && !FIRST_COMPARISON.contains(op)) {
+        ERR_MSG_THROW("expected NOT or EXPR");
+    } else if ((op == Python3Parser::ADD || op == Python3Parser::MINUS || op == Python3Parser::NOT_OP) &&
+               min_precedence <= Precedence::FACTOR) {
+        // factor: ('+'|'-'|'~') factor
+        lexer.consume(op);
+        node = new UnaryOp(op, parseBinary(lexer, Precedence::FACTOR));
+    } else {
+        node = parseAtomExpr(lexer);
+    }
+
+    bool eat_twice{false};
+    int32_t comp_op;
+    while (true) {
+        if (min_precedence <= Precedence::COMPARISON && isCompOp(lexer, eat_twice, comp_op)) {
+            lexer.consume(lexer.curr.getType());
+            if (eat_twice)
+                lexer.consume(lexer.curr.getType());
+            const auto rhs = parseBinary(lexer, tighter(Precedence::COMPARISON));
+            node = new Comparison(node, rhs, comp_op);
+            continue;
+        }
+
+        const auto bin_op = lexer.curr.getType();
+        const auto precedence = binaryPrecedence(bin_op);
+        if (precedence == Precedence::NONE || precedence < min_precedence) {
+            break;
+        }
+
+        lexer.consume(bin_op);
+        if (precedence == Precedence::POWER) {
+            // power: atom_expr ('**' factor)?
+            node = new BinOp(node, parseBinary(lexer, Precedence::FACTOR), bin_op);
+        } else if (precedence <= Precedence::AND_TEST) {
+            node = new BoolOp(node, parseBinary(lexer, tighter(precedence)), bin_op);
+        } else {
+            node = new BinOp(node, parseBinary(lexer, tighter(precedence)), bin_op);
+        }
     }
 
     return node;
 }
 
+Node *parseOrTest(PyLexer &lexer) {
+    return parseBinary(lexer, Precedence::OR_TEST);
+}
+
 ForStmt *parseForStmt(PyLexer &lexer) {
     const auto pos_info = getTokPos(lexer.curr);
     lexer.consume(Python3Parser::FOR);
@@ -1341,7 +1463,7 @@ ForStmt *parseForStmt(PyLexer &lexer) {
     lexer.consume(Python3Parser::COLON);
     for_stmt->body = parseSuite(lexer);
 
-    if (lexer.curr->getType() == Python3Parser::ELSE) {
+    if (lexer.curr.getType() == Python3Parser::ELSE) {
         lexer.consume(Python3Parser::ELSE);
         lexer.consume(Python3Parser::COLON);
         for_stmt->or_else = parseSuite(lexer);
@@ -1351,56 +1473,17 @@ ForStmt *parseForStmt(PyLexer &lexer) {
 }
 
 Node *parseAndTest(PyLexer &lexer) {
-    auto node = parseNotTest(lexer);
-
-    while (lexer.curr->getType() == Python3Parser::AND) {
-        lexer.consume(Python3Parser::AND);
-
-        const auto rhs = parseNotTest(lexer);
-        node = new BoolOp(node, rhs, Python3Parser::AND);
-    }
-
-    return node;
+    return parseBinary(lexer, Precedence::AND_TEST);
 }
 
 Node *parseNotTest(PyLexer &lexer) {
-    Node *node;
-    switch (lexer.curr->getType()) {
-        case Python3Parser::NOT: {
-            lexer.consume(Python3Parser::NOT);
-            const auto expr = parseNotTest(lexer);
-            node = new UnaryOp(Python3Parser::NOT, expr);
-            break;
-        }
-        case Python3Parser::STRING:
-        case Python3Parser::NUMBER:
-        case Python3Parser::NONE:
-        case Python3Parser::TRUE:
-        case Python3Parser::FALSE:
-        case Python3Parser::AWAIT:
-        case Python3Parser::NAME:
-        case Python3Parser::ELLIPSIS:
-        case Python3Parser::OPEN_PAREN:
-        case Python3Parser::OPEN_BRACK:
-        case Python3Parser::ADD:
-        case Python3Parser::MINUS:
-        case Python3Parser::NOT_OP:
-        case Python3Parser::OPEN_BRACE: {
-            node = parseComparison(lexer);
-            break;
-        }
-        default: {
-            ERR_MSG_EXIT("expected NOT or EXPR");
-        }
-    }
-
-    return node;
+    return parseBinary(lexer, Precedence::NOT_TEST);
 }
 
 Node *parseLambDef(PyLexer &lexer) {
     lexer.consume(Python3Parser::LAMBDA);
     auto lambda = new Lambda(nullptr, nullptr);
-    const auto current_type = lexer.curr->getType();
+    const auto current_type = lexer.curr.getType();
     if (current_type == Python3Parser::NAME ||
         current_type == Python3Parser::STAR ||
         current_type == Python3Parser::POWER) {
@@ -1413,9 +1496,14 @@ Node *parseLambDef(PyLexer &lexer) {
 }
 
 Node *parseTest(PyLexer &lexer) {
+    const NestingGuard guard(lexer);
+    if (lexer.curr.getType() == Python3Parser::LAMBDA) {
+        return parseLambDef(lexer);
+    }
+
     auto node = parseOrTest(lexer);
 
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::IF: {
             lexer.consume(Python3Parser::IF);
             const auto if_test = parseOrTest(lexer);
@@ -1424,33 +1512,20 @@ Node *parseTest(PyLexer &lexer) {
             node = new IfStmt(if_test, node, else_body);
             break;
         }
-        case Python3Parser::LAMBDA:
-            node = parseLambDef(lexer);
-            break;
     }
 
     return node;
 }
 
 Node *parseExpr(PyLexer &lexer) {
-    auto xor_expr = parseXorExpr(lexer);
-
-    while (lexer.curr->getType() == Python3Parser::OR_OP) {
-        lexer.consume(Python3Parser::OR_OP);
-
-        const auto rhs = parseXorExpr(lexer);
-
-        xor_expr = new BinOp(xor_expr, rhs, Python3Parser::OR_OP);
-    }
-
-    return xor_expr;
+    return parseBinary(lexer, Precedence::EXPR);
 }
 
 // testlist_star_expr: (test|star_expr) (',' (test|star_expr))* (',')?;
 TestList *parseTestlistStarExpr(PyLexer &lexer) {
     auto test_list = new TestList({});
     Node *expr;
-    if (lexer.curr->getType() == Python3Parser::STAR) {
+    if (lexer.curr.getType() == Python3Parser::STAR) {
         expr = parseStarExpr(lexer);
     } else {
         expr = parseTest(lexer);
@@ -1458,40 +1533,25 @@ TestList *parseTestlistStarExpr(PyLexer &lexer) {
 
     test_list->nodes.push_back(expr);
 
-    while (lexer.curr->getType() == Python3Parser::COMMA &&
-           (lexer.next->getType() == Python3Parser::STAR || isTest(lexer.next))) {
+    while (lexer.curr.getType() == Python3Parser::COMMA &&
+           (lexer.next.getType() == Python3Parser::STAR || isTest(lexer.next))) {
         lexer.consume(Python3Parser::COMMA);
-        switch (lexer.curr->getType()) {
+        switch (FIRST_TEST.classify(lexer.curr.getType())) {
             case Python3Parser::STAR: {
                 test_list->nodes.push_back(parseStarExpr(lexer));
                 break;
             }
-            case Python3Parser::STRING:
-            case Python3Parser::NUMBER:
-            case Python3Parser::LAMBDA:
-            case Python3Parser::NOT:
-            case Python3Parser::NONE:
-            case Python3Parser::TRUE:
-            case Python3Parser::FALSE:
-            case Python3Parser::AWAIT:
-            case Python3Parser::NAME:
-            case Python3Parser::ELLIPSIS:
-            case Python3Parser::OPEN_PAREN:
-            case Python3Parser::OPEN_BRACK:
-            case Python3Parser::ADD:
-            case Python3Parser::MINUS:
-            case Python3Parser::NOT_OP:
-            case Python3Parser::OPEN_BRACE: {
+            case TokenSet::MEMBER: {
                 test_list->nodes.push_back(parseTest(lexer));
                 break;
             }
             default: {
-                ERR_MSG_EXIT("expected STAR or TEST");
+                ERR_MSG_THROW("expected STAR or TEST");
             }
         }
     }
 
-    if (lexer.curr->getType() == Python3Parser::COMMA) {
+    if (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
     }
 
@@ -1505,12 +1565,13 @@ Global *parseGlobalStmt(PyLexer &lexer) {
 
     const auto current_token = lexer.curr;
     lexer.consume(Python3Parser::NAME);
-    const auto name = new Name(current_token->getText());
+    const auto name = new Name(lexer.text(current_token), current_token.getSymbol());
 
     global->names.push_back(name);
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
-        const auto name = new Name(lexer.curr->getText());
+        const auto name = new Name(lexer.text(lexer.curr), lexer.curr.getSymbol());
+        lexer.consume(Python3Parser::NAME);
         global->names.push_back(name);
     }
 
@@ -1524,12 +1585,13 @@ Nonlocal *parseNonlocalStmt(PyLexer &lexer) {
 
     const auto current_token = lexer.curr;
     lexer.consume(Python3Parser::NAME);
-    const auto name = new Name(current_token->getText());
+    const auto name = new Name(lexer.text(current_token), current_token.getSymbol());
 
     nonlocal->names.push_back(name);
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
-        const auto name = new Name(lexer.curr->getText());
+        const auto name = new Name(lexer.text(lexer.curr), lexer.curr.getSymbol());
+        lexer.consume(Python3Parser::NAME);
         nonlocal->names.push_back(name);
     }
 
@@ -1541,7 +1603,7 @@ Nonlocal *parseNonlocalStmt(PyLexer &lexer) {
 Node *parseExprStmt(PyLexer &lexer) {
     const auto test_list_star_expr = parseTestlistStarExpr(lexer);
 
-    switch (lexer.curr->getType()) {
+    switch (FIRST_AUGASSIGN.classify(lexer.curr.getType())) {
         case Python3Parser::COLON: {
             const auto ann_assign = parseAnnAssign(lexer);
             ann_assign->target = test_list_star_expr;
@@ -1550,9 +1612,9 @@ Node *parseExprStmt(PyLexer &lexer) {
         case Python3Parser::ASSIGN: {
             auto assign = new Assign(nullptr, nullptr);
             assign->targets = test_list_star_expr;
-            while (lexer.curr->getType() == Python3Parser::ASSIGN) {
+            while (lexer.curr.getType() == Python3Parser::ASSIGN) {
                 lexer.consume(Python3Parser::ASSIGN);
-                if (lexer.curr->getType() == Python3Parser::YIELD) {
+                if (lexer.curr.getType() == Python3Parser::YIELD) {
                     assign->value = parseYieldExpr(lexer);
                 } else {
                     assign->value = parseTestlistStarExpr(lexer);
@@ -1560,24 +1622,12 @@ Node *parseExprStmt(PyLexer &lexer) {
             }
             return assign;
         }
-        case Python3Parser::ADD_ASSIGN:
-        case Python3Parser::SUB_ASSIGN:
-        case Python3Parser::MULT_ASSIGN:
-        case Python3Parser::AT_ASSIGN:
-        case Python3Parser::DIV_ASSIGN:
-        case Python3Parser::MOD_ASSIGN:
-        case Python3Parser::AND_ASSIGN:
-        case Python3Parser::OR_ASSIGN:
-        case Python3Parser::XOR_ASSIGN:
-        case Python3Parser::LEFT_SHIFT_ASSIGN:
-        case Python3Parser::RIGHT_SHIFT_ASSIGN:
-        case Python3Parser::POWER_ASSIGN:
-        case Python3Parser::IDIV_ASSIGN: {
-            auto aug_assign = new AugAssign(nullptr, lexer.curr->getType(), nullptr);
+        case TokenSet::MEMBER: {
+            auto aug_assign = new AugAssign(nullptr, lexer.curr.getType(), nullptr);
             aug_assign->target = test_list_star_expr;
-            lexer.consume(lexer.curr->getType());
+            lexer.consume(lexer.curr.getType());
             Node *value;
-            if (lexer.curr->getType() == Python3Parser::YIELD) {
+            if (lexer.curr.getType() == Python3Parser::YIELD) {
                 value = parseYieldExpr(lexer);
             } else {
                 value = parseTestList(lexer);
@@ -1600,7 +1650,7 @@ AnnAssign *parseAnnAssign(PyLexer &lexer) {
     const auto annotation = parseTest(lexer);
 
     ann_assign->annotation = annotation;
-    if (lexer.curr->getType() == Python3Parser::ASSIGN) {
+    if (lexer.curr.getType() == Python3Parser::ASSIGN) {
         lexer.consume(Python3Parser::ASSIGN);
 
         const auto value = parseTest(lexer);
@@ -1614,18 +1664,18 @@ TestList *parseTestListStarExpr(PyLexer &lexer) {
     TestList *test_list = new TestList({});
 
     Node *node;
-    if (lexer.curr->getType() == Python3Parser::STAR) {
+    if (lexer.curr.getType() == Python3Parser::STAR) {
         node = parseStarExpr(lexer);
     } else {
         node = parseTest(lexer);
     }
 
     test_list->nodes.push_back(node);
-    while (lexer.curr->getType() == Python3Parser::COMMA) {
+    while (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
 
         Node *n;
-        if (lexer.curr->getType() == Python3Parser::STAR) {
+        if (lexer.curr.getType() == Python3Parser::STAR) {
             n = parseStarExpr(lexer);
         } else {
             n = parseTest(lexer);
@@ -1646,94 +1696,41 @@ StarredExpr *parseStarExpr(PyLexer &lexer) {
 }
 
 Node *parseXorExpr(PyLexer &lexer) {
-    auto node = parseAndExpr(lexer);
-
-    while (lexer.curr->getType() == Python3Parser::XOR) {
-        lexer.consume(Python3Parser::XOR);
-
-        const auto rhs = parseAndExpr(lexer);
-
-        node = new BinOp(node, rhs, Python3Parser::XOR);
-    }
-
-    return node;
+    return parseBinary(lexer, Precedence::XOR_EXPR);
 }
 
-
 Node *parseAndExpr(PyLexer &lexer) {
-    auto node = parseShiftExpr(lexer);
-
-    while (lexer.curr->getType() == Python3Parser::AND_OP) {
-        lexer.consume(Python3Parser::AND_OP);
-
-        const auto rhs = parseShiftExpr(lexer);
-
-        node = new BinOp(node, rhs, Python3Parser::AND_OP);
-    }
-
-    return node;
+    return parseBinary(lexer, Precedence::AND_EXPR);
 }
 
 Node *parseShiftExpr(PyLexer &lexer) {
-    auto node = parseArithExpr(lexer);
-
-    while (lexer.curr->getType() == Python3Parser::LEFT_SHIFT ||
-           lexer.curr->getType() == Python3Parser::RIGHT_SHIFT) {
-        const auto current_token = lexer.curr;
-        lexer.consume(current_token->getType());
-
-        const auto rhs = parseArithExpr(lexer);
-        node = new BinOp(node, rhs, current_token->getType());
-    }
-
-    return node;
+    return parseBinary(lexer, Precedence::SHIFT_EXPR);
 }
 
 Node *parseComparison(PyLexer &lexer) {
-    auto node = parseExpr(lexer);
-
-    bool eat_twice{false};
-    int32_t op;
-    while (isCompOp(lexer, eat_twice, op)) {
-        lexer.consume(lexer.curr->getType());
-        if (eat_twice)
-            lexer.consume(lexer.curr->getType());
-        const auto rhs = parseExpr(lexer);
-        node = new Comparison(node, rhs, op);
-    }
-
-    return node;
+    return parseBinary(lexer, Precedence::COMPARISON);
 }
 
 // power: atom_expr ('**' factor)?;
 Node *parsePower(PyLexer &lexer) {
-    auto node = parseAtomExpr(lexer);
-
-    while (lexer.curr->getType() == Python3Parser::POWER) {
-        lexer.consume(Python3Parser::POWER);
-        auto rhs = parseFactor(lexer);
-
-        node = new BinOp(node, rhs, Python3Parser::POWER);
-    }
-
-    return node;
+    return parseBinary(lexer, Precedence::POWER);
 }
 
 Node *parseAtomExpr(PyLexer &lexer) {
-    if (lexer.curr->getType() == Python3Parser::AWAIT) {
+    if (lexer.curr.getType() == Python3Parser::AWAIT) {
         lexer.consume(Python3Parser::AWAIT);
     }
 
     auto atom = parseAtom(lexer);
-    while (lexer.curr->getType() == Python3Parser::DOT ||
-           lexer.curr->getType() == Python3Parser::OPEN_PAREN ||
-           lexer.curr->getType() == Python3Parser::OPEN_BRACK) {
+    while (lexer.curr.getType() == Python3Parser::DOT ||
+           lexer.curr.getType() == Python3Parser::OPEN_PAREN ||
+           lexer.curr.getType() == Python3Parser::OPEN_BRACK) {
 
-        switch (lexer.curr->getType()) {
+        switch (lexer.curr.getType()) {
             case Python3Parser::OPEN_PAREN: {
                 lexer.consume(Python3Parser::OPEN_PAREN);
                 auto call = new Call(atom, nullptr);
-                if (lexer.curr->getType() != Python3Parser::CLOSE_PAREN)
+                if (lexer.curr.getType() != Python3Parser::CLOSE_PAREN)
                     call->arguments = parseArglist(lexer);
                 lexer.consume(Python3Parser::CLOSE_PAREN);
                 atom = call;
@@ -1752,12 +1749,12 @@ Node *parseAtomExpr(PyLexer &lexer) {
                 auto attribute = new Attribute(atom, nullptr);
                 const auto current_token = lexer.curr;
                 lexer.consume(Python3Parser::NAME);
-                attribute->attr = new Name(current_token->getText());
+                attribute->attr = new Name(lexer.text(current_token), current_token.getSymbol());
                 atom = attribute;
                 break;
             }
             default:
-            ERR_MSG_EXIT("Expected OPEN_PAREN, OPEN_BRACK or DOT");
+            ERR_MSG_THROW("Expected OPEN_PAREN, OPEN_BRACK or DOT");
         }
     }
 
@@ -1766,27 +1763,12 @@ Node *parseAtomExpr(PyLexer &lexer) {
 
 static Node *parseTestlistCompCommaSeparated(Node *value, PyLexer &lexer) {
     auto list = new List({value});
-    while (lexer.curr->getType() == Python3Parser::COMMA &&
-           (isTest(lexer.next) || lexer.next->getType() == Python3Parser::STAR)) {
+    while (lexer.curr.getType() == Python3Parser::COMMA &&
+           (isTest(lexer.next) || lexer.next.getType() == Python3Parser::STAR)) {
         lexer.consume(Python3Parser::COMMA);
 
-        switch (lexer.curr->getType()) {
-            case Python3Parser::STRING:
-            case Python3Parser::NUMBER:
-            case Python3Parser::LAMBDA:
-            case Python3Parser::NOT:
-            case Python3Parser::NONE:
-            case Python3Parser::TRUE:
-            case Python3Parser::FALSE:
-            case Python3Parser::AWAIT:
-            case Python3Parser::NAME:
-            case Python3Parser::ELLIPSIS:
-            case Python3Parser::OPEN_PAREN:
-            case Python3Parser::OPEN_BRACK:
-            case Python3Parser::ADD:
-            case Python3Parser::MINUS:
-            case Python3Parser::NOT_OP:
-            case Python3Parser::OPEN_BRACE: {
+        switch (FIRST_TEST.classify(lexer.curr.getType())) {
+            case TokenSet::MEMBER: {
                 list->elements.push_back(parseTest(lexer));
                 break;
             }
@@ -1795,40 +1777,25 @@ static Node *parseTestlistCompCommaSeparated(Node *value, PyLexer &lexer) {
                 break;
             }
             default: {
-                if (lexer.curr->getType() == Python3Parser::CLOSE_BRACE) {
+                if (lexer.curr.getType() == Python3Parser::CLOSE_BRACE) {
                     break;
                 } else {
-                    ERR_MSG_EXIT("expected TEST or STAR");
+                    ERR_MSG_THROW("expected TEST or STAR");
                 }
             }
         }
     }
-    if (lexer.curr->getType() == Python3Parser::COMMA) {
+    if (lexer.curr.getType() == Python3Parser::COMMA) {
         lexer.consume(Python3Parser::COMMA);
     }
 
     return list;
 }
 
-Node *parseTestlistComp(PyLexer &lexer) {
+Node *parseTestlistComp(PyLexer &lexer, bool is_parenthesized) {
     Node *node;
-    switch (lexer.curr->getType()) {
-        case Python3Parser::STRING:
-        case Python3Parser::NUMBER:
-        case Python3Parser::LAMBDA:
-        case Python3Parser::NOT:
-        case Python3Parser::NONE:
-        case Python3Parser::TRUE:
-        case Python3Parser::FALSE:
-        case Python3Parser::AWAIT:
-        case Python3Parser::NAME:
-        case Python3Parser::ELLIPSIS:
-        case Python3Parser::OPEN_PAREN:
-        case Python3Parser::OPEN_BRACK:
-        case Python3Parser::ADD:
-        case Python3Parser::MINUS:
-        case Python3Parser::NOT_OP:
-        case Python3Parser::OPEN_BRACE: {
+    switch (FIRST_TEST.classify(lexer.curr.getType())) {
+        case TokenSet::MEMBER: {
             node = parseTest(lexer);
             break;
         }
@@ -1837,72 +1804,69 @@ Node *parseTestlistComp(PyLexer &lexer) {
             break;
         }
         default: {
-            ERR_MSG_EXIT("expected TEST or STAR");
+            ERR_MSG_THROW("expected TEST or STAR");
         }
     }
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::FOR:
         case Python3Parser::ASYNC: {
-            node = new ListComp(node, {});
-            while (lexer.curr->getType() == Python3Parser::ASYNC ||
-                   lexer.curr->getType() == Python3Parser::FOR) {
-
-                auto comprehension = parseCompFor(lexer);
-                dynamic_cast<ListComp *>(node)->generators.push_back(comprehension);
+            NodeList generators;
+            while (lexer.curr.getType() == Python3Parser::ASYNC ||
+                   lexer.curr.getType() == Python3Parser::FOR) {
+                generators.push_back(parseCompFor(lexer));
+            }
+            if (is_parenthesized) {
+                node = new GeneratorExp(node, std::move(generators));
+            } else {
+                node = new ListComp(node, std::move(generators));
             }
             break;
         }
         case Python3Parser::CLOSE_PAREN:
         case Python3Parser::COMMA:
         case Python3Parser::CLOSE_BRACK: {
-            node = new List({node});
-            while (lexer.curr->getType() == Python3Parser::COMMA &&
-                   (isTest(lexer.next) || lexer.next->getType() == Python3Parser::STAR)) {
+            if (is_parenthesized && lexer.curr.getType() != Python3Parser::COMMA) {
+                // just an expression in parentheses
+                break;
+            }
+            NodeList elements{node};
+            while (lexer.curr.getType() == Python3Parser::COMMA &&
+                   (isTest(lexer.next) || lexer.next.getType() == Python3Parser::STAR)) {
                 lexer.consume(Python3Parser::COMMA);
-                switch (lexer.curr->getType()) {
-                    case Python3Parser::STRING:
-                    case Python3Parser::NUMBER:
-                    case Python3Parser::LAMBDA:
-                    case Python3Parser::NOT:
-                    case Python3Parser::NONE:
-                    case Python3Parser::TRUE:
-                    case Python3Parser::FALSE:
-                    case Python3Parser::AWAIT:
-                    case Python3Parser::NAME:
-                    case Python3Parser::ELLIPSIS:
-                    case Python3Parser::OPEN_PAREN:
-                    case Python3Parser::OPEN_BRACK:
-                    case Python3Parser::ADD:
-                    case Python3Parser::MINUS:
-                    case Python3Parser::NOT_OP:
-                    case Python3Parser::OPEN_BRACE: {
-                        dynamic_cast<List *>(node)->elements.push_back(parseTest(lexer));
+                switch (FIRST_TEST.classify(lexer.curr.getType())) {
+                    case TokenSet::MEMBER: {
+                        elements.push_back(parseTest(lexer));
                         break;
                     }
                     case Python3Parser::STAR: {
-                        dynamic_cast<List *>(node)->elements.push_back(parseStarExpr(lexer));
+                        elements.push_back(parseStarExpr(lexer));
                         break;
                     }
                     default: {
-                        ERR_MSG_EXIT("Expected TEST or STAR");
+                        ERR_MSG_THROW("Expected TEST or STAR");
                     }
                 }
             }
 
-            if (lexer.curr->getType() == Python3Parser::COMMA) {
+            if (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
             }
+
+            if (is_parenthesized) {
+                node = new TestList(std::move(elements));
+            } else {
+                node = new List(std::move(elements));
+            }
         }
     }
 
     return node;
 }
 
-
 // testlist_comp: (test|star_expr) ( comp_for | (',' (test|star_expr))* (',')? );
 //Node *parseTestlistComp(PyLexer &lexer) {
 //    std::cout << lexer.curr->getText() << '\n';
-//    switch (lexer.curr->getType()) {
+//    switch (lexer.curr.getType()) {
 //        case Python3Parser::STRING:
 //        case Python3Parser::NUMBER:
 //        case Python3Parser::LAMBDA:
@@ -1921,13 +1885,13 @@ Node *parseTestlistComp(PyLexer &lexer) {
 //        case Python3Parser::OPEN_BRACE: {
 //            const auto value = parseTest(lexer);
 //
-//            switch (lexer.curr->getType()) {
+//            switch (lexer.curr.getType()) {
 //                case Python3Parser::ASYNC:
 //                case Python3Parser::FOR: {
 //                    auto list_comp = new ListComp(value, {});
 //
-//                    while (lexer.curr->getType() == Python3Parser::ASYNC ||
-//                           lexer.curr->getType() == Python3Parser::FOR) {
+//                    while (lexer.curr.getType() == Python3Parser::ASYNC ||
+//                           lexer.curr.getType() == Python3Parser::FOR) {
 //
 //                        const auto comprehension = parseCompFor(lexer);
 //                        list_comp->generators.push_back(comprehension);
@@ -1946,26 +1910,26 @@ Node *parseTestlistComp(PyLexer &lexer) {
 //            return parseTestlistCompCommaSeparated(value, lexer);
 //        }
 //        default:
-//        ERR_MSG_EXIT("Expected TEST or STAR");
+//        ERR_MSG_THROW("Expected TEST or STAR");
 //    }
 //}
 
 Subscript *parseSubscriptList(PyLexer &lexer) {
     auto subscript = parseSubscript(lexer);
 
-    if (lexer.curr->getType() == Python3Parser::COMMA) {
+    if (lexer.curr.getType() == Python3Parser::COMMA) {
         auto ext_slice = new ExtSlice({subscript->slice});
-        while (lexer.curr->getType() == Python3Parser::COMMA && isTest(lexer.next)) {
+        while (lexer.curr.getType() == Python3Parser::COMMA && isTest(lexer.next)) {
             lexer.consume(Python3Parser::COMMA);
 
             const auto value = parseTest(lexer);
-            if (lexer.curr->getType() == Python3Lexer::COLON) {
+            if (lexer.curr.getType() == Python3Lexer::COLON) {
                 lexer.consume(Python3Parser::COLON);
                 auto slice = new Slice(value, nullptr, nullptr);
                 if (isTest(lexer.curr)) {
                     slice->upper = parseTest(lexer);
                 }
-                if (lexer.curr->getType() == Python3Parser::COLON) {
+                if (lexer.curr.getType() == Python3Parser::COLON) {
                     lexer.consume(Python3Parser::COLON);
 
                     if (isTest(lexer.curr)) {
@@ -1977,7 +1941,7 @@ Subscript *parseSubscriptList(PyLexer &lexer) {
                 ext_slice->dims.push_back(new Index(value));
             }
         }
-        if (lexer.curr->getType() == Python3Parser::COMMA) {
+        if (lexer.curr.getType() == Python3Parser::COMMA) {
             lexer.consume(Python3Parser::COMMA);
         }
 
@@ -1992,13 +1956,13 @@ Subscript *parseSubscript(PyLexer &lexer) {
     if (isTest(lexer.curr)) {
         subscript = new Subscript(nullptr, nullptr);
         const auto value = parseTest(lexer);
-        if (lexer.curr->getType() == Python3Lexer::COLON) {
+        if (lexer.curr.getType() == Python3Lexer::COLON) {
             lexer.consume(Python3Parser::COLON);
             auto slice = new Slice(value, nullptr, nullptr);
             if (isTest(lexer.curr)) {
                 slice->upper = parseTest(lexer);
             }
-            if (lexer.curr->getType() == Python3Parser::COLON) {
+            if (lexer.curr.getType() == Python3Parser::COLON) {
                 lexer.consume(Python3Parser::COLON);
 
                 if (isTest(lexer.curr)) {
@@ -2010,14 +1974,14 @@ Subscript *parseSubscript(PyLexer &lexer) {
             subscript->slice = new Index(value);
         }
         return subscript;
-    } else if (lexer.curr->getType() == Python3Parser::COLON) {
+    } else if (lexer.curr.getType() == Python3Parser::COLON) {
         lexer.consume(Python3Parser::COLON);
         subscript = new Subscript(nullptr, nullptr);
         auto slice = new Slice(nullptr, nullptr, nullptr);
         if (isTest(lexer.curr)) {
             slice->upper = parseTest(lexer);
         }
-        if (lexer.curr->getType() == Python3Parser::COLON) {
+        if (lexer.curr.getType() == Python3Parser::COLON) {
             lexer.consume(Python3Parser::COLON);
 
             if (isTest(lexer.curr)) {
@@ -2025,44 +1989,31 @@ Subscript *parseSubscript(PyLexer &lexer) {
             }
         }
         subscript->slice = slice;
+        return subscript;
     } else {
-        ERR_MSG_EXIT("expected TEST or COLON");
+        ERR_MSG_THROW("expected TEST or COLON");
     }
 }
 
 Node *parseAtom(PyLexer &lexer) {
     Node *node;
     const auto current_token = lexer.curr;
-    switch (current_token->getType()) {
+    switch (current_token.getType()) {
         case Python3Parser::OPEN_PAREN: {
             lexer.consume(Python3Parser::OPEN_PAREN);
 
-            switch (lexer.curr->getType()) {
+            switch (FIRST_TESTLIST_COMP.classify(lexer.curr.getType())) {
                 case Python3Parser::YIELD: {
                     node = parseYieldExpr(lexer);
                     break;
                 }
-                case Python3Parser::STRING:
-                case Python3Parser::NUMBER:
-                case Python3Parser::LAMBDA:
-                case Python3Parser::NOT:
-                case Python3Parser::NONE:
-                case Python3Parser::TRUE:
-                case Python3Parser::FALSE:
-                case Python3Parser::AWAIT:
-                case Python3Parser::NAME:
-                case Python3Parser::ELLIPSIS:
-                case Python3Parser::OPEN_PAREN:
-                case Python3Parser::OPEN_BRACK:
-                case Python3Parser::ADD:
-                case Python3Parser::MINUS:
-                case Python3Parser::NOT_OP:
-                case Python3Parser::OPEN_BRACE:
-                case Python3Parser::STAR: {
-                    node = parseTestlistComp(lexer);
+                case TokenSet::MEMBER: {
+                    node = parseTestlistComp(lexer, true);
                     break;
                 }
                 default:
+                    // empty tuple
+                    node = new TestList({});
                     break;
             }
             lexer.consume(Python3Parser::CLOSE_PAREN);
@@ -2081,24 +2032,8 @@ Node *parseAtom(PyLexer &lexer) {
         case Python3Parser::OPEN_BRACE: {
             lexer.consume(Python3Parser::OPEN_BRACE);
 
-            switch (lexer.curr->getType()) {
-                case Python3Parser::STRING:
-                case Python3Parser::NUMBER:
-                case Python3Parser::LAMBDA:
-                case Python3Parser::NOT:
-                case Python3Parser::NONE:
-                case Python3Parser::TRUE:
-                case Python3Parser::FALSE:
-                case Python3Parser::AWAIT:
-                case Python3Parser::NAME:
-                case Python3Parser::ELLIPSIS:
-                case Python3Parser::OPEN_PAREN:
-                case Python3Parser::OPEN_BRACK:
-                case Python3Parser::ADD:
-                case Python3Parser::MINUS:
-                case Python3Parser::NOT_OP:
-                case Python3Parser::OPEN_BRACE:
-                case Python3Parser::POWER:
+            switch (FIRST_DICTORSETMAKER.classify(lexer.curr.getType())) {
+                case TokenSet::MEMBER:
                     node = parseDictorsetmaker(lexer);
                     break;
                 default:
@@ -2111,47 +2046,52 @@ Node *parseAtom(PyLexer &lexer) {
         }
         case Python3Parser::NUMBER: {
             lexer.consume(Python3Parser::NUMBER);
-            node = new Const(current_token->getText(), Python3Parser::NUMBER);
+            const auto text = lexer.text(current_token);
+            node = new Const(text, decodeNumber(text));
             break;
         }
         case Python3Parser::STRING: {
-            std::string str;
-            while (lexer.curr->getType() == Python3Parser::STRING) {
-                str += lexer.curr->getText();
+            // adjacent literals are concatenated
+            auto &literals = lexer.literals();
+            while (lexer.curr.getType() == Python3Parser::STRING) {
+                literals.append(lexer.text(lexer.curr));
                 lexer.consume(Python3Parser::STRING);
             }
-            node = new Const(str, Python3Parser::STRING);
+            const auto literal = literals.finish();
+            auto str_const = new Const(literals.value(literal), Python3Parser::STRING);
+            str_const->literal = literal;
+            node = str_const;
             break;
         }
         case Python3Parser::NAME: {
             lexer.consume(Python3Parser::NAME);
-            node = new Name(current_token->getText());
+            node = new Name(lexer.text(current_token), current_token.getSymbol());
             break;
         }
         case Python3Parser::ELLIPSIS: {
             // not sure about that one
-            node = new Const(lexer.curr->getText(), Python3Parser::NONE);
+            node = new Const(lexer.text(lexer.curr), Python3Parser::NONE);
             lexer.consume(Python3Parser::ELLIPSIS);
             break;
         }
         case Python3Parser::NONE: {
-            node = new Const(lexer.curr->getText(), Python3Parser::NONE);
+            node = new Const(lexer.text(lexer.curr), Python3Parser::NONE);
             lexer.consume(Python3Parser::NONE);
             break;
         }
         case Python3Parser::FALSE: {
-            node = new Const(lexer.curr->getText(), Python3Parser::NONE);
+            node = new Const(lexer.text(lexer.curr), Python3Parser::NONE);
             lexer.consume(Python3Parser::FALSE);
             break;
         }
         case Python3Parser::TRUE: {
-            node = new Const(lexer.curr->getText(), Python3Parser::NONE);
+            node = new Const(lexer.text(lexer.curr), Python3Parser::NONE);
             lexer.consume(Python3Parser::TRUE);
             break;
         }
         default: {
-            printf("%s", current_token->getText().c_str());
-            ERR_MSG_EXIT("Encountered an unknown node");
+            const auto text = lexer.text(current_token);
+            ERR_MSG_THROW("Encountered an unknown node %.*s", static_cast<int>(text.size()), text.data());
         }
     }
 
@@ -2160,7 +2100,7 @@ Node *parseAtom(PyLexer &lexer) {
 
 Node *parseCompFor(PyLexer &lexer) {
     auto comp_for = new Comprehension(nullptr, nullptr, {}, false);
-    if (lexer.curr->getType() == Python3Parser::ASYNC) {
+    if (lexer.curr.getType() == Python3Parser::ASYNC) {
         lexer.consume(Python3Parser::ASYNC);
         comp_for->is_async = true;
     }
@@ -2171,7 +2111,7 @@ Node *parseCompFor(PyLexer &lexer) {
     lexer.consume(Python3Parser::IN);
     comp_for->iter = parseOrTest(lexer);
 
-    while (lexer.curr->getType() == Python3Parser::IF) {
+    while (lexer.curr.getType() == Python3Parser::IF) {
         lexer.consume(Python3Parser::IF);
         comp_for->ifs.push_back(parseTestNoCond(lexer));
     }
@@ -2184,7 +2124,7 @@ Node *parseDict(PyLexer &lexer) {
     lexer.consume(Python3Parser::COLON);
     const auto value = parseTest(lexer);
 
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::ASYNC:
         case Python3Parser::FOR: {
             auto dict = new DictComp(key, value, {});
@@ -2202,12 +2142,12 @@ static Node *parseDictorsetmakerTestColon(PyLexer &lexer) {
     lexer.consume(Python3Parser::COLON);
     const auto value = parseTest(lexer);
 
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::ASYNC:
         case Python3Parser::FOR: {
             auto dict_comp = new DictComp(key, value, {});
-            while (lexer.curr->getType() == Python3Parser::ASYNC ||
-                   lexer.curr->getType() == Python3Parser::FOR) {
+            while (lexer.curr.getType() == Python3Parser::ASYNC ||
+                   lexer.curr.getType() == Python3Parser::FOR) {
 
                 const auto comprehension = parseCompFor(lexer);
                 dict_comp->generators.push_back(comprehension);
@@ -2217,26 +2157,11 @@ static Node *parseDictorsetmakerTestColon(PyLexer &lexer) {
         }
         case Python3Parser::COMMA: {
             auto dict = new Dict({key}, {value});
-            while (lexer.curr->getType() == Python3Parser::COMMA) {
+            while (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
 
-                switch (lexer.curr->getType()) {
-                    case Python3Parser::STRING:
-                    case Python3Parser::NUMBER:
-                    case Python3Parser::LAMBDA:
-                    case Python3Parser::NOT:
-                    case Python3Parser::NONE:
-                    case Python3Parser::TRUE:
-                    case Python3Parser::FALSE:
-                    case Python3Parser::AWAIT:
-                    case Python3Parser::NAME:
-                    case Python3Parser::ELLIPSIS:
-                    case Python3Parser::OPEN_PAREN:
-                    case Python3Parser::OPEN_BRACK:
-                    case Python3Parser::ADD:
-                    case Python3Parser::MINUS:
-                    case Python3Parser::NOT_OP:
-                    case Python3Parser::OPEN_BRACE: {
+                switch (FIRST_TEST.classify(lexer.curr.getType())) {
+                    case TokenSet::MEMBER: {
                         dict->keys.push_back(parseTest(lexer));
                         lexer.consume(Python3Parser::COLON);
                         dict->values.push_back(parseTest(lexer));
@@ -2248,10 +2173,10 @@ static Node *parseDictorsetmakerTestColon(PyLexer &lexer) {
                         break;
                     }
                     default: {
-                        if (lexer.curr->getType() == Python3Parser::CLOSE_BRACE) {
+                        if (lexer.curr.getType() == Python3Parser::CLOSE_BRACE) {
                             break;
                         } else {
-                            ERR_MSG_EXIT("expected TEST or POWER");
+                            ERR_MSG_THROW("expected TEST or POWER");
                         }
                     }
                 }
@@ -2259,11 +2184,11 @@ static Node *parseDictorsetmakerTestColon(PyLexer &lexer) {
             return dict;
         }
         default: {
-            if (lexer.curr->getType() == Python3Parser::CLOSE_BRACE) {
+            if (lexer.curr.getType() == Python3Parser::CLOSE_BRACE) {
                 auto dict = new Dict({key}, {value});
                 return dict;
             } else {
-                ERR_MSG_EXIT("Expected COMP_FOR or COMMA at line %d", lexer.curr->getLine());
+                ERR_MSG_THROW("Expected COMP_FOR or COMMA");
             }
         }
     }
@@ -2272,12 +2197,12 @@ static Node *parseDictorsetmakerTestColon(PyLexer &lexer) {
 static Node *parseDictorsetmakerTest(PyLexer &lexer) {
     const auto value = parseTest(lexer);
 
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::ASYNC:
         case Python3Parser::FOR: {
             auto set_comp = new SetComp(value, {});
-            while (lexer.curr->getType() == Python3Parser::ASYNC ||
-                   lexer.curr->getType() == Python3Parser::FOR) {
+            while (lexer.curr.getType() == Python3Parser::ASYNC ||
+                   lexer.curr.getType() == Python3Parser::FOR) {
 
                 const auto comprehension = parseCompFor(lexer);
                 set_comp->generators.push_back(comprehension);
@@ -2286,27 +2211,12 @@ static Node *parseDictorsetmakerTest(PyLexer &lexer) {
             return set_comp;
         }
         case Python3Parser::COMMA: {
-            auto set = new Set({});
-            while (lexer.curr->getType() == Python3Parser::COMMA) {
+            auto set = new Set({value});
+            while (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
 
-                switch (lexer.curr->getType()) {
-                    case Python3Parser::STRING:
-                    case Python3Parser::NUMBER:
-                    case Python3Parser::LAMBDA:
-                    case Python3Parser::NOT:
-                    case Python3Parser::NONE:
-                    case Python3Parser::TRUE:
-                    case Python3Parser::FALSE:
-                    case Python3Parser::AWAIT:
-                    case Python3Parser::NAME:
-                    case Python3Parser::ELLIPSIS:
-                    case Python3Parser::OPEN_PAREN:
-                    case Python3Parser::OPEN_BRACK:
-                    case Python3Parser::ADD:
-                    case Python3Parser::MINUS:
-                    case Python3Parser::NOT_OP:
-                    case Python3Parser::OPEN_BRACE: {
+                switch (FIRST_TEST.classify(lexer.curr.getType())) {
+                    case TokenSet::MEMBER: {
                         set->elements.push_back(parseTest(lexer));
                         break;
                     }
@@ -2315,13 +2225,10 @@ static Node *parseDictorsetmakerTest(PyLexer &lexer) {
                         break;
                     }
                     default: {
-                        if (lexer.curr->getType() == Python3Parser::CLOSE_BRACE) {
+                        if (lexer.curr.getType() == Python3Parser::CLOSE_BRACE) {
                             break;
-                       // how horrific it is
-                auto set = new Set({value});
-                return set;
-                 } else {
-                            ERR_MSG_EXIT("expected TEST or STAR");
+                        } else {
+                            ERR_MSG_THROW("expected TEST or STAR");
                         }
                     }
                 }
@@ -2329,12 +2236,12 @@ static Node *parseDictorsetmakerTest(PyLexer &lexer) {
             return set;
         }
         default: {
-            if (lexer.curr->getType() == Python3Parser::CLOSE_BRACE) {
+            if (lexer.curr.getType() == Python3Parser::CLOSE_BRACE) {
                 // how horrific it is
                 auto set = new Set({value});
                 return set;
             } else {
-                ERR_MSG_EXIT("Expected COMP_FOR or COMMA");
+                ERR_MSG_THROW("Expected COMP_FOR or COMMA");
             }
         }
     }
@@ -2349,24 +2256,9 @@ static Node *parseDictorsetmakerTest(PyLexer &lexer) {
 // );
 Node *parseDictorsetmaker(PyLexer &lexer) {
 
-    switch (lexer.curr->getType()) {
-        case Python3Parser::STRING:
-        case Python3Parser::NUMBER:
-        case Python3Parser::LAMBDA:
-        case Python3Parser::NOT:
-        case Python3Parser::NONE:
-        case Python3Parser::TRUE:
-        case Python3Parser::FALSE:
-        case Python3Parser::AWAIT:
-        case Python3Parser::NAME:
-        case Python3Parser::ELLIPSIS:
-        case Python3Parser::OPEN_PAREN:
-        case Python3Parser::OPEN_BRACK:
-        case Python3Parser::ADD:
-        case Python3Parser::MINUS:
-        case Python3Parser::NOT_OP:
-        case Python3Parser::OPEN_BRACE: {
-            if (lexer.next->getType() == Python3Parser::COLON) {
+    switch (FIRST_TEST.classify(lexer.curr.getType())) {
+        case TokenSet::MEMBER: {
+            if (lexer.next.getType() == Python3Parser::COLON) {
                 // parsing a dictionary
                 return parseDictorsetmakerTestColon(lexer);
             } else {
@@ -2378,26 +2270,11 @@ Node *parseDictorsetmaker(PyLexer &lexer) {
             lexer.consume(Python3Parser::POWER);
             const auto value = parseExpr(lexer);
             auto dict = new Dict({}, {value});
-            while (lexer.curr->getType() == Python3Parser::COMMA) {
+            while (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
 
-                switch (lexer.curr->getType()) {
-                    case Python3Parser::STRING:
-                    case Python3Parser::NUMBER:
-                    case Python3Parser::LAMBDA:
-                    case Python3Parser::NOT:
-                    case Python3Parser::NONE:
-                    case Python3Parser::TRUE:
-                    case Python3Parser::FALSE:
-                    case Python3Parser::AWAIT:
-                    case Python3Parser::NAME:
-                    case Python3Parser::ELLIPSIS:
-                    case Python3Parser::OPEN_PAREN:
-                    case Python3Parser::OPEN_BRACK:
-                    case Python3Parser::ADD:
-                    case Python3Parser::MINUS:
-                    case Python3Parser::NOT_OP:
-                    case Python3Parser::OPEN_BRACE: {
+                switch (FIRST_TEST.classify(lexer.curr.getType())) {
+                    case TokenSet::MEMBER: {
                         dict->keys.push_back(parseTest(lexer));
                         lexer.consume(Python3Parser::COLON);
                         dict->values.push_back(parseTest(lexer));
@@ -2409,10 +2286,10 @@ Node *parseDictorsetmaker(PyLexer &lexer) {
                         break;
                     }
                     default: {
-                        if (lexer.curr->getType() == Python3Parser::CLOSE_BRACE) {
+                        if (lexer.curr.getType() == Python3Parser::CLOSE_BRACE) {
                             break;
                         } else {
-                            ERR_MSG_EXIT("expected TEST or POWER");
+                            ERR_MSG_THROW("expected TEST or POWER");
                         }
                     }
                 }
@@ -2424,26 +2301,11 @@ Node *parseDictorsetmaker(PyLexer &lexer) {
             const auto value = parseStarExpr(lexer);
 
             auto set = new Set({value});
-            while (lexer.curr->getType() == Python3Parser::COMMA) {
+            while (lexer.curr.getType() == Python3Parser::COMMA) {
                 lexer.consume(Python3Parser::COMMA);
 
-                switch (lexer.curr->getType()) {
-                    case Python3Parser::STRING:
-                    case Python3Parser::NUMBER:
-                    case Python3Parser::LAMBDA:
-                    case Python3Parser::NOT:
-                    case Python3Parser::NONE:
-                    case Python3Parser::TRUE:
-                    case Python3Parser::FALSE:
-                    case Python3Parser::AWAIT:
-                    case Python3Parser::NAME:
-                    case Python3Parser::ELLIPSIS:
-                    case Python3Parser::OPEN_PAREN:
-                    case Python3Parser::OPEN_BRACK:
-                    case Python3Parser::ADD:
-                    case Python3Parser::MINUS:
-                    case Python3Parser::NOT_OP:
-                    case Python3Parser::OPEN_BRACE: {
+                switch (FIRST_TEST.classify(lexer.curr.getType())) {
+                    case TokenSet::MEMBER: {
                         set->elements.push_back(parseTest(lexer));
                         break;
                     }
@@ -2452,17 +2314,19 @@ Node *parseDictorsetmaker(PyLexer &lexer) {
                         break;
                     }
                     default: {
-                        if (lexer.curr->getType() == Python3Parser::CLOSE_BRACE) {
+                        if (lexer.curr.getType() == Python3Parser::CLOSE_BRACE) {
                             break;
                         } else {
-                            ERR_MSG_EXIT("expected TEST or POWER");
+                            ERR_MSG_THROW("expected TEST or POWER");
                         }
                     }
                 }
             }
+
+            return set;
         }
         default: {
-            ERR_MSG_EXIT("Expected TEST, STAR or POWER");
+            ERR_MSG_THROW("Expected TEST, STAR or POWER");
             break;
         }
     }
@@ -2470,28 +2334,11 @@ Node *parseDictorsetmaker(PyLexer &lexer) {
 
 Node *parseTrailer(PyLexer &lexer) {
 
-    switch (lexer.curr->getType()) {
+    switch (lexer.curr.getType()) {
         case Python3Parser::OPEN_PAREN: {
             lexer.consume(Python3Parser::OPEN_PAREN);
-            switch (lexer.curr->getType()) {
-                case Python3Parser::STRING:
-                case Python3Parser::NUMBER:
-                case Python3Parser::LAMBDA:
-                case Python3Parser::NOT:
-                case Python3Parser::NONE:
-                case Python3Parser::TRUE:
-                case Python3Parser::FALSE:
-                case Python3Parser::AWAIT:
-                case Python3Parser::NAME:
-                case Python3Parser::ELLIPSIS:
-                case Python3Parser::OPEN_PAREN:
-                case Python3Parser::OPEN_BRACK:
-                case Python3Parser::ADD:
-                case Python3Parser::MINUS:
-                case Python3Parser::NOT_OP:
-                case Python3Parser::OPEN_BRACE:
-                case Python3Parser::POWER:
-                case Python3Parser::STAR: {
+            switch (FIRST_ARGLIST.classify(lexer.curr.getType())) {
+                case TokenSet::MEMBER: {
                     return parseArglist(lexer);
                 }
             }
@@ -2516,73 +2363,273 @@ Node *parseTrailer(PyLexer &lexer) {
 }
 
 Node *parseTerm(PyLexer &lexer) {
-    auto node = parseFactor(lexer);
+    return parseBinary(lexer, Precedence::TERM);
+}
 
-    while (isTermOp(lexer.curr)) {
+Node *parseArithExpr(PyLexer &lexer) {
+    return parseBinary(lexer, Precedence::ARITH_EXPR);
+}
 
-        const auto token = lexer.curr;
-        switch (token->getType()) {
-            case Python3Parser::STAR:
-                lexer.consume(Python3Parser::STAR);
-                break;
-            case Python3Parser::DIV:
-                lexer.consume(Python3Parser::DIV);
-                break;
-            case Python3Parser::IDIV:
-                lexer.consume(Python3Parser::IDIV);
-                break;
-            case Python3Parser::MOD:
-                lexer.consume(Python3Parser::MOD);
-                break;
-        }
+Node *buildAst(PyLexer &lexer) {
+    ArenaScope scope(lexer.arena());
+    lexer.updateCurr(1);
+    return parseFileInput(lexer);
+}
 
-        const auto rhs = parseFactor(lexer);
-        node = new BinOp(node, rhs, token->getType());
-    }
+ParseResult parse(PyLexer &lexer) {
+    ParseResult result;
+    result.root = buildAst(lexer);
+    result.errors = std::move(lexer.diagnostics().errors());
 
-    return node;
+    return result;
 }
 
-Node *parseArithExpr(PyLexer &lexer) {
-    auto node = parseTerm(lexer);
+ParseResult parse(PyLexer &lexer, std::vector<StmtMark> &marks) {
+    lexer.markStmts(&marks);
+    auto result = parse(lexer);
+    lexer.markStmts(nullptr);
 
-    while (isArithOp(lexer.curr)) {
+    return result;
+}
 
-        const auto token = lexer.curr;
-        switch (token->getType()) {
-            case Python3Parser::ADD:
-                lexer.consume(Python3Parser::ADD);
-                break;
-            case Python3Parser::MINUS:
-                lexer.consume(Python3Parser::MINUS);
-                break;
+ParseResult parseSingle(PyLexer &lexer) {
+    ArenaScope scope(lexer.arena());
+    ParseResult result;
+    lexer.updateCurr(1);
+    const auto start_idx = lexer.curr.getTokenIndex();
+    try {
+        result.root = parseSingleInput(lexer);
+        if (lexer.curr.getType() != Python3Parser::EOF) {
+            result.root = nullptr;
+            ERR_MSG_THROW("expected a single statement");
         }
+    } catch (ParseError &error) {
+        // the same as in a block, the errors of the suite of a broken statement are reported too
+        recover(lexer, std::move(error), start_idx);
+    }
+    result.errors = std::move(lexer.diagnostics().errors());
 
-        node = new BinOp(node, parseTerm(lexer), token->getType());
+    return result;
+}
+
+template<typename FuncDefT>
+static Node *parseLazyBody(PyLexer &lexer, FuncDefT *func_def) {
+    if (func_def->body || func_def->body_end == 0) {
+        return func_def->body;
     }
 
-    return node;
+    ArenaScope scope(lexer.arena());
+    const auto curr_idx = lexer.curr.getTokenIndex();
+    lexer.seek(func_def->body_begin);
+    try {
+        func_def->body = parseSuite(lexer);
+    } catch (ParseError &error) {
+        lexer.diagnostics().report(std::move(error));
+    }
+    lexer.seek(curr_idx);
+    // parsed once, even if it didn't make it
+    func_def->body_end = 0;
+
+    return func_def->body;
 }
 
-Node *buildAst(PyLexer &lexer) {
-    lexer.updateCurr(1);
-    return parseFileInput(lexer);
+Node *parseBody(PyLexer &lexer, FuncDef *func_def) {
+    return parseLazyBody(lexer, func_def);
 }
 
-void destroyNode(Node *root) {
-    if (!root) return;
-    if (root->getChildren().empty()) {
-        delete root;
-    } else {
-        // destroy all children
-        for (const auto &child: root->getChildren()) {
-            destroyNode(child);
+Node *parseBody(PyLexer &lexer, AsyncFuncDef *func_def) {
+    return parseLazyBody(lexer, func_def);
+}
+
+ParseError parseError(const PyLexer &lexer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    char message[256];
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    return {message, lexer.curr ? lexer.curr.getLine() : 0, lexer.curr.getTokenIndex()};
+}
+
+int32_t astNumNodes(Node *node) {
+    int32_t num_of_nodes = 0;
+    std::vector<Node *> stack;
+    if (node) {
+        stack.push_back(node);
+    }
+    while (!stack.empty()) {
+        const auto top = stack.back();
+        stack.pop_back();
+        num_of_nodes++;
+        top->forEachChild([&](Node *child) {
+            if (child) {
+                stack.push_back(child);
+            }
+        });
+    }
+
+    return num_of_nodes;
+}
+
+// Whether the nodes (of the same kind) are the same apart from their children
+static bool samePayload(Node *a, Node *b) {
+    switch (a->kind) {
+        case NodeKind::Name:
+            return static_cast<Name *>(a)->name == static_cast<Name *>(b)->name;
+        case NodeKind::Const: {
+            const auto constant = static_cast<Const *>(a);
+            const auto other = static_cast<Const *>(b);
+            return constant->type == other->type && constant->value == other->value;
+        }
+        case NodeKind::BinOp:
+            return static_cast<BinOp *>(a)->op == static_cast<BinOp *>(b)->op;
+        case NodeKind::BoolOp:
+            return static_cast<BoolOp *>(a)->op == static_cast<BoolOp *>(b)->op;
+        case NodeKind::UnaryOp:
+            return static_cast<UnaryOp *>(a)->op == static_cast<UnaryOp *>(b)->op;
+        case NodeKind::Comparison:
+            return static_cast<Comparison *>(a)->op == static_cast<Comparison *>(b)->op;
+        case NodeKind::AugAssign:
+            return static_cast<AugAssign *>(a)->op == static_cast<AugAssign *>(b)->op;
+        case NodeKind::Keyword:
+            return static_cast<Keyword *>(a)->arg == static_cast<Keyword *>(b)->arg;
+        case NodeKind::FuncDef:
+            return static_cast<FuncDef *>(a)->name == static_cast<FuncDef *>(b)->name;
+        case NodeKind::AsyncFuncDef:
+            return static_cast<AsyncFuncDef *>(a)->name == static_cast<AsyncFuncDef *>(b)->name;
+        case NodeKind::ClassDef:
+            return static_cast<ClassDef *>(a)->name == static_cast<ClassDef *>(b)->name;
+        case NodeKind::ExceptHandler:
+            return static_cast<ExceptHandler *>(a)->name == static_cast<ExceptHandler *>(b)->name;
+        case NodeKind::ImportFrom:
+            return static_cast<ImportFrom *>(a)->level == static_cast<ImportFrom *>(b)->level;
+        case NodeKind::Comprehension:
+            return static_cast<Comprehension *>(a)->is_async == static_cast<Comprehension *>(b)->is_async;
+        case NodeKind::Dict:
+            // the children are the keys followed by the values, a '**' mapping has no key
+            return static_cast<Dict *>(a)->keys.size() == static_cast<Dict *>(b)->keys.size();
+        case NodeKind::Arguments:
+            return static_cast<Arguments *>(a)->args.size() == static_cast<Arguments *>(b)->args.size();
+        case NodeKind::Parameters: {
+            const auto parameters = static_cast<Parameters *>(a);
+            const auto &extra = parameters->extra;
+            const auto &other = static_cast<Parameters *>(b)->extra;
+            return parameters->params.size() == static_cast<Parameters *>(b)->params.size() &&
+                   extra.pos_only_args.size() == other.pos_only_args.size() &&
+                   extra.kw_only_args.size() == other.kw_only_args.size() &&
+                   extra.kw_defaults.size() == other.kw_defaults.size();
+        }
+        default:
+            return true;
+    }
+}
+
+const char *nodeKindName(NodeKind kind) {
+    static constexpr const char *NAMES[] = {
+#define PRSS_NODE_KIND(name) #name,
+        PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+    };
+
+    return NAMES[static_cast<size_t>(kind)];
+}
+
+static std::string typeName(const Node *node) {
+    return node ? nodeKindName(node->kind) : "None";
+}
+
+bool astEqual(Node *a, Node *b, std::string *difference) {
+    // the pairs of nodes compared, along with where they are in their parents, an explicit stack
+    // of indices into them takes the place of the recursion
+    struct Pair {
+        Node *a;
+        Node *b;
+        size_t parent;
+        size_t child_idx;
+    };
+    std::vector<Pair> pairs{{a, b, SIZE_MAX, 0}};
+    std::vector<size_t> stack{0};
+    while (!stack.empty()) {
+        const auto idx = stack.back();
+        stack.pop_back();
+        const auto pair = pairs[idx];
+
+        auto is_equal = (pair.a == nullptr) == (pair.b == nullptr);
+        // the pairs of the children go right after the ones already there, the children of b join the ones of a
+        const auto first_child = pairs.size();
+        if (is_equal && pair.a) {
+            is_equal = pair.a->kind == pair.b->kind && samePayload(pair.a, pair.b);
+            if (is_equal) {
+                pair.a->forEachChild([&](Node *child) {
+                    pairs.push_back({child, nullptr, idx, pairs.size() - first_child});
+                });
+                size_t num_of_children_b = 0;
+                pair.b->forEachChild([&](Node *child) {
+                    if (first_child + num_of_children_b < pairs.size()) {
+                        pairs[first_child + num_of_children_b].b = child;
+                    }
+                    num_of_children_b++;
+                });
+                is_equal = pairs.size() - first_child == num_of_children_b;
+            }
+        }
+
+        if (!is_equal) {
+            if (difference) {
+                std::vector<size_t> path;
+                for (auto i = idx; i != SIZE_MAX; i = pairs[i].parent) {
+                    path.push_back(i);
+                }
+                difference->clear();
+                for (auto it = path.rbegin(); it != path.rend(); ++it) {
+                    if (it != path.rbegin()) {
+                        *difference += "[" + std::to_string(pairs[*it].child_idx) + "] > ";
+                    }
+                    *difference += typeName(pairs[*it].a);
+                }
+                *difference += " differs from " + typeName(pair.b);
+                if (pair.a && pair.b && pair.a->kind == pair.b->kind) {
+                    // the strings of small nodes tell what differs, the big ones are of no help
+                    const auto str_a = pair.a->str();
+                    const auto str_b = pair.b->str();
+                    if (!str_a.empty() && str_a.size() + str_b.size() < 240) {
+                        *difference += " (" + str_a + " vs " + str_b + ")";
+                    }
+                }
+            }
+            return false;
         }
 
-        // and only then destroy the parent
-        delete root;
+        // the first child ends up on the top, so that the first difference in the source order is reported
+        for (auto i = pairs.size(); i-- > first_child;) {
+            stack.push_back(i);
+        }
     }
-}
 
+    return true;
+}
 
+std::string Node::str() const noexcept {
+    std::string str;
+    // the parts still to be written, the next one on the top
+    std::vector<StrPart> stack;
+    std::vector<StrPart> parts;
+    stack.emplace_back(this);
+    while (!stack.empty()) {
+        auto part = std::move(stack.back());
+        stack.pop_back();
+        if (!part.is_child) {
+            str += part.text;
+        } else if (!part.child) {
+            str += "None";
+        } else {
+            parts.clear();
+            part.child->strParts(parts);
+            for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+                stack.push_back(std::move(*it));
+            }
+        }
+    }
 
+    return str;
+}
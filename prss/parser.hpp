@@ -1,23 +1,34 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <vector>
 #include <stack>
+#include <deque>
 #include <optional>
 #include <any>
 #include <sstream>
+#include <string_view>
 #include <map>
 #include <execinfo.h>
+#include <stdexcept>
 
 #include <numeric>
 #include "antlr4-runtime.h"
 #include "Python3Lexer.h"
+#include "arena.hpp"
+#include "cache.hpp"
+#include "first_sets.hpp"
+#include "lexer.hpp"
+#include "literals.hpp"
+#include "source.hpp"
 
 #define NO_ARGS
 
-#define ERR_TOK(expected_token_type) fprintf(stderr, "expected token %d", expected_token_type);
 #define ERR_MSG(message, ...)
-#define ERR_MSG_EXIT(message, ...) fprintf(stderr, message, __VA_ARGS__); exit(1)
+// throws a ParseError, expects the lexer to be in scope
+#define ERR_MSG_THROW(message, ...) throw parseError(lexer, message, ##__VA_ARGS__)
 // TODO(threadedstream): define cleanup exit macro
 //#define ERR_MSG_CLEANUP_EXIT(message) ERR_MSG(message); destroyAst()
 
@@ -31,6 +42,25 @@ enum class AssignFlag : uint8_t {
     OP_ASSIGN = 0,
 };
 
+// Binding powers of the operators of or_test down to power, the tighter an operator binds,
+// the higher its precedence. parseBinary parses an expression made up of the operators
+// of at least the given precedence.
+enum class Precedence : uint8_t {
+    NONE = 0,
+    OR_TEST,
+    AND_TEST,
+    NOT_TEST,
+    COMPARISON,
+    EXPR,
+    XOR_EXPR,
+    AND_EXPR,
+    SHIFT_EXPR,
+    ARITH_EXPR,
+    TERM,
+    FACTOR,
+    POWER,
+};
+
 enum {
     NOT_IN = 1,
     LESS_THAN,
@@ -44,6 +74,26 @@ enum {
     IS_NOT
 };
 
+// Every type of node, X(name) is expanded once per type
+#define PRSS_NODE_KINDS(X) \
+    X(FileInput) X(Module) X(Comprehension) X(GeneratorExp) X(Dict) X(DictComp) X(Set) X(List) X(ListComp) \
+    X(SetComp) X(Stmt) X(SimpleStmt) X(ForStmt) X(AsyncForStmt) X(WithStmt) X(AsyncWithStmt) X(WithItem) X(TryStmt) \
+    X(ExceptHandler) X(ExprList) X(ClassDef) X(Attribute) X(IfStmt) X(Alias) X(Aliases) X(Import) X(ImportFrom) \
+    X(TestList) X(Return) X(Break) X(Continue) X(Assign) X(AugAssign) X(AnnAssign) X(AssName) X(Discard) \
+    X(StarredExpr) X(WhileStmt) X(Raise) X(Yield) X(Index) X(Slice) X(Subscript) X(ExtSlice) X(YieldFrom) X(Delete) \
+    X(Const) X(Arguments) X(Name) X(Argument) X(Parameter) X(Parameters) X(Keyword) X(BinOp) X(SubscriptList) \
+    X(UnaryOp) X(BoolOp) X(Comparison) X(FuncDef) X(AsyncFuncDef) X(Lambda) X(Call) X(Pass) X(Global) X(Assert) \
+    X(Nonlocal)
+
+enum class NodeKind : uint8_t {
+#define PRSS_NODE_KIND(name) name,
+    PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+};
+
+// the name of the type of the nodes of the kind
+const char *nodeKindName(NodeKind kind);
+
 struct Node;
 struct FileInput;
 struct Module;
@@ -109,6 +159,51 @@ struct Delete;
 
 class PyLexer;
 
+// The children of a node, in the arena of its tree
+using NodeList = ArenaVector<Node *>;
+
+// A syntax error. The parse* functions throw it, the statement parsers catch it, report it
+// to the Diagnostics of the lexer and go on with the next statement.
+struct ParseError {
+    std::string message;
+    size_t line;
+    // the token it was found at
+    uint32_t token_idx = 0;
+    // the source is nested deeper than LexerOptions::max_nesting_depth there
+    bool is_too_deep = false;
+};
+
+// Collects the syntax errors of a source, in the order they're found
+class Diagnostics {
+public:
+    inline void report(ParseError &&error) { errors_.push_back(std::move(error)); }
+
+    inline std::vector<ParseError> &errors() noexcept { return errors_; }
+
+private:
+    std::vector<ParseError> errors_;
+};
+
+// The tree of a source, missing the statements listed in errors. Its nodes are in the arena of the lexer the source
+// was parsed with.
+struct ParseResult {
+    Node *root = nullptr;
+    std::vector<ParseError> errors;
+};
+
+// The start of a statement of a block (or of a NEWLINE, or of the tokens skipped after a syntax error there),
+// or the end of the block. Marks come in the order of the tokens, those of a nested block sit in between the ones
+// of the block it's nested in.
+struct StmtMark {
+    uint32_t token_idx;
+    // the amount of the statements of the block and the amount of all of the errors before the token
+    uint32_t num_of_stmts;
+    uint32_t num_of_errors;
+    // the statements of the block, they are in the node of the block (unless the block got orphaned by an error)
+    NodeList *block;
+    bool is_end;
+};
+
 // TODO(threadedstream): This is a quick note on how to parse the terminal COMMA symbols taking place after series of exprs separated by comma
 // For instance, let's take the following rule: (expr|star_expr) (',' (expr|star_expr))* (',')?
 // Here, expr or star_expr is followed by series of exprs or star_exprs separated by comma.
@@ -120,6 +215,11 @@ class PyLexer;
 
 int32_t astNumNodes(Node *node);
 
+// Whether the trees are the same: nodes of the same types, with the same names, operators and constants, and
+// the same children (the positions aren't compared). If they aren't and difference isn't null, it's set to the path
+// from the root to the first node that differs.
+bool astEqual(Node *a, Node *b, std::string *difference = nullptr);
+
 Node *parseSingleInput(PyLexer &lexer);
 
 Node *parseFileInput(PyLexer &lexer);
@@ -130,6 +230,8 @@ Node *parseAtomExpr(PyLexer &lexer);
 
 Node *parseAtom(PyLexer &lexer);
 
+Node *parseBinary(PyLexer &lexer, Precedence min_precedence);
+
 Node *parsePower(PyLexer &lexer);
 
 Node *parseTerm(PyLexer &lexer);
@@ -182,13 +284,13 @@ Parameter *parseParameter(PyLexer &lexer, const bool check_type);
 
 Node *parseAsyncStmt(PyLexer &lexer);
 
-FuncDef *parseFuncDef(PyLexer &lexer, std::vector<Node *> &&decorator_list);
+FuncDef *parseFuncDef(PyLexer &lexer, NodeList &&decorator_list);
 
-AsyncFuncDef *parseAsyncFuncDef(PyLexer &lexer, std::vector<Node *> &decorator_list);
+AsyncFuncDef *parseAsyncFuncDef(PyLexer &lexer, NodeList &decorator_list);
 
 AsyncWithStmt *parseAsyncWithStmt(PyLexer &lexer);
 
-ClassDef *parseClassDef(PyLexer &lexer, std::vector<Node *> &&decorator_list);
+ClassDef *parseClassDef(PyLexer &lexer, NodeList &&decorator_list);
 
 Node *parseSuite(PyLexer &lexer);
 
@@ -206,7 +308,9 @@ Import *parseImportName(PyLexer &lexer);
 
 Node *parseTestNoCond(PyLexer &lexer);
 
-Node *parseTestlistComp(PyLexer &lexer);
+// In parentheses a testlist_comp is either the expression itself, a tuple (a TestList) if there's a comma,
+// or a GeneratorExp, in brackets it's a List or a ListComp
+Node *parseTestlistComp(PyLexer &lexer, bool is_parenthesized = false);
 
 Node *parseCompoundStmt(PyLexer &lexer);
 
@@ -260,7 +364,7 @@ Node *parseDecorated(PyLexer &lexer);
 
 Node *parseDecorator(PyLexer &lexer);
 
-std::vector<Node *> parseDecorators(PyLexer &lexer);
+NodeList parseDecorators(PyLexer &lexer);
 
 Node *parseDict(PyLexer &lexer);
 
@@ -292,7 +396,25 @@ TestList *parseTestlist(PyLexer &lexer);
 
 Node *buildAst(PyLexer &lexer);
 
-void destroyNode(Node *root);
+// Parses the source of the lexer, along with the errors buildAst left in its diagnostics.
+// Everything a parse touches (the nodes included) is owned by the lexer, hence sources may be parsed on any number
+// of threads at once as long as each of them has a lexer of its own.
+ParseResult parse(PyLexer &lexer);
+
+// Same as parse(), also marking where the statements of every block start and where the blocks end
+ParseResult parse(PyLexer &lexer, std::vector<StmtMark> &marks);
+
+// Parses the source of the lexer as a single statement (single_input), the root being null if it has an error
+ParseResult parseSingle(PyLexer &lexer);
+
+// Returns the body of a function parsed with LexerOptions::lazy_bodies, parsing its suite on the first call.
+// The lexer has to be the one the function was parsed with, its diagnostics get the errors of the suite.
+Node *parseBody(PyLexer &lexer, FuncDef *func_def);
+
+Node *parseBody(PyLexer &lexer, AsyncFuncDef *func_def);
+
+// Formats the message of a ParseError at the current token
+ParseError parseError(const PyLexer &lexer, const char *format, ...) __attribute__((format(printf, 2, 3)));
 
 namespace tok_utils {
     static const char *comparisonOpToStr(const int32_t op) {
@@ -322,7 +444,8 @@ namespace tok_utils {
         }
     }
 
-    static std::map<int32_t, std::string> tokTypeToStr = {
+    // read-only, so that any number of parsers may look names up at once (operator[] would insert)
+    static const std::map<int32_t, std::string> tokTypeToStr = {
             {Python3Parser::STRING,             "TokString"},
             {Python3Parser::NUMBER,             "TokNumber"},
             {Python3Parser::INTEGER,            "TokInteger"},
@@ -419,62 +542,206 @@ namespace tok_utils {
             {Python3Parser::POWER_ASSIGN,       "TokPowerAssign"},
             {Python3Parser::IDIV_ASSIGN,        "TokIDivAssign"},
             {Python3Parser::SKIP_,              "TokSkip"},
-            {Python3Parser::UNKNOWN_CHAR,       "TokUnknownChar"}
+            {Python3Parser::UNKNOWN_CHAR,       "TokUnknownChar"},
+            {Python3Parser::INDENT,             "TokIndent"},
+            {Python3Parser::DEDENT,             "TokDedent"}
     };
 
+    // the name of the token type, empty for the types missing in tokTypeToStr
+    inline const std::string &tokTypeName(const int32_t type) {
+        static const std::string none;
+        const auto it = tokTypeToStr.find(type);
+        return it != tokTypeToStr.end() ? it->second : none;
+    }
+
 }
 
 
+// Well within the 8 MiB stack of a thread, a level takes a few hundred bytes of it
+constexpr uint32_t DEFAULT_MAX_NESTING_DEPTH = 2000;
+// The deepest that is still safe on an 8 MiB stack: the levels of nested dict displays, which take the most of
+// it, overflow it past about 19000 of them when optimised and 5900 when not
+constexpr uint32_t MAX_NESTING_DEPTH = 4000;
+
+// How PyLexer gets its tokens
+struct LexerOptions {
+    LexerKind kind = LexerKind::NATIVE;
+    SourceLoad load = SourceLoad::MMAP;
+    TokenBuffering buffering = TokenBuffering::FULL;
+    // more than 1 lexes big sources in parallel chunks (native lexer, FULL buffering only)
+    uint32_t num_of_threads = 1;
+    // the directory of the token cache, none if null (FULL buffering only)
+    const char *cache_dir = nullptr;
+    // the suites of the functions are skipped and parsed by parseBody() once needed (FULL buffering only)
+    bool lazy_bodies = false;
+    // the deepest the parser recurses (into nested expressions and blocks) before giving up on a statement
+    // with an error, rather than running out of the stack; no more than MAX_NESTING_DEPTH, a greater one is
+    // taken as that
+    uint32_t max_nesting_depth = DEFAULT_MAX_NESTING_DEPTH;
+    // the table the names are interned into, shared by every lexer given it (it has to be made shared, see
+    // SymbolTable), every lexer has one of its own if null
+    SymbolTable *symbols = nullptr;
+};
+
+
 class PyLexer {
 public:
-    explicit PyLexer(const char *path) {
-        std::ifstream stream(path);
-        if (!stream) {
-            throw std::runtime_error("path to the source is incorrect");
+    // The amount of tokens kept in the STREAM mode. The parser never holds on to a token
+    // for longer than a few consumes, so the window is way bigger than it needs to be.
+    static constexpr uint32_t STREAM_WINDOW = 256;
+
+    explicit PyLexer(const char *path, const LexerOptions &options = {})
+            : source_(path, options.load), symbols_(options.symbols ? *options.symbols : own_symbols_),
+              lazy_bodies_(options.lazy_bodies), max_nesting_depth_(std::min(options.max_nesting_depth, MAX_NESTING_DEPTH)) {
+        if (options.kind == LexerKind::NATIVE && options.buffering == TokenBuffering::STREAM) {
+            native_lexer_ = new NativeLexer(source_.data(), source_.size());
+            tokens_.initRing(STREAM_WINDOW);
+            tokens_.seal();
+            num_of_tokens_ = 0;
+            // the tokens of a skipped suite would be gone by the time it's parsed
+            lazy_bodies_ = false;
+            return;
+        }
+
+        if (options.cache_dir) {
+            token_cache_ = new TokenCache(options.cache_dir, options.kind);
+            if (token_cache_->load(source_.data(), source_.size(), tokens_, symbols_)) {
+                num_of_tokens_ = tokens_.size();
+                return;
+            }
         }
-        ANTLRInputStream input_stream(stream);
 
-        Python3Lexer lexer(&input_stream);
-        token_stream = new CommonTokenStream(&lexer);
-        token_stream->fill();
+        if (options.kind == LexerKind::ANTLR) {
+            fillFromAntlr();
+        } else if (options.num_of_threads > 1) {
+            const auto lexed_tokens = lexParallel(source_.data(), source_.size(), options.num_of_threads);
+            tokens_.reserve(lexed_tokens.size());
+            for (const auto &lexed : lexed_tokens) {
+                tokens_.push(lexed.type, lexed.start, lexed.length, lexed.line, symbolOf(lexed));
+            }
+        } else {
+            NativeLexer native_lexer(source_.data(), source_.size());
+            // a rough guess of the amount of tokens, saves a few reallocations
+            tokens_.reserve(source_.size() / 4);
+            LexedToken lexed;
+            while (native_lexer.next(lexed)) {
+                tokens_.push(lexed.type, lexed.start, lexed.length, lexed.line, symbolOf(lexed));
+            }
+        }
+        tokens_.seal();
+        num_of_tokens_ = tokens_.size();
+
+        if (token_cache_) {
+            token_cache_->store(source_.size(), tokens_);
+        }
+    }
 
-        tokens_ = token_stream->getTokens();
+    // Takes the tokens lexRegion() made of the part [begin, end) of the text, which is copied. Names and literals
+    // are interned into the given tables (they have to outlive the lexer), so that the nodes parsed out of
+    // different parts of a text can share them.
+    PyLexer(std::string_view text, size_t begin, size_t end, const std::vector<LexedToken> &lexed_tokens,
+            SymbolTable &symbols, LiteralPool &literals)
+            : source_(text.substr(begin, end - begin), begin), symbols_(symbols), literals_(literals) {
+        tokens_.reserve(lexed_tokens.size());
+        for (const auto &lexed : lexed_tokens) {
+            tokens_.push(lexed.type, lexed.start, lexed.length, lexed.line, symbolOf(lexed));
+        }
+        tokens_.seal();
         num_of_tokens_ = tokens_.size();
     }
 
-    Token *lookAhead(int32_t n) {
-        if (curr_idx_ + n - 1 >= num_of_tokens_ ||
-            curr_idx_ + n - 1 < 0) {
-            return nullptr;
+    // Lexes a copy of the text on its own, its first line being the given line of a longer input
+    // (i.e. a statement of an interactive session)
+    PyLexer(std::string_view text, uint32_t line) : source_(text, 0) {
+        NativeLexer native_lexer(source_.data(), source_.size());
+        LexedToken lexed;
+        while (native_lexer.next(lexed)) {
+            tokens_.push(lexed.type, lexed.start, lexed.length, lexed.line + line - 1, symbolOf(lexed));
         }
+        tokens_.seal();
+        num_of_tokens_ = tokens_.size();
+    }
 
-        return tokens_[curr_idx_ + n - 1];
+    // Returns the text of the token as a view into the source buffer
+    inline std::string_view text(const TokenRef token) const noexcept {
+        return source_.view(token.getStartIndex(), token.getLength());
     }
 
-    void updateCurr(int32_t n) {
-        const auto look_ahead_idx = curr_idx_ + n - 1;
-        if (look_ahead_idx >= num_of_tokens_ ||
-            look_ahead_idx < 0) {
+    // Takes ownership of a string that doesn't exist in the source as is (i.e. concatenated literals),
+    // the returned view lives as long as the lexer does
+    inline std::string_view keep(std::string &&text) {
+        return owned_text_.emplace_back(std::move(text));
+    }
+
+    // Interns a name that isn't a single NAME token (i.e. a dotted name), those are interned by the lexer
+    inline Symbol intern(std::string_view name) {
+        return symbols_.intern(name);
+    }
+
+    inline const SymbolTable &symbols() const noexcept { return symbols_; }
+
+    inline LiteralPool &literals() noexcept { return literals_; }
+
+    inline Diagnostics &diagnostics() noexcept { return diagnostics_; }
+
+    // The nodes parsed out of the source, released along with the lexer. Releasing it before that tears down every
+    // tree parsed so far at once.
+    inline Arena &arena() noexcept { return arena_; }
+
+    // the marks the statements get while parsing, none if null
+    inline std::vector<StmtMark> *stmtMarks() const noexcept { return stmt_marks_; }
+
+    inline void markStmts(std::vector<StmtMark> *marks) noexcept { stmt_marks_ = marks; }
 
-            curr = nullptr;
+    inline bool lazyBodies() const noexcept { return lazy_bodies_; }
+
+    // the levels the parser is nested in at the moment (see NestingGuard), and how many it may be nested in
+    inline uint32_t &nestingDepth() noexcept { return nesting_depth_; }
+
+    inline uint32_t maxNestingDepth() const noexcept { return max_nesting_depth_; }
+
+    TokenRef lookAhead(int32_t n) const {
+        const int64_t idx = curr_idx_ + n - 1;
+        // the last condition holds for the tokens that have already left the streaming window
+        if (idx >= num_of_tokens_ ||
+            idx < 0 ||
+            idx + tokens_.mask + 1 < num_of_tokens_) {
+            return {};
+        }
+
+        return {&tokens_, static_cast<uint32_t>(curr_idx_ + n - 1)};
+    }
+
+    void updateCurr(int32_t n) {
+        if (native_lexer_) {
+            // the new current token and the one after it
+            lexUntil(curr_idx_ + n);
         }
         prev = curr;
-        curr = tokens_[look_ahead_idx];
+        curr = lookAhead(n);
         curr_idx_ += 1;
         next = lookAhead(1);
-        (void) n;
     }
 
     void consume(int32_t token_type) {
-        if (curr->getType() == static_cast<size_t>(token_type)) {
+        if (curr.getType() == static_cast<size_t>(token_type)) {
             updateCurr(1);
         } else {
-            // TODO(threadedstream): do cleanup
-            fprintf(stderr, "expected %s, but got %s at line %ld", tok_utils::tokTypeToStr[token_type].c_str(), tok_utils::tokTypeToStr[curr->getType()].c_str(), curr->getLine());
-            exit(1);
+            throw ParseError{"expected " + tok_utils::tokTypeName(token_type) + ", but got " +
+                             tok_utils::tokTypeName(curr.getType()), curr ? curr.getLine() : 0,
+                             curr.getTokenIndex()};
         }
     }
 
+    // Makes the token at idx the current one, going back and forth over the whole table (FULL buffering only)
+    void seek(uint32_t idx) {
+        curr_idx_ = static_cast<int32_t>(idx);
+        prev = lookAhead(0);
+        curr = lookAhead(1);
+        curr_idx_ += 1;
+        next = lookAhead(1);
+    }
+
     void backtrack() {
         next = curr;
         curr = prev;
@@ -482,20 +749,89 @@ public:
         prev = lookAhead(-1);
     }
 
-    inline std::vector<Token *> tokens() const noexcept { return tokens_; }
+    // Every token of the source, unless the lexer is streaming
+    inline const TokenTable &tokens() const noexcept { return tokens_; }
+
+    inline TokenRef token(uint32_t idx) const noexcept { return {&tokens_, idx}; }
+
+    inline const SourceBuffer &source() const noexcept { return source_; }
 
     ~PyLexer() {
-        delete token_stream;
+        delete native_lexer_;
+        delete token_cache_;
     }
 
 public:
-    Token *curr;
-    Token *next;
-    Token *prev;
+    TokenRef curr;
+    TokenRef next;
+    TokenRef prev;
 
 private:
-    CommonTokenStream *token_stream;
-    std::vector<Token *> tokens_;
+    inline Symbol symbolOf(const LexedToken &lexed) {
+        return lexed.type == Python3Parser::NAME ? symbols_.intern(source_.view(lexed.start, lexed.length)) : NO_SYMBOL;
+    }
+
+    // Lexes tokens into the window until the one at idx is there or EOF has been reached
+    void lexUntil(int32_t idx) {
+        LexedToken lexed;
+        while (num_of_tokens_ <= idx && native_lexer_->next(lexed)) {
+            tokens_.store(num_of_tokens_, lexed.type, lexed.start, lexed.length, lexed.line, symbolOf(lexed));
+            num_of_tokens_++;
+        }
+    }
+
+    // Runs the generated lexer and copies its tokens into the table. ANTLR indexes tokens by
+    // code points, whereas the table stores byte offsets into the source.
+    void fillFromAntlr() {
+        ANTLRInputStream input_stream(source_.data(), source_.size());
+        Python3Lexer antlr_lexer(&input_stream);
+        CommonTokenStream token_stream(&antlr_lexer);
+        token_stream.fill();
+
+        std::vector<size_t> offsets;
+        offsets.reserve(source_.size() + 1);
+        for (size_t i = 0; i < source_.size(); ++i) {
+            if ((static_cast<unsigned char>(source_.data()[i]) & 0xC0) != 0x80) {
+                offsets.push_back(i);
+            }
+        }
+        offsets.push_back(source_.size());
+
+        const auto num_of_code_points = offsets.size() - 1;
+        const auto &antlr_tokens = token_stream.getTokens();
+        tokens_.reserve(antlr_tokens.size());
+        for (const auto token: antlr_tokens) {
+            // tokens made up by the lexer (NEWLINE, DEDENT, EOF) may point anywhere
+            const auto start = std::min(token->getStartIndex(), num_of_code_points);
+            const auto stop = token->getStopIndex();
+            const auto byte_start = offsets[start];
+            const auto byte_end = stop >= start && stop < num_of_code_points ? offsets[stop + 1] : byte_start;
+
+            const auto type = token->getType();
+            const auto symbol = type == Python3Parser::NAME
+                                ? symbols_.intern(source_.view(byte_start, byte_end - byte_start)) : NO_SYMBOL;
+            tokens_.push(type, byte_start, byte_end - byte_start, token->getLine(), symbol);
+        }
+    }
+
+    SourceBuffer source_;
+    // set in the STREAM mode only
+    NativeLexer *native_lexer_ = nullptr;
+    // set if the tokens are cached, the table may point into its mapping
+    TokenCache *token_cache_ = nullptr;
+    std::deque<std::string> owned_text_;
+    SymbolTable own_symbols_;
+    LiteralPool own_literals_;
+    // the own tables, unless they are shared with the lexers of other parts of the text (or of other sources)
+    SymbolTable &symbols_ = own_symbols_;
+    LiteralPool &literals_ = own_literals_;
+    Diagnostics diagnostics_;
+    Arena arena_;
+    std::vector<StmtMark> *stmt_marks_ = nullptr;
+    bool lazy_bodies_ = false;
+    uint32_t nesting_depth_ = 0;
+    uint32_t max_nesting_depth_ = DEFAULT_MAX_NESTING_DEPTH;
+    TokenTable tokens_;
     int32_t num_of_tokens_;
     int32_t curr_idx_ = 0;
 };
@@ -508,129 +844,32 @@ struct Position {
 } __attribute__((aligned(16)));
 
 
-inline Position getTokPos(const Token *tok) {
+inline Position getTokPos(const TokenRef tok) {
     Position pos = {};
-    pos.line_start = tok->getLine();
-    pos.col_start_idx = tok->getStartIndex();
-    pos.col_end_idx = tok->getStopIndex();
+    pos.line_start = tok.getLine();
+    pos.col_start_idx = tok.getStartIndex();
+    pos.col_end_idx = tok.getStopIndex();
 
     return pos;
 }
 
-static inline bool isStmt(const Token *tok) {
-    const auto current_token_type = tok->getType();
-    return current_token_type == Python3Parser::STRING ||
-           current_token_type == Python3Parser::NUMBER ||
-           current_token_type == Python3Parser::DEF ||
-           current_token_type == Python3Parser::RETURN ||
-           current_token_type == Python3Parser::RAISE ||
-           current_token_type == Python3Parser::FROM ||
-           current_token_type == Python3Parser::IMPORT ||
-           current_token_type == Python3Parser::GLOBAL ||
-           current_token_type == Python3Parser::NONLOCAL ||
-           current_token_type == Python3Parser::ASSERT ||
-           current_token_type == Python3Parser::IF ||
-           current_token_type == Python3Parser::WHILE ||
-           current_token_type == Python3Parser::FOR ||
-           current_token_type == Python3Parser::TRY ||
-           current_token_type == Python3Parser::WITH ||
-           current_token_type == Python3Parser::LAMBDA ||
-           current_token_type == Python3Parser::NOT ||
-           current_token_type == Python3Parser::NONE ||
-           current_token_type == Python3Parser::TRUE ||
-           current_token_type == Python3Parser::FALSE ||
-           current_token_type == Python3Parser::CLASS ||
-           current_token_type == Python3Parser::YIELD ||
-           current_token_type == Python3Parser::DEL ||
-           current_token_type == Python3Parser::PASS ||
-           current_token_type == Python3Parser::CONTINUE ||
-           current_token_type == Python3Parser::BREAK ||
-           current_token_type == Python3Parser::ASYNC ||
-           current_token_type == Python3Parser::AWAIT ||
-           current_token_type == Python3Parser::NEWLINE ||
-           current_token_type == Python3Parser::NAME ||
-           current_token_type == Python3Parser::ELLIPSIS ||
-           current_token_type == Python3Parser::STAR ||
-           current_token_type == Python3Parser::OPEN_PAREN ||
-           current_token_type == Python3Parser::OPEN_BRACK ||
-           current_token_type == Python3Parser::ADD ||
-           current_token_type == Python3Parser::MINUS ||
-           current_token_type == Python3Parser::NOT_OP ||
-           current_token_type == Python3Parser::OPEN_BRACE ||
-           current_token_type == Python3Parser::AT;
+// NEWLINE or the start of a statement, i.e. anything file_input may go on with
+static inline bool isStmt(const TokenRef tok) {
+    constexpr auto file_input_item = FIRST_STMT | TokenSet::of({Python3Parser::NEWLINE});
+    return file_input_item.contains(tok.getType());
 }
 
-inline bool isAugAssign(const Token *tok) {
-    const auto token_type = tok->getType();
-
-    return token_type == Python3Parser::ADD_ASSIGN ||
-           token_type == Python3Parser::SUB_ASSIGN ||
-           token_type == Python3Parser::MULT_ASSIGN ||
-           token_type == Python3Parser::AT_ASSIGN ||
-           token_type == Python3Parser::DIV_ASSIGN ||
-           token_type == Python3Parser::MOD_ASSIGN ||
-           token_type == Python3Parser::AND_ASSIGN ||
-           token_type == Python3Parser::OR_ASSIGN ||
-           token_type == Python3Parser::XOR_ASSIGN ||
-           token_type == Python3Parser::LEFT_SHIFT_ASSIGN ||
-           token_type == Python3Parser::RIGHT_SHIFT_ASSIGN ||
-           token_type == Python3Parser::POWER_ASSIGN ||
-           token_type == Python3Parser::IDIV_ASSIGN;
-}
-
-
-inline bool isArithOp(const Token *tok) {
-    const auto token_type = tok->getType();
-    return token_type == Python3Parser::ADD || token_type == Python3Parser::MINUS;
+inline bool isAugAssign(const TokenRef tok) {
+    return FIRST_AUGASSIGN.contains(tok.getType());
 }
 
-inline bool isTermOp(const Token *tok) {
-    const auto token_type = tok->getType();
-    return token_type == Python3Parser::STAR ||
-           token_type == Python3Parser::DIV ||
-           token_type == Python3Parser::IDIV ||
-           token_type == Python3Parser::MOD;
-}
 
-inline bool isTest(const Token *tok) {
-    const auto token_type = tok->getType();
-    return token_type == Python3Parser::STRING ||
-           token_type == Python3Parser::NUMBER ||
-           token_type == Python3Parser::LAMBDA ||
-           token_type == Python3Parser::NOT ||
-           token_type == Python3Parser::NONE ||
-           token_type == Python3Parser::TRUE ||
-           token_type == Python3Parser::FALSE ||
-           token_type == Python3Parser::AWAIT ||
-           token_type == Python3Parser::NAME ||
-           token_type == Python3Parser::ELLIPSIS ||
-           token_type == Python3Parser::OPEN_PAREN ||
-           token_type == Python3Parser::OPEN_BRACK ||
-           token_type == Python3Parser::ADD ||
-           token_type == Python3Parser::MINUS ||
-           token_type == Python3Parser::NOT_OP ||
-           token_type == Python3Parser::OPEN_BRACE;
+inline bool isTest(const TokenRef tok) {
+    return FIRST_TEST.contains(tok.getType());
 }
 
-inline bool isTestlistComp(const Token *tok) {
-    const auto token_type = tok->getType();
-    return token_type == Python3Parser::STRING ||
-           token_type == Python3Parser::NUMBER ||
-           token_type == Python3Parser::LAMBDA ||
-           token_type == Python3Parser::NOT ||
-           token_type == Python3Parser::NONE ||
-           token_type == Python3Parser::TRUE ||
-           token_type == Python3Parser::FALSE ||
-           token_type == Python3Parser::AWAIT ||
-           token_type == Python3Parser::NAME ||
-           token_type == Python3Parser::ELLIPSIS ||
-           token_type == Python3Parser::STAR ||
-           token_type == Python3Parser::OPEN_PAREN ||
-           token_type == Python3Parser::OPEN_BRACK ||
-           token_type == Python3Parser::ADD ||
-           token_type == Python3Parser::MINUS ||
-           token_type == Python3Parser::NOT_OP ||
-           token_type == Python3Parser::OPEN_BRACE;
+inline bool isTestlistComp(const TokenRef tok) {
+    return FIRST_TESTLIST_COMP.contains(tok.getType());
 }
 
 inline bool isCompOp(PyLexer &lexer, bool &eat_twice, int32_t &op_type) {
@@ -638,8 +877,8 @@ inline bool isCompOp(PyLexer &lexer, bool &eat_twice, int32_t &op_type) {
         return false;
     }
 
-    const auto token_type = lexer.curr->getType();
-    const auto next_token_type = lexer.next->getType();
+    const auto token_type = lexer.curr.getType();
+    const auto next_token_type = lexer.next.getType();
 
     if ((token_type == Python3Parser::NOT && next_token_type == Python3Parser::IN) ||
         (token_type == Python3Parser::IS && next_token_type == Python3Parser::NOT)) {
@@ -649,216 +888,302 @@ inline bool isCompOp(PyLexer &lexer, bool &eat_twice, int32_t &op_type) {
     }
 
 
-    return (op_type = (LESS_THAN * (token_type == Python3Parser::LESS_THAN)) ||
-                      (GREATER_THAN * (token_type == Python3Parser::GREATER_THAN)) ||
-                      (EQUALS * (token_type == Python3Parser::EQUALS)) ||
-                      (GT_EQ * (token_type == Python3Parser::GT_EQ)) ||
-                      (LT_EQ * (token_type == Python3Parser::LT_EQ)) ||
-                      (NOT_EQ_2 * (token_type == Python3Parser::NOT_EQ_2)) ||
-                      (IN * (token_type == Python3Parser::IN)) ||
-                      (NOT_IN * (token_type == Python3Parser::NOT && next_token_type == Python3Parser::IN)) ||
-                      (IS * (token_type == Python3Parser::IS)) ||
-                      (IS_NOT * (token_type == Python3Parser::IS && next_token_type == Python3Parser::NOT)));
+    // at most one of the terms isn't zero
+    op_type = (LESS_THAN * (token_type == Python3Parser::LESS_THAN)) +
+              (GREATER_THAN * (token_type == Python3Parser::GREATER_THAN)) +
+              (EQUALS * (token_type == Python3Parser::EQUALS)) +
+              (GT_EQ * (token_type == Python3Parser::GT_EQ)) +
+              (LT_EQ * (token_type == Python3Parser::LT_EQ)) +
+              (NOT_EQ_2 * (token_type == Python3Parser::NOT_EQ_2)) +
+              (IN * (token_type == Python3Parser::IN)) +
+              (NOT_IN * (token_type == Python3Parser::NOT && next_token_type == Python3Parser::IN)) +
+              (IS * (token_type == Python3Parser::IS && next_token_type != Python3Parser::NOT)) +
+              (IS_NOT * (token_type == Python3Parser::IS && next_token_type == Python3Parser::NOT));
+    return op_type != 0;
 
 }
 
+// A piece of the string of a node, either a text of its own or a child whose string goes in its place
+// (None if the child is null)
+struct StrPart {
+    StrPart(const char *text) : text(text) {}
+
+    StrPart(std::string text) : text(std::move(text)) {}
+
+    StrPart(const Node *child) : child(child), is_child(true) {}
+
+    std::string text;
+    const Node *child = nullptr;
+    bool is_child = false;
+};
+
+// Nodes are made in the arena of the current ArenaScope (the one of the lexer while parsing, see PyLexer::arena())
+// and go away all at once along with it. Nothing a node holds needs its destructor to run: the children and their
+// arrays are in the arena too, the texts are views. Deleting a node doesn't free anything.
 struct Node {
     // TODO(threadedstream): fill in the rest
 
+    explicit Node(NodeKind kind) : kind(kind) {}
+
     virtual ~Node() {};
 
-    virtual std::string str() const noexcept {
-        return "";
+    static void *operator new(size_t size) {
+        const auto arena = Arena::current();
+        if (!arena) {
+            throw std::logic_error("a node can only be made in an ArenaScope");
+        }
+        return arena->allocate(size, alignof(Node));
     }
 
-    virtual std::vector<Node *> getChildren() { return {}; }
+    static void operator delete(void *) noexcept {}
+
+    // The string of the node along with the ones of its children. Built with an explicit stack rather than
+    // by recursion, so a tree of any depth is fine.
+    std::string str() const noexcept;
+
+    // Appends the parts the string of the node is made of
+    virtual void strParts(std::vector<StrPart> &) const {}
+
+    // Calls visit(child) for every child of the node, the missing ones being null. A switch on the kind picks the
+    // visitChildren() of the type (defined at the end of the file, once all of them are), so nothing is allocated
+    // and nothing is called through the vtable. The child is the member (or the element of a list) itself, so a
+    // visit taking an auto & may replace it.
+    template<typename F>
+    inline void forEachChild(F &&visit);
+
+    // The children of the type in the order forEachChild() goes in, the types with none have this one
+    template<typename F>
+    inline void visitChildren(F &&) {}
 
     // n - child to add to the parent node
     // next_arg - needed for functions (likely to be removed)
     virtual void addChild(Node *n, const bool next_arg = false) noexcept {}
 
+    // the type of the node, set by its constructor (it takes the padding in front of pos_info, so it's free)
+    NodeKind kind;
     Position pos_info;
 };
 
 struct FileInput : public Node {
-    explicit FileInput(const std::vector<Node *> statements)
-            : statements(statements) {}
+    explicit FileInput(NodeList statements)
+            : Node(NodeKind::FileInput), statements(std::move(statements)) {}
+
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.emplace_back("FileInput([");
+        parts.insert(parts.end(), statements.begin(), statements.end());
+        parts.emplace_back("])");
+    }
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: statements) {
+            visit(child);
+        }
+    }
 
-    std::vector<Node *> statements;
+    NodeList statements;
 };
 
 struct Module : public Node {
-    Module(const std::string &doc, Node *expr) : expr(expr), doc(doc) {}
+    Module(std::string_view doc, Node *expr) : Node(NodeKind::Module), expr(expr), doc(doc) {}
 
-    std::string str() const noexcept override {
-        std::ostringstream module_str;
-        module_str << "Module(doc=" << (doc != "" ? doc : "None") << ",expr=" << expr->str() << ")";
-        return module_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"Module(doc=" + std::string(doc != "" ? doc : "None") + ",expr=", expr, ")"});
     }
 
-    virtual std::vector<Node *> getChildren() {
-        return {expr};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(expr);
     }
 
     Node *expr;
-    std::string doc;
+    std::string_view doc;
 };
 
 struct Comprehension : public Node {
-    explicit Comprehension(Node *target, Node *iter, std::vector<Node *> ifs, bool is_async)
-            : target(target), iter(iter), ifs(ifs), is_async(is_async) {}
+    explicit Comprehension(Node *target, Node *iter, NodeList ifs, bool is_async)
+            : Node(NodeKind::Comprehension), target(target), iter(iter), ifs(std::move(ifs)), is_async(is_async) {}
 
 
-    virtual std::vector<Node *> getChildren() {
-        auto temp = ifs;
-        temp.push_back(target);
-        temp.push_back(iter);
-
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: ifs) {
+            visit(child);
+        }
+        visit(target);
+        visit(iter);
     }
 
     Node *target;
     Node *iter;
-    std::vector<Node *> ifs;
+    NodeList ifs;
     bool is_async;
 };
 
 struct GeneratorExp : public Node {
-    explicit GeneratorExp(Node *elt, std::vector<Node *> generators)
-            : elt(elt), generators(generators) {}
+    explicit GeneratorExp(Node *elt, NodeList generators)
+            : Node(NodeKind::GeneratorExp), elt(elt), generators(std::move(generators)) {}
 
-    virtual std::vector<Node *> getChildren() {
-        auto temp = generators;
-        temp.push_back(elt);
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: generators) {
+            visit(child);
+        }
+        visit(elt);
     }
 
     Node *elt;
-    std::vector<Node *> generators;
+    NodeList generators;
 };
 
 struct Dict : public Node {
-    explicit Dict(std::vector<Node *> keys, std::vector<Node *> values)
-            : keys(keys), values(values) {}
+    explicit Dict(NodeList keys, NodeList values)
+            : Node(NodeKind::Dict), keys(std::move(keys)), values(std::move(values)) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = keys;
-        temp.insert(temp.end(), values.begin(), values.end());
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: keys) {
+            visit(child);
+        }
+        for (auto &child: values) {
+            visit(child);
+        }
     }
 
-    std::vector<Node *> keys;
-    std::vector<Node *> values;
+    NodeList keys;
+    NodeList values;
 };
 
 struct DictComp : public Node {
-    explicit DictComp(Node *key, Node *value, const std::vector<Node *> &generators)
-            : key(key), value(value), generators(generators) {}
+    explicit DictComp(Node *key, Node *value, NodeList generators)
+            : Node(NodeKind::DictComp), key(key), value(value), generators(std::move(generators)) {}
 
 
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = generators;
-        temp.push_back(key);
-        temp.push_back(value);
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: generators) {
+            visit(child);
+        }
+        visit(key);
+        visit(value);
     }
 
     Node *key;
     Node *value;
-    std::vector<Node *> generators;
+    NodeList generators;
 };
 
 struct Set : public Node {
-    explicit Set(const std::vector<Node *> &elements)
-            : elements(elements) {}
+    explicit Set(NodeList elements)
+            : Node(NodeKind::Set), elements(std::move(elements)) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = elements;
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: elements) {
+            visit(child);
+        }
     }
 
-    std::vector<Node *> elements;
+    NodeList elements;
 };
 
 struct List : public Node {
-    explicit List(const std::vector<Node *> &elements)
-            : elements(elements) {}
+    explicit List(NodeList elements)
+            : Node(NodeKind::List), elements(std::move(elements)) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = elements;
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: elements) {
+            visit(child);
+        }
     }
 
-    std::vector<Node *> elements;
+    NodeList elements;
 };
 
 struct ListComp : public Node {
-    explicit ListComp(Node *value, const std::vector<Node *> &generators)
-            : value(value), generators(generators) {}
+    explicit ListComp(Node *value, NodeList generators)
+            : Node(NodeKind::ListComp), value(value), generators(std::move(generators)) {}
 
 
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = generators;
-        generators.push_back(value);
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: generators) {
+            visit(child);
+        }
+        visit(value);
     }
 
     Node *value;
-    std::vector<Node *> generators;
+    NodeList generators;
 };
 
 struct SetComp : public Node {
-    explicit SetComp(Node *value, const std::vector<Node *> &generators)
-            : value(value), generators(generators) {}
+    explicit SetComp(Node *value, NodeList generators)
+            : Node(NodeKind::SetComp), value(value), generators(std::move(generators)) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = generators;
-        generators.push_back(value);
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: generators) {
+            visit(child);
+        }
+        visit(value);
     }
 
     Node *value;
-    std::vector<Node *> generators;
+    NodeList generators;
 };
 
 struct Stmt : public Node {
-    explicit Stmt(const std::vector<Node *> &nodes)
-            : nodes(nodes) {}
-
-    std::string str() const noexcept override {
-        std::ostringstream stmt_str;
-        stmt_str << "Stmt([";
-        for (const auto &node: nodes) {
-            stmt_str << node->str();
-        }
+    explicit Stmt(NodeList nodes)
+            : Node(NodeKind::Stmt), nodes(std::move(nodes)) {}
 
-        stmt_str << "])";
-
-        return stmt_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.emplace_back("Stmt([");
+        parts.insert(parts.end(), nodes.begin(), nodes.end());
+        parts.emplace_back("])");
     }
 
-    virtual std::vector<Node *> getChildren() {
-        auto temp = nodes;
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: nodes) {
+            visit(child);
+        }
     }
 
-    std::vector<Node *> nodes;
+    NodeList nodes;
 };
 
 struct SimpleStmt : public Node {
-    explicit SimpleStmt(const std::vector<Node *> &small_stmts)
-            : small_stmts(small_stmts) {}
+    explicit SimpleStmt(NodeList small_stmts)
+            : Node(NodeKind::SimpleStmt), small_stmts(std::move(small_stmts)) {}
 
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.emplace_back("SimpleStmt([");
+        parts.insert(parts.end(), small_stmts.begin(), small_stmts.end());
+        parts.emplace_back("])");
+    }
 
-    std::vector<Node *> small_stmts;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: small_stmts) {
+            visit(child);
+        }
+    }
+
+    NodeList small_stmts;
 };
 
 struct ForStmt : public Node {
     explicit ForStmt(Node *target, Node *iter, Node *body, Node *or_else)
-            : target(target), iter(iter), body(body), or_else(or_else) {}
+            : Node(NodeKind::ForStmt), target(target), iter(iter), body(body), or_else(or_else) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        return {target, iter, body, or_else};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(target);
+        visit(iter);
+        visit(body);
+        visit(or_else);
     }
 
     Node *target;
@@ -869,9 +1194,9 @@ struct ForStmt : public Node {
 
 struct AsyncForStmt : public Node {
     explicit AsyncForStmt(Node *target, Node *iter, Node *body, Node *or_else)
-            : target(target), iter(iter), body(body), or_else(or_else) {}
+            : Node(NodeKind::AsyncForStmt), target(target), iter(iter), body(body), or_else(or_else) {}
 
-    explicit AsyncForStmt(ForStmt *for_stmt, bool destroy_for_stmt) :
+    explicit AsyncForStmt(ForStmt *for_stmt, bool destroy_for_stmt) : Node(NodeKind::AsyncForStmt),
             target(for_stmt->target), iter(for_stmt->iter), body(for_stmt->body), or_else(for_stmt->or_else) {
         if (destroy_for_stmt) {
             delete for_stmt;
@@ -879,8 +1204,12 @@ struct AsyncForStmt : public Node {
         }
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        return {target, iter, body, or_else};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(target);
+        visit(iter);
+        visit(body);
+        visit(or_else);
     }
 
 
@@ -891,54 +1220,59 @@ struct AsyncForStmt : public Node {
 };
 
 struct WithStmt : public Node {
-    explicit WithStmt(const std::vector<Node *> items, Node *body, Node *type_comment)
-            : body(body), type_comment(type_comment), items(items) {}
+    explicit WithStmt(NodeList items, Node *body, Node *type_comment)
+            : Node(NodeKind::WithStmt), body(body), type_comment(type_comment), items(std::move(items)) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        // coalesce two vectors into the single one
-        auto temp = items;
-        temp.push_back(body);
-        temp.push_back(type_comment);
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: items) {
+            visit(child);
+        }
+        visit(body);
+        visit(type_comment);
     }
 
     Node *body;
     Node *type_comment;
-    std::vector<Node *> items;
+    NodeList items;
 };
 
 struct AsyncWithStmt : public Node {
-    explicit AsyncWithStmt(const std::vector<Node *> items, Node *body, Node *type_comment)
-            : body(body), type_comment(type_comment), items(items) {}
+    explicit AsyncWithStmt(NodeList items, Node *body, Node *type_comment)
+            : Node(NodeKind::AsyncWithStmt), body(body), type_comment(type_comment), items(std::move(items)) {}
 
     explicit AsyncWithStmt(WithStmt *with_stmt, bool destroy_with_stmt)
-            : body(with_stmt->body), type_comment(with_stmt->type_comment), items(with_stmt->items) {
+            : Node(NodeKind::AsyncWithStmt), body(with_stmt->body), type_comment(with_stmt->type_comment),
+              items(with_stmt->items) {
         if (destroy_with_stmt) {
             delete with_stmt;
             with_stmt = nullptr;
         }
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        // coalesce two vectors into the single one
-        auto temp = items;
-        temp.push_back(body);
-        temp.push_back(type_comment);
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: items) {
+            visit(child);
+        }
+        visit(body);
+        visit(type_comment);
     }
 
 
     Node *body;
     Node *type_comment;
-    std::vector<Node *> items;
+    NodeList items;
 };
 
 struct WithItem : public Node {
     explicit WithItem(Node *context_expr, Node *optional_vars)
-            : context_expr(context_expr), optional_vars(optional_vars) {}
+            : Node(NodeKind::WithItem), context_expr(context_expr), optional_vars(optional_vars) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        return {context_expr, optional_vars};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(context_expr);
+        visit(optional_vars);
     }
 
     Node *context_expr;
@@ -946,77 +1280,87 @@ struct WithItem : public Node {
 };
 
 struct TryStmt : public Node {
-    explicit TryStmt(Node *body, std::vector<Node *> handlers, Node *or_else, Node *final_body)
-            : body(body), or_else(or_else), final_body(final_body), handlers(handlers) {}
+    explicit TryStmt(Node *body, NodeList handlers, Node *or_else, Node *final_body)
+            : Node(NodeKind::TryStmt), body(body), or_else(or_else), final_body(final_body),
+              handlers(std::move(handlers)) {}
 
 
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = handlers;
-        temp.push_back(body);
-        temp.push_back(or_else);
-        temp.push_back(final_body);
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: handlers) {
+            visit(child);
+        }
+        visit(body);
+        visit(or_else);
+        visit(final_body);
     }
 
     Node *body;
     Node *or_else;
     Node *final_body;
-    std::vector<Node *> handlers;
+    NodeList handlers;
 };
 
 struct ExceptHandler : public Node {
-    explicit ExceptHandler(Node *type, const std::string &name, Node *body)
-            : type(type), body(body), name(name) {}
+    explicit ExceptHandler(Node *type, std::string_view name, Node *body)
+            : Node(NodeKind::ExceptHandler), type(type), body(body), name(name) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        return {type, body};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(type);
+        visit(body);
     }
 
     Node *type;
     Node *body;
-    std::string name;
+    std::string_view name;
+    Symbol name_symbol = NO_SYMBOL;
 };
 
 struct ExprList : public Node {
-    explicit ExprList(const std::vector<Node *> &expr_list)
-            : expr_list(expr_list) {}
-
-    virtual std::string str() const noexcept override {
-        return "";
-    }
+    explicit ExprList(NodeList expr_list)
+            : Node(NodeKind::ExprList), expr_list(std::move(expr_list)) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = expr_list;
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: expr_list) {
+            visit(child);
+        }
     }
 
-    std::vector<Node *> expr_list;
+    NodeList expr_list;
 };
 
 struct ClassDef : public Node {
-    explicit ClassDef(const std::string &name, Arguments *arguments,
-                      Node *body, std::vector<Node *> decorator_list)
-            : body(body), arguments(arguments), decorator_list(decorator_list), name(name) {}
-
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = decorator_list;
-        temp.push_back(body);
-        temp.push_back(reinterpret_cast<Node *>(arguments));
-        return temp;
+    explicit ClassDef(std::string_view name, Arguments *arguments,
+                      Node *body, NodeList decorator_list)
+            : Node(NodeKind::ClassDef), body(body), arguments(arguments), decorator_list(std::move(decorator_list)),
+              name(name) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: decorator_list) {
+            visit(child);
+        }
+        visit(body);
+        visit(arguments);
     }
 
     Node *body;
     Arguments *arguments;
-    std::vector<Node *> decorator_list;
-    std::string name;
+    NodeList decorator_list;
+    std::string_view name;
+    Symbol name_symbol = NO_SYMBOL;
 };
 
 struct Attribute : public Node {
     explicit Attribute(Node *value, Node *attr)
-            : value(value), attr(attr) {}
+            : Node(NodeKind::Attribute), value(value), attr(attr) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        return {value, attr};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(value);
+        visit(attr);
     }
 
     Node *value;
@@ -1026,16 +1370,17 @@ struct Attribute : public Node {
 
 struct IfStmt : public Node {
     explicit IfStmt(Node *test, Node *body, Node *or_else)
-            : test(test), body(body), or_else(or_else) {}
+            : Node(NodeKind::IfStmt), test(test), body(body), or_else(or_else) {}
 
-    virtual std::string str() const noexcept override {
-        std::ostringstream if_str;
-        if_str << "IfStmt(test=" << test->str() << ",body=" << body->str() << ",or_else=" << or_else->str() << ")";
-        return if_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"IfStmt(test=", test, ",body=", body, ",or_else=", or_else, ")"});
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        return {test, body, or_else};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(test);
+        visit(body);
+        visit(or_else);
     }
 
     Node *test;
@@ -1043,12 +1388,41 @@ struct IfStmt : public Node {
     Node *or_else;
 };
 
+struct Alias : public Node {
+    explicit Alias(Node *name, Name *as)
+            : Node(NodeKind::Alias), name(name), as(as) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(name);
+        visit(as);
+    }
+
+    Node *name;
+    Name *as;
+};
+
+struct Aliases : public Node {
+    explicit Aliases(ArenaVector<Alias *> aliases)
+            : Node(NodeKind::Aliases), aliases(std::move(aliases)) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: aliases) {
+            visit(child);
+        }
+    }
+
+    ArenaVector<Alias *> aliases;
+};
+
 struct Import : public Node {
     explicit Import(Aliases *aliases)
-            : aliases(aliases) {}
+            : Node(NodeKind::Import), aliases(aliases) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        return {reinterpret_cast<Node *>(aliases)};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(aliases);
     }
 
     Aliases *aliases;
@@ -1056,10 +1430,12 @@ struct Import : public Node {
 
 struct ImportFrom : public Node {
     explicit ImportFrom(Node *module, Aliases *aliases, int32_t level)
-            : module(module), aliases(aliases), level(level) {}
+            : Node(NodeKind::ImportFrom), module(module), aliases(aliases), level(level) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        return {module, reinterpret_cast<Node *>(aliases)};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(module);
+        visit(aliases);
     }
 
     Node *module;
@@ -1068,58 +1444,61 @@ struct ImportFrom : public Node {
 };
 
 struct TestList : public Node {
-    explicit TestList(const std::vector<Node *> &nodes)
-            : nodes(nodes) {}
+    explicit TestList(NodeList nodes)
+            : Node(NodeKind::TestList), nodes(std::move(nodes)) {}
 
-    virtual std::string str() const noexcept override {
-        std::ostringstream test_list_str;
-        for (const auto node: nodes) {
-            test_list_str << node->str();
-        }
-        return test_list_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), nodes.begin(), nodes.end());
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        auto temp = nodes;
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: nodes) {
+            visit(child);
+        }
     }
 
-    std::vector<Node *> nodes;
+    NodeList nodes;
 };
 
 
 struct Return : public Node {
     explicit Return(TestList *test_list)
-            : test_list(test_list) {}
+            : Node(NodeKind::Return), test_list(test_list) {}
 
 
-    virtual std::string str() const noexcept override {
-        std::ostringstream return_str;
-        return_str << "Return(expr=" << test_list->str() << ")";
-        return return_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"Return(expr=", test_list, ")"});
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        return {test_list};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(test_list);
     }
 
     TestList *test_list;
 };
 
 struct Break : public Node {
-    Break() {}
+    Break() : Node(NodeKind::Break) {}
 };
 
 struct Continue : public Node {
-    Continue() {}
+    Continue() : Node(NodeKind::Continue) {}
 };
 
 struct Assign : public Node {
     explicit Assign(TestList *targets, Node *value)
-            : targets(targets), value(value) {}
+            : Node(NodeKind::Assign), targets(targets), value(value) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        return {targets, value};
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"Assign(targets=", targets, ",value=", value, ")"});
+    }
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(targets);
+        visit(value);
     }
 
     TestList *targets;
@@ -1128,11 +1507,13 @@ struct Assign : public Node {
 
 struct AugAssign : public Node {
     explicit AugAssign(Node *target, const int32_t op, Node *value)
-            : target(target), value(value), op(op) {}
+            : Node(NodeKind::AugAssign), target(target), value(value), op(op) {}
 
 
-    virtual std::vector<Node *> getChildren() override {
-        return {target, value};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(target);
+        visit(value);
     }
 
     Node *target;
@@ -1143,10 +1524,13 @@ struct AugAssign : public Node {
 
 struct AnnAssign : public Node {
     explicit AnnAssign(Node *target, Node *annotation, Node *value)
-            : target(target), annotation(annotation), value(value) {}
+            : Node(NodeKind::AnnAssign), target(target), annotation(annotation), value(value) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        return {target, annotation, value};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(target);
+        visit(annotation);
+        visit(value);
     }
 
     Node *target;
@@ -1155,10 +1539,10 @@ struct AnnAssign : public Node {
 };
 
 struct AssName : public Node {
-    explicit AssName(const std::string &name, AssignFlag flags)
-            : name(name), flags(flags) {}
+    explicit AssName(std::string_view name, AssignFlag flags)
+            : Node(NodeKind::AssName), name(name), flags(flags) {}
 
-    std::string name;
+    std::string_view name;
     AssignFlag flags;
 };
 
@@ -1166,19 +1550,27 @@ struct AssName : public Node {
 // TODO(threadedstream): What meaning does Discard possess?
 struct Discard : public Node {
     explicit Discard(Node *expr)
-            : expr(expr) {}
+            : Node(NodeKind::Discard), expr(expr) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(expr);
+    }
 
     Node *expr;
 };
 
 struct StarredExpr : public Node {
     explicit StarredExpr(Node *expr)
-            : expr(expr) {}
+            : Node(NodeKind::StarredExpr), expr(expr) {}
 
-    std::string str() const noexcept override {
-        std::ostringstream starred_expr_str;
-        starred_expr_str << "StarredExpr(expr=" << expr->str() << ")";
-        return starred_expr_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"StarredExpr(expr=", expr, ")"});
+    }
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(expr);
     }
 
     Node *expr;
@@ -1186,8 +1578,14 @@ struct StarredExpr : public Node {
 
 struct WhileStmt : public Node {
     explicit WhileStmt(Node *test, Node *body, Node *or_else)
-            : test(test), body(body), or_else(or_else) {}
+            : Node(NodeKind::WhileStmt), test(test), body(body), or_else(or_else) {}
 
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(test);
+        visit(body);
+        visit(or_else);
+    }
 
     Node *test;
     Node *body;
@@ -1197,7 +1595,13 @@ struct WhileStmt : public Node {
 
 struct Raise : public Node {
     explicit Raise(Node *exception, Node *from)
-            : exception(exception), from(from) {}
+            : Node(NodeKind::Raise), exception(exception), from(from) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(exception);
+        visit(from);
+    }
 
     Node *exception;
     Node *from;
@@ -1205,21 +1609,38 @@ struct Raise : public Node {
 
 struct Yield : public Node {
     explicit Yield(Node *target)
-            : target(target) {}
+            : Node(NodeKind::Yield), target(target) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(target);
+    }
 
     Node *target;
 };
 
 struct Index : public Node {
     explicit Index(Node *value)
-            : value(value) {}
+            : Node(NodeKind::Index), value(value) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(value);
+    }
 
     Node *value;
 };
 
 struct Slice : public Node {
     explicit Slice(Node *lower, Node *upper, Node *step)
-            : lower(lower), upper(upper), step(step) {}
+            : Node(NodeKind::Slice), lower(lower), upper(upper), step(step) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(lower);
+        visit(upper);
+        visit(step);
+    }
 
     Node *lower;
     Node *upper;
@@ -1228,104 +1649,122 @@ struct Slice : public Node {
 
 struct Subscript : public Node {
     explicit Subscript(Node *value, Node *slice)
-            : value(value), slice(slice) {}
+            : Node(NodeKind::Subscript), value(value), slice(slice) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(value);
+        visit(slice);
+    }
 
     Node *value;
     Node *slice;
 };
 
 struct ExtSlice : public Node {
-    explicit ExtSlice(const std::vector<Node *> &dims)
-            : dims(dims) {}
+    explicit ExtSlice(NodeList dims)
+            : Node(NodeKind::ExtSlice), dims(std::move(dims)) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: dims) {
+            visit(child);
+        }
+    }
 
-    std::vector<Node *> dims;
+    NodeList dims;
 };
 
 struct YieldFrom : public Node {
     explicit YieldFrom(Node *target)
-            : target(target) {}
+            : Node(NodeKind::YieldFrom), target(target) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(target);
+    }
 
     Node *target;
 };
 
 struct Delete : public Node {
     explicit Delete(ExprList *targets)
-            : targets(targets) {}
+            : Node(NodeKind::Delete), targets(targets) {}
+
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"Delete(target=", targets, ")"});
+    }
 
-    std::string str() const noexcept override {
-        std::ostringstream delete_str;
-        delete_str << "Delete(target=" << targets->str() << ")";
-        return delete_str.str();
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(targets);
     }
 
     ExprList *targets;
 };
 
 struct Const : public Node {
-    explicit Const(const std::string &value, const int32_t type)
-            : value(value), type(type) {}
+    explicit Const(std::string_view value, const int32_t type)
+            : Node(NodeKind::Const), value(value), type(type) {}
 
-    std::string str() const noexcept override {
-        std::ostringstream const_str;
-        const_str << "Const(value=" << value << ",type=" << tok_utils::tokTypeToStr[type] << ")";
-        return const_str.str();
-    }
+    explicit Const(std::string_view value, Number &&number)
+            : Node(NodeKind::Const), value(value), type(Python3Parser::NUMBER), number(std::move(number)) {}
 
-    virtual std::vector<Node *> getChildren() override {
-        return {};
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.emplace_back("Const(value=" + std::string(value) + ",type=" + tok_utils::tokTypeName(type) + ")");
     }
 
-    std::string value;
+    std::string_view value;
     int32_t type;
+    // the decoded value of a NUMBER
+    Number number;
+    // the decoded value of a STRING, which is also what value refers to
+    LiteralId literal = NO_LITERAL;
 };
 
 struct Arguments : public Node {
-    explicit Arguments(const std::vector<Node *> &args, const std::vector<Node *> &keywords)
-            : args(args), keywords(keywords) {}
-
-    virtual std::vector<Node *> getChildren() {
-        // coalesce two vectors into the single one
-        std::vector<Node *> temp;
-        temp = args;
-        temp.insert(temp.end(), keywords.begin(), keywords.end());
+    explicit Arguments(NodeList args, NodeList keywords)
+            : Node(NodeKind::Arguments), args(std::move(args)), keywords(std::move(keywords)) {}
 
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: args) {
+            visit(child);
+        }
+        for (auto &child: keywords) {
+            visit(child);
+        }
     }
 
-    std::vector<Node *> args;
-    std::vector<Node *> keywords;
+    NodeList args;
+    NodeList keywords;
 };
 
 struct Name : public Node {
-    explicit Name(const std::string &name)
-            : name(name) {}
-
-    std::string str() const noexcept override {
-        return "Name(value = '" + name + "')";
-    }
+    explicit Name(std::string_view name, Symbol symbol)
+            : Node(NodeKind::Name), name(name), symbol(symbol) {}
 
-    std::vector<Node *> getChildren() const {
-        return {};
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.emplace_back("Name(value = '" + std::string(name) + "')");
     }
 
-    std::string name;
+    std::string_view name;
+    Symbol symbol;
 };
 
 struct Argument : public Node {
     explicit Argument(Name *name, Node *type, Node *default_val)
-            : name(name), type(type), default_val(default_val) {}
+            : Node(NodeKind::Argument), name(name), type(type), default_val(default_val) {}
 
-    std::string str() const noexcept override {
-        std::ostringstream arg_str;
-
-        arg_str << "Argument(name=" << name->str() << ",type=" << type->str() << ",default_val=" << default_val->str()
-                << ")";
-
-        return arg_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"Argument(name=", name, ",type=", type, ",default_val=", default_val, ")"});
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        return {name, type, default_val};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(name);
+        visit(type);
+        visit(default_val);
     }
 
     Name *name;
@@ -1335,19 +1774,17 @@ struct Argument : public Node {
 
 struct Parameter : public Node {
     explicit Parameter(Name *name, Node *type, Node *default_val)
-            : name(name), type(type), default_val(default_val) {}
-
-    std::string str() const noexcept override {
-        std::ostringstream arg_str;
+            : Node(NodeKind::Parameter), name(name), type(type), default_val(default_val) {}
 
-        arg_str << "Parameter(name=" << name->str() << ",type=" << type->str() << ",default_val=" << default_val->str()
-                << ")";
-
-        return arg_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"Parameter(name=", name, ",type=", type, ",default_val=", default_val, ")"});
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        return {name, type, default_val};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(name);
+        visit(type);
+        visit(default_val);
     }
 
     Name *name;
@@ -1360,54 +1797,66 @@ struct Parameters : public Node {
     struct ExtraParamData {
         Node *kwarg;
         Node *vararg;
-        std::vector<Node *> pos_only_args;
-        std::vector<Node *> kw_only_args;
-        std::vector<Node *> kw_defaults;
-        std::vector<Node *> defaults;
+        NodeList pos_only_args;
+        NodeList kw_only_args;
+        NodeList kw_defaults;
+        NodeList defaults;
     };
 
-    explicit Parameters(const std::vector<Node *> &params, const ExtraParamData &extra)
-            : params(params), extra(extra) {}
+    explicit Parameters(NodeList params, ExtraParamData extra)
+            : Node(NodeKind::Parameters), params(std::move(params)), extra(std::move(extra)) {}
 
-    std::vector<Node *> params;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: params) {
+            visit(child);
+        }
+        visit(extra.kwarg);
+        visit(extra.vararg);
+        for (auto &child: extra.pos_only_args) {
+            visit(child);
+        }
+        for (auto &child: extra.kw_only_args) {
+            visit(child);
+        }
+        for (auto &child: extra.kw_defaults) {
+            visit(child);
+        }
+        for (auto &child: extra.defaults) {
+            visit(child);
+        }
+    }
+
+    NodeList params;
     ExtraParamData extra;
 };
 
 struct Keyword : public Node {
-    explicit Keyword(const std::string &arg, Node *value)
-            : arg(arg), value(value) {}
-
-    std::string arg;
-    Node *value;
-};
-
-struct Alias {
-    explicit Alias(Node *name, Name *as)
-            : name(name), as(as) {}
+    explicit Keyword(std::string_view arg, Symbol arg_symbol, Node *value)
+            : Node(NodeKind::Keyword), arg(arg), arg_symbol(arg_symbol), value(value) {}
 
-    Node *name;
-    Name *as;
-};
-
-struct Aliases {
-    explicit Aliases(const std::vector<Alias *> aliases)
-            : aliases(aliases) {}
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(value);
+    }
 
-    std::vector<Alias *> aliases;
+    std::string_view arg;
+    Symbol arg_symbol;
+    Node *value;
 };
 
 struct BinOp : public Node {
-    explicit BinOp(Node *left, Node *right, int32_t op) : left(left), right(right), op(op) {}
+    explicit BinOp(Node *left, Node *right, int32_t op)
+            : Node(NodeKind::BinOp), left(left), right(right), op(op) {}
 
-    std::string str() const noexcept override {
-        std::ostringstream bin_op_str;
-        bin_op_str << "BinOp(left=" << left->str() << ",right=" << right->str() << ",op=" << tok_utils::tokTypeToStr[op]
-                   << ")";
-        return bin_op_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"BinOp(left=", left, ",right=", right, ",op=" + tok_utils::tokTypeName(op) + ")"});
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        return {left, right};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(left);
+        visit(right);
     }
 
     Node *left;
@@ -1416,25 +1865,32 @@ struct BinOp : public Node {
 };
 
 struct SubscriptList : public Node {
-    explicit SubscriptList(Node *value, const std::vector<Node *> &subscripts)
-            : value(value), subscripts(subscripts) {}
+    explicit SubscriptList(Node *value, NodeList subscripts)
+            : Node(NodeKind::SubscriptList), value(value), subscripts(std::move(subscripts)) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: subscripts) {
+            visit(child);
+        }
+        visit(value);
+    }
 
     Node *value;
-    std::vector<Node *> subscripts;
+    NodeList subscripts;
 };
 
 struct UnaryOp : public Node {
     explicit UnaryOp(const int32_t op, Node *expr)
-            : expr(expr), op(op) {}
+            : Node(NodeKind::UnaryOp), expr(expr), op(op) {}
 
-    std::string str() const noexcept override {
-        std::ostringstream unary_op_str;
-        unary_op_str << "UnaryOp(expr=" << expr->str() << ",op=" << tok_utils::tokTypeToStr[op] << ")";
-        return unary_op_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"UnaryOp(expr=", expr, ",op=" + tok_utils::tokTypeName(op) + ")"});
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        return {expr};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(expr);
     }
 
     Node *expr;
@@ -1443,19 +1899,17 @@ struct UnaryOp : public Node {
 
 struct BoolOp : public Node {
     explicit BoolOp(Node *left, Node *right, const int32_t op)
-            : left(left), right(right), op(op) {}
+            : Node(NodeKind::BoolOp), left(left), right(right), op(op) {}
 
 
-    virtual std::string str() const noexcept override {
-        std::ostringstream bool_op_str;
-        bool_op_str << "BoolOp(left = " << left->str() << ",right=" << right->str() << ",op="
-                    << tok_utils::tokTypeToStr[op]
-                    << ")";
-        return bool_op_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"BoolOp(left = ", left, ",right=", right, ",op=" + tok_utils::tokTypeName(op) + ")"});
     }
 
-    virtual std::vector<Node *> getChildren() override {
-        return {left, right};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(left);
+        visit(right);
     }
 
     Node *left;
@@ -1465,14 +1919,17 @@ struct BoolOp : public Node {
 
 struct Comparison : public Node {
     explicit Comparison(Node *left, Node *right, const int32_t op)
-            : left(left), right(right), op(op) {}
+            : Node(NodeKind::Comparison), left(left), right(right), op(op) {}
+
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"Comparison(left=", left, ",right=", right,
+                                   std::string(",op=") + tok_utils::comparisonOpToStr(op) + ")"});
+    }
 
-    std::string str() const noexcept override {
-        std::ostringstream comparison_str;
-        comparison_str << "Comparison(left=" << left->str() << ",right=" << right->str() << ",op="
-                       << tok_utils::comparisonOpToStr(op)
-                       << ")";
-        return comparison_str.str();
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(left);
+        visit(right);
     }
 
     Node *left;
@@ -1481,74 +1938,88 @@ struct Comparison : public Node {
 };
 
 struct FuncDef : public Node {
-    explicit FuncDef(const std::string &name, Parameters *parameters, Node *body, Node *return_type,
-                     std::vector<Node *> decorator_list) :
-            name(name), parameters(parameters), body(body), return_type(return_type), decorator_list(decorator_list) {};
-
-    std::string str() const noexcept override {
-        std::ostringstream func_def_str;
-        func_def_str << "FuncDef(name=" << name << ",arguments="
-                     << parameters->str() << ",body=" << body->str()
-                     << ",return_type=" << return_type->str();
+    explicit FuncDef(std::string_view name, Parameters *parameters, Node *body, Node *return_type,
+                     NodeList decorator_list) : Node(NodeKind::FuncDef),
+            name(name), parameters(parameters), body(body), return_type(return_type),
+            decorator_list(std::move(decorator_list)) {};
 
-        return func_def_str.str();
+    void strParts(std::vector<StrPart> &parts) const override {
+        parts.insert(parts.end(), {"FuncDef(name=" + std::string(name) + ",arguments=", parameters, ",body=", body,
+                                   ",return_type=", return_type, ")"});
     }
 
-    virtual std::vector<Node *> getChildren() {
-        auto temp = decorator_list;
-        temp.push_back(parameters);
-        temp.push_back(body);
-        temp.push_back(return_type);
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: decorator_list) {
+            visit(child);
+        }
+        visit(parameters);
+        visit(body);
+        visit(return_type);
     }
 
-    std::string name;
+    std::string_view name;
+    Symbol name_symbol = NO_SYMBOL;
     Parameters *parameters;
+    // null until parseBody() is called if the suite was skipped, i.e. body_end != 0
     Node *body;
     Node *return_type;
-    std::vector<Node *> decorator_list;
+    NodeList decorator_list;
+    // the tokens [body_begin, body_end) of the skipped suite
+    uint32_t body_begin = 0;
+    uint32_t body_end = 0;
 };
 
 struct AsyncFuncDef : public Node {
-    explicit AsyncFuncDef(const std::string &name, Parameters *parameters, Node *body, Node *return_type,
-                          const std::vector<Node *> &decorator_list,
+    explicit AsyncFuncDef(std::string_view name, Parameters *parameters, Node *body, Node *return_type,
+                          NodeList decorator_list,
                           Node *type_comment)
-            : name(name), parameters(parameters), body(body), return_type(return_type), type_comment(type_comment),
-              decorator_list(decorator_list) {}
+            : Node(NodeKind::AsyncFuncDef), name(name), parameters(parameters), body(body), return_type(return_type),
+              type_comment(type_comment), decorator_list(std::move(decorator_list)) {}
 
     explicit AsyncFuncDef(FuncDef *func_def, bool destroy_func_def)
-            : name(func_def->name), parameters(func_def->parameters), body(func_def->body),
-              return_type(func_def->return_type), decorator_list(func_def->decorator_list) {
+            : Node(NodeKind::AsyncFuncDef), name(func_def->name), name_symbol(func_def->name_symbol),
+              parameters(func_def->parameters), body(func_def->body),
+              return_type(func_def->return_type), type_comment(nullptr), decorator_list(func_def->decorator_list),
+              body_begin(func_def->body_begin), body_end(func_def->body_end) {
         if (destroy_func_def) {
             delete func_def;
             func_def = nullptr;
         }
     }
 
-    virtual std::vector<Node *> getChildren() {
-        auto temp = decorator_list;
-        temp.push_back(parameters);
-        temp.push_back(body);
-        temp.push_back(return_type);
-        temp.push_back(type_comment);
-        return temp;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: decorator_list) {
+            visit(child);
+        }
+        visit(parameters);
+        visit(body);
+        visit(return_type);
+        visit(type_comment);
     }
 
-    std::string name;
+    std::string_view name;
+    Symbol name_symbol = NO_SYMBOL;
     Node *parameters;
+    // see FuncDef::body
     Node *body;
     Node *return_type;
     Node *type_comment;
-    std::vector<Node *> decorator_list;
+    NodeList decorator_list;
+    uint32_t body_begin = 0;
+    uint32_t body_end = 0;
 };
 
 struct Lambda : public Node {
     explicit Lambda(Node *args, Node *body)
-            : args(args), body(body) {}
+            : Node(NodeKind::Lambda), args(args), body(body) {}
 
 
-    virtual std::vector<Node *> getChildren() override {
-        return {args, body};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(args);
+        visit(body);
     }
 
     Node *args;
@@ -1557,10 +2028,12 @@ struct Lambda : public Node {
 
 struct Call : public Node {
     explicit Call(Node *func, Arguments *arguments)
-            : func(func), arguments(arguments) {}
+            : Node(NodeKind::Call), func(func), arguments(arguments) {}
 
-    virtual std::vector<Node *> getChildren() {
-        return {func, arguments};
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(func);
+        visit(arguments);
     }
 
     Node *func;
@@ -1568,27 +2041,59 @@ struct Call : public Node {
 };
 
 struct Pass : public Node {
-    Pass() {}
+    Pass() : Node(NodeKind::Pass) {}
 };
 
 struct Global : public Node {
-    explicit Global(const std::vector<Name *> &names)
-            : names(names) {}
+    explicit Global(ArenaVector<Name *> names)
+            : Node(NodeKind::Global), names(std::move(names)) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: names) {
+            visit(child);
+        }
+    }
 
-    std::vector<Name *> names;
+    ArenaVector<Name *> names;
 };
 
 struct Assert : public Node {
     explicit Assert(Node *test, Node *message)
-            : test(test), message(message) {}
+            : Node(NodeKind::Assert), test(test), message(message) {}
+
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        visit(test);
+        visit(message);
+    }
 
     Node *test;
     Node *message;
 };
 
 struct Nonlocal : public Node {
-    explicit Nonlocal(const std::vector<Name *> &names)
-            : names(names) {}
+    explicit Nonlocal(ArenaVector<Name *> names)
+            : Node(NodeKind::Nonlocal), names(std::move(names)) {}
 
-    std::vector<Name *> names;
+    template<typename F>
+    inline void visitChildren(F &&visit) {
+        for (auto &child: names) {
+            visit(child);
+        }
+    }
+
+    ArenaVector<Name *> names;
 };
+
+template<typename F>
+inline void Node::forEachChild(F &&visit) {
+    switch (kind) {
+#define PRSS_NODE_KIND(name) \
+        case NodeKind::name: \
+            static_cast<name *>(this)->visitChildren(visit); \
+            return;
+        PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+    }
+}
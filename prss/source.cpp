@@ -0,0 +1,63 @@
+#include "source.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::SourceBuffer(const char *path, SourceLoad load) {
+    if (load == SourceLoad::READ) {
+        std::ifstream stream(path);
+        if (!stream) {
+            throw std::runtime_error("path to the source is incorrect");
+        }
+        contents_.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        data_ = contents_.data();
+        size_ = contents_.size();
+        return;
+    }
+
+    const auto fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("path to the source is incorrect");
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("unable to stat the source");
+    }
+
+    // mmap refuses zero-length mappings, an empty file is simply an empty buffer
+    if (st.st_size > 0) {
+        const auto addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("unable to map the source");
+        }
+        // the lexer makes a single forward pass over the file
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+        data_ = static_cast<const char *>(addr);
+        size_ = st.st_size;
+        mapped_ = true;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+SourceBuffer::SourceBuffer(std::string_view text, size_t base) : base_(base), contents_(text) {
+    data_ = contents_.data();
+    size_ = contents_.size();
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped_) {
+        munmap(const_cast<char *>(data_), size_);
+    }
+}
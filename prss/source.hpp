@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// How SourceBuffer gets hold of the file contents. MMAP maps the file read-only, so nothing
+// is ever copied; READ copies it into an owned buffer through std::ifstream (the way the
+// front end used to load sources, kept for comparison).
+enum class SourceLoad : uint8_t {
+    MMAP = 0,
+    READ,
+};
+
+// Read-only contents of a source file. Tokens and AST nodes hold string views into it,
+// so a SourceBuffer has to outlive both of them.
+class SourceBuffer {
+public:
+    explicit SourceBuffer(const char *path, SourceLoad load = SourceLoad::MMAP);
+
+    // Holds a copy of the part of a text starting at base. Views are still taken by offsets into the whole text,
+    // so that the tokens lexed out of the part don't need to be moved.
+    SourceBuffer(std::string_view text, size_t base);
+
+    SourceBuffer(const SourceBuffer &) = delete;
+
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+
+    ~SourceBuffer();
+
+    inline const char *data() const noexcept { return data_; }
+
+    inline size_t size() const noexcept { return size_; }
+
+    inline std::string_view view(size_t start, size_t length) const noexcept {
+        return {data_ + start - base_, length};
+    }
+
+private:
+    const char *data_ = "";
+    size_t size_ = 0;
+    bool mapped_ = false;
+    // the offset of data_ in the text, non-zero for a part of it only
+    size_t base_ = 0;
+    std::string contents_;
+};
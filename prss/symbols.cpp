@@ -0,0 +1,31 @@
+#include "symbols.hpp"
+
+SymbolTable::SymbolTable(bool is_shared) : is_shared_(is_shared) {
+    symbols_.reserve(1024);
+    names_.reserve(1024);
+    names_.emplace_back();
+    symbols_.emplace(std::string_view(), NO_SYMBOL);
+}
+
+Symbol SymbolTable::internOwn(std::string_view name) {
+    const auto [it, inserted] = symbols_.try_emplace(name, static_cast<Symbol>(names_.size()));
+    if (inserted) {
+        names_.push_back(name);
+    }
+
+    return it->second;
+}
+
+Symbol SymbolTable::internShared(std::string_view name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = symbols_.find(name);
+    if (it != symbols_.end()) {
+        return it->second;
+    }
+
+    const std::string_view copy = copies_.emplace_back(name);
+    const auto symbol = static_cast<Symbol>(names_.size());
+    symbols_.emplace(copy, symbol);
+    names_.push_back(copy);
+    return symbol;
+}
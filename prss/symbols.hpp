@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Dense id of an interned identifier, two symbols are equal iff the identifiers are
+using Symbol = uint32_t;
+
+// the symbol of the empty string, used by nodes with no name (i.e. the keyword of **kwargs)
+constexpr Symbol NO_SYMBOL = 0;
+
+// Maps every distinct identifier to a Symbol. By default a table belongs to the lexer of a single source, so the
+// same identifier gets different symbols in different files, and identifiers are not copied, the views have to
+// outlive the table (they point into the SourceBuffer or PyLexer::keep()).
+//
+// A shared table (see LexerOptions::symbols) is the one the lexers of any number of sources intern into, on any
+// number of threads, so that the symbols of all of their trees can be compared. It copies the identifiers, which
+// then outlive the sources, and takes a lock for every lookup.
+class SymbolTable {
+public:
+    explicit SymbolTable(bool is_shared = false);
+
+    SymbolTable(const SymbolTable &) = delete;
+
+    SymbolTable &operator=(const SymbolTable &) = delete;
+
+    inline Symbol intern(std::string_view name) {
+        if (is_shared_) {
+            return internShared(name);
+        }
+        return internOwn(name);
+    }
+
+    inline std::string_view name(Symbol symbol) const {
+        if (is_shared_) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return names_[symbol];
+        }
+        return names_[symbol];
+    }
+
+    inline size_t size() const {
+        if (is_shared_) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return names_.size();
+        }
+        return names_.size();
+    }
+
+    inline bool isShared() const noexcept { return is_shared_; }
+
+private:
+    Symbol internOwn(std::string_view name);
+
+    Symbol internShared(std::string_view name);
+
+    std::unordered_map<std::string_view, Symbol> symbols_;
+    std::vector<std::string_view> names_;
+    bool is_shared_;
+    mutable std::mutex mutex_;
+    // the copies of the identifiers of a shared table, a deque doesn't move them
+    std::deque<std::string> copies_;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+
+#include "Python3Parser.h"
+
+// A set of token types stored as a 128-bit bitmap, so that checking whether a token
+// belongs to it is a single bit test instead of a chain of comparisons. EOF (size_t(-1))
+// is out of range and never a member.
+struct TokenSet {
+    // not a token type
+    static constexpr size_t MEMBER = 128;
+
+    uint64_t words[2] = {};
+
+    static constexpr TokenSet of(std::initializer_list<size_t> types) {
+        TokenSet set;
+        for (const auto type : types) {
+            set.words[type >> 6] |= uint64_t(1) << (type & 63);
+        }
+        return set;
+    }
+
+    constexpr bool contains(size_t type) const noexcept {
+        return type < 128 && ((words[type >> 6] >> (type & 63)) & 1) != 0;
+    }
+
+    // Maps every member of the set to MEMBER and leaves other types as they are, so that a switch
+    // can handle the whole set with a single case label
+    constexpr size_t classify(size_t type) const noexcept {
+        return contains(type) ? MEMBER : type;
+    }
+
+    constexpr TokenSet operator|(const TokenSet other) const noexcept {
+        TokenSet set;
+        set.words[0] = words[0] | other.words[0];
+        set.words[1] = words[1] | other.words[1];
+        return set;
+    }
+};
+
+static_assert(Python3Parser::DEDENT < 128, "token types have to fit into a TokenSet");
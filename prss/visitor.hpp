@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "parser.hpp"
+
+// Passes over a tree, dispatched at compile time. A pass derives from one of these with itself as the template
+// argument (CRTP) and hides the methods of the kinds it's interested in: the switch on the kind of a node calls the
+// method of the derived class directly, so it can be inlined into the traversal. Both go with explicit stacks
+// rather than by recursion, hence a tree of any depth is fine, and the stacks are kept from one tree to the next.
+
+// The kind of the nodes of the type T
+template<typename T>
+struct NodeKindOf;
+
+#define PRSS_NODE_KIND(name) \
+template<> \
+struct NodeKindOf<name> { \
+    static constexpr NodeKind value = NodeKind::name; \
+};
+PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+
+// Goes over the nodes in preorder (a node before its children, the children in the order of forEachChild()).
+// visitX(X *node) is called for a node of the kind X, the ones the derived class doesn't have call visitNode(), which
+// does nothing. Returning false skips the children of the node.
+template<typename Derived>
+class AstVisitor {
+public:
+    void walk(Node *root) {
+        stack_.clear();
+        if (root) {
+            stack_.push_back(root);
+        }
+        while (!stack_.empty()) {
+            const auto node = stack_.back();
+            stack_.pop_back();
+            if (!dispatch(node)) {
+                continue;
+            }
+
+            // the first child ends up on the top
+            const auto num_of_nodes = stack_.size();
+            node->forEachChild([&](Node *child) {
+                if (child) {
+                    stack_.push_back(child);
+                }
+            });
+            std::reverse(stack_.begin() + num_of_nodes, stack_.end());
+        }
+    }
+
+    inline bool visitNode(Node *) { return true; }
+
+#define PRSS_NODE_KIND(name) \
+    inline bool visit##name(name *node) { return derived().visitNode(node); }
+    PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+
+private:
+    inline Derived &derived() { return static_cast<Derived &>(*this); }
+
+    inline bool dispatch(Node *node) {
+        switch (node->kind) {
+#define PRSS_NODE_KIND(name) \
+            case NodeKind::name: \
+                return derived().visit##name(static_cast<name *>(node));
+            PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+        }
+        return true;
+    }
+
+    std::vector<Node *> stack_;
+};
+
+// Rewrites a tree bottom up: once the children of a node are rewritten, rewriteX(X *node) is called for it, and
+// whatever it returns takes the place of the node in its parent (null removes an optional child, or leaves a null in
+// a list). The ones the derived class doesn't have call rewriteNode(), which keeps the node. The new nodes are made
+// in the current ArenaScope, the old ones stay in their arena.
+//
+// The tree is rewritten in place: the new children are put right into the members (and the lists) of the nodes
+// that are kept, so the tree given to rewrite() is the rewritten one afterwards, not a copy of it.
+//
+// Some children have a type of their own (the targets of an Assign are a TestList, the name of an Argument is a
+// Name), a node taking the place of one of them has to be of that kind, otherwise std::logic_error is thrown. The
+// new children of a node are all checked before any of them is put in place, so the node the error is found at is
+// left as it was, but the nodes finished before keep their new children: the tree is left half rewritten.
+template<typename Derived>
+class AstRewriter {
+public:
+    // Returns the new root
+    Node *rewrite(Node *root) {
+        stack_.clear();
+        results_.clear();
+        stack_.push_back({root, false, 0});
+        while (!stack_.empty()) {
+            auto &top = stack_.back();
+            if (!top.node) {
+                results_.push_back(nullptr);
+                stack_.pop_back();
+                continue;
+            }
+
+            if (!top.is_expanded) {
+                // the results of the children go on top of the ones already there, in the order of the children
+                top.is_expanded = true;
+                top.first_result = results_.size();
+                const auto node = top.node;
+                const auto num_of_items = stack_.size();
+                node->forEachChild([&](Node *child) {
+                    stack_.push_back({child, false, 0});
+                });
+                std::reverse(stack_.begin() + num_of_items, stack_.end());
+                continue;
+            }
+
+            const auto node = top.node;
+            const auto first_result = top.first_result;
+            stack_.pop_back();
+            auto idx = first_result;
+            node->forEachChild([&](auto &child) {
+                check(child, results_[idx++]);
+            });
+            idx = first_result;
+            node->forEachChild([&](auto &child) {
+                put(child, results_[idx++]);
+            });
+            results_.resize(first_result);
+            results_.push_back(dispatch(node));
+        }
+
+        return results_.back();
+    }
+
+    inline Node *rewriteNode(Node *node) { return node; }
+
+#define PRSS_NODE_KIND(name) \
+    inline Node *rewrite##name(name *node) { return derived().rewriteNode(node); }
+    PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+
+private:
+    // A node to be rewritten, once its children are
+    struct Item {
+        Node *node;
+        bool is_expanded;
+        // where the results of its children start
+        size_t first_result;
+    };
+
+    inline Derived &derived() { return static_cast<Derived &>(*this); }
+
+    inline Node *dispatch(Node *node) {
+        switch (node->kind) {
+#define PRSS_NODE_KIND(name) \
+            case NodeKind::name: \
+                return derived().rewrite##name(static_cast<name *>(node));
+            PRSS_NODE_KINDS(PRSS_NODE_KIND)
+#undef PRSS_NODE_KIND
+        }
+        return node;
+    }
+
+    // Throws if the result can't take the place of the child
+    template<typename T>
+    static inline void check(T *&, Node *result) {
+        if constexpr (!std::is_same_v<T, Node>) {
+            if (result && result->kind != NodeKindOf<T>::value) {
+                throw std::logic_error(std::string("a child of the type ") + nodeKindName(NodeKindOf<T>::value) +
+                                       " can't be replaced by a " + nodeKindName(result->kind));
+            }
+        }
+    }
+
+    template<typename T>
+    static inline void put(T *&child, Node *result) {
+        child = static_cast<T *>(result);
+    }
+
+    std::vector<Item> stack_;
+    std::vector<Node *> results_;
+};